@@ -0,0 +1,59 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cycle_stats.hpp"
+
+namespace witherspoon
+{
+namespace power
+{
+
+constexpr std::array<uint64_t, 13> CycleStats::BUCKET_BOUNDS;
+
+CycleStats::CycleStats(Clock::duration interval) : interval(interval)
+{
+}
+
+void CycleStats::add(Clock::duration duration, Clock::duration lateness)
+{
+    using namespace std::chrono;
+
+    // The timer can't fire early, so this is only clock jitter
+    if (lateness < Clock::duration{0})
+    {
+        lateness = Clock::duration{0};
+    }
+
+    this->duration.add(duration);
+    this->lateness.add(lateness);
+
+    if (duration > interval)
+    {
+        overruns++;
+    }
+
+    auto us = static_cast<uint64_t>(duration_cast<microseconds>(duration)
+                                        .count());
+    size_t bucket = 0;
+    while ((bucket < BUCKET_BOUNDS.size()) && (us > BUCKET_BOUNDS[bucket]))
+    {
+        bucket++;
+    }
+
+    histogram[bucket]++;
+}
+
+} // namespace power
+} // namespace witherspoon
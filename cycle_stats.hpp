@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class PhaseStats
+ *
+ * The count, total, and maximum of the times taken by one phase
+ * of a poll, like a register read.
+ */
+class PhaseStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Adds the time one run of the phase took
+     *
+     * @param[in] duration - the time it took
+     */
+    inline void add(Clock::duration duration)
+    {
+        count++;
+        total += duration;
+        if (duration > max)
+        {
+            max = duration;
+        }
+    }
+
+    /**
+     * @brief Adds the time since a start time
+     *
+     * @param[in] start - when the phase started
+     */
+    inline void addSince(Clock::time_point start)
+    {
+        add(Clock::now() - start);
+    }
+
+    /**
+     * @brief Returns the number of runs
+     */
+    inline uint64_t getCount() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Returns the mean time of a run, or 0 if there weren't any
+     */
+    inline Clock::duration getMean() const
+    {
+        if (count == 0)
+        {
+            return Clock::duration{0};
+        }
+
+        return total / static_cast<Clock::rep>(count);
+    }
+
+    /**
+     * @brief Returns the longest time of a run
+     */
+    inline Clock::duration getMax() const
+    {
+        return max;
+    }
+
+  private:
+    /**
+     * @brief The number of runs
+     */
+    uint64_t count = 0;
+
+    /**
+     * @brief The total time of the runs
+     */
+    Clock::duration total{0};
+
+    /**
+     * @brief The longest time of a run
+     */
+    Clock::duration max{0};
+};
+
+/**
+ * @class CycleStats
+ *
+ * Statistics about the cycles of a poll loop: a histogram of how long
+ * each cycle took, how late the timer fired compared to when it was
+ * scheduled, and how many cycles took longer than the poll interval.
+ *
+ * Adding a cycle is a few additions and compares with no allocation,
+ * so it can always be left on.
+ */
+class CycleStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The upper bounds of the histogram buckets, in
+     *        microseconds.  There is one more bucket after these
+     *        for the cycles that took even longer.
+     */
+    static constexpr std::array<uint64_t, 13> BUCKET_BOUNDS = {
+        100,   250,    500,    1000,   2500,   5000,   10000,
+        25000, 50000, 100000, 250000, 500000, 1000000};
+
+    using Histogram = std::array<uint64_t, BUCKET_BOUNDS.size() + 1>;
+
+    CycleStats() = delete;
+    ~CycleStats() = default;
+    CycleStats(const CycleStats&) = default;
+    CycleStats& operator=(const CycleStats&) = default;
+    CycleStats(CycleStats&&) = default;
+    CycleStats& operator=(CycleStats&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] interval - the poll interval
+     */
+    explicit CycleStats(Clock::duration interval);
+
+    /**
+     * @brief Adds a cycle
+     *
+     * @param[in] duration - how long the cycle took
+     * @param[in] lateness - how long after its scheduled time the
+     *                       cycle started
+     */
+    void add(Clock::duration duration, Clock::duration lateness);
+
+    /**
+     * @brief Returns the poll interval
+     */
+    inline Clock::duration getInterval() const
+    {
+        return interval;
+    }
+
+    /**
+     * @brief Returns the number of cycles
+     */
+    inline uint64_t getCycles() const
+    {
+        return duration.getCount();
+    }
+
+    /**
+     * @brief Returns the number of cycles that took longer than
+     *        the interval
+     */
+    inline uint64_t getOverruns() const
+    {
+        return overruns;
+    }
+
+    /**
+     * @brief Returns the cycle count of each histogram bucket
+     */
+    inline const Histogram& getHistogram() const
+    {
+        return histogram;
+    }
+
+    /**
+     * @brief Returns the cycle durations
+     */
+    inline const PhaseStats& getDuration() const
+    {
+        return duration;
+    }
+
+    /**
+     * @brief Returns the cycle latenesses
+     */
+    inline const PhaseStats& getLateness() const
+    {
+        return lateness;
+    }
+
+  private:
+    /**
+     * @brief The poll interval
+     */
+    Clock::duration interval;
+
+    /**
+     * @brief The number of cycles that took longer than the interval
+     */
+    uint64_t overruns = 0;
+
+    /**
+     * @brief The histogram of the cycle durations
+     */
+    Histogram histogram{};
+
+    /**
+     * @brief The cycle durations
+     */
+    PhaseStats duration;
+
+    /**
+     * @brief How late the cycles started
+     */
+    PhaseStats lateness;
+};
+
+} // namespace power
+} // namespace witherspoon
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "cycle_stats.hpp"
+
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace witherspoon
 {
@@ -69,6 +73,16 @@ class Device
      */
     virtual void clearFaults() = 0;
 
+    /**
+     * Returns the times taken by the phases of analyze(), by
+     * phase name.  Override if the device measures them.
+     */
+    virtual std::vector<std::pair<std::string, PhaseStats>>
+        getPhaseStats() const
+    {
+        return {};
+    }
+
   private:
     /**
      * the device name
@@ -1,12 +1,17 @@
 #pragma once
+#include "cycle_stats.hpp"
 #include "device.hpp"
+#include "scheduler.hpp"
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <org/open_power/Witherspoon/Monitor/Statistics/server.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/bus.hpp>
 #include <sdbusplus/server.hpp>
-#include <sdeventplus/clock.hpp>
+#include <sdbusplus/server/object.hpp>
 #include <sdeventplus/event.hpp>
-#include <sdeventplus/utility/timer.hpp>
 
 namespace witherspoon
 {
@@ -15,16 +20,39 @@ namespace power
 
 using namespace phosphor::logging;
 
+using StatisticsInterface =
+    sdbusplus::org::open_power::Witherspoon::Monitor::server::Statistics;
+
+using StatisticsObject = sdbusplus::server::object::object<StatisticsInterface>;
+
 /**
  * @class DeviceMonitor
  *
  * Monitors a power device for faults by calling Device::analyze()
  * on an interval.  Do the monitoring by calling run().
  * May be overridden to provide more functionality.
+ *
+ * The polls are run by a Scheduler, which other devices can be
+ * added to so they are all polled from the same timer.
+ *
+ * Every poll is timed, and the statistics of the polls along with
+ * the device's phase times can be put on D-Bus.
  */
 class DeviceMonitor
 {
   public:
+    /**
+     * @brief The D-Bus object path the statistics go under
+     */
+    static constexpr auto STATISTICS_ROOT =
+        "/org/open_power/witherspoon/monitor";
+
+    /**
+     * @brief How often the statistics on D-Bus are updated, so the
+     *        polls don't each send PropertiesChanged signals
+     */
+    static constexpr auto PUBLISH_INTERVAL = std::chrono::seconds{60};
+
     DeviceMonitor() = delete;
     ~DeviceMonitor() = default;
     DeviceMonitor(const DeviceMonitor&) = delete;
@@ -41,17 +69,57 @@ class DeviceMonitor
      */
     DeviceMonitor(std::unique_ptr<Device>&& d, const sdeventplus::Event& e,
                   std::chrono::milliseconds i) :
-        device(std::move(d)),
-        timer(e, std::bind(&DeviceMonitor::analyze, this), i)
+        device(std::move(d)), interval(i),
+        scheduler(e, std::min<Scheduler::Clock::duration>(
+                         Scheduler::DEFAULT_SLACK, i / 2))
     {
+        pollID = scheduler.add(
+            device->getName() + std::to_string(device->getInstance()), i,
+            std::bind(&DeviceMonitor::poll, this));
     }
 
     /**
-     * Starts the timer to monitor the device on an interval.
+     * Starts the polls to monitor the device on an interval.
      */
     virtual int run()
     {
-        return timer.get_event().loop();
+        return scheduler.run();
+    }
+
+    /**
+     * Puts the poll statistics on D-Bus
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the object path to use
+     */
+    void enableStatistics(sdbusplus::bus::bus& bus,
+                          const std::string& objectPath)
+    {
+        statsObject =
+            std::make_unique<StatisticsObject>(bus, objectPath.c_str());
+
+        statsObject->interval(toMicroseconds(interval));
+        statsObject->durationBuckets(
+            std::vector<uint64_t>(CycleStats::BUCKET_BOUNDS.begin(),
+                                  CycleStats::BUCKET_BOUNDS.end()));
+
+        publishStatistics();
+    }
+
+    /**
+     * Returns the poll statistics
+     */
+    inline const CycleStats& getStatistics() const
+    {
+        return scheduler.getStats(pollID);
+    }
+
+    /**
+     * Returns the scheduler, to add the polls of other devices
+     */
+    inline Scheduler& getScheduler()
+    {
+        return scheduler;
     }
 
   protected:
@@ -73,9 +141,89 @@ class DeviceMonitor
     std::unique_ptr<Device> device;
 
     /**
-     * The timer that runs fault check polls.
+     * The polling interval
+     */
+    const std::chrono::milliseconds interval;
+
+    /**
+     * When the statistics were last put on D-Bus
      */
-    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+    CycleStats::Clock::time_point lastPublish;
+
+    /**
+     * The statistics D-Bus object, if enabled
+     */
+    std::unique_ptr<StatisticsObject> statsObject;
+
+    /**
+     * Runs the fault check polls, and times them against their
+     * deadlines.
+     */
+    Scheduler scheduler;
+
+    /**
+     * The ID of the device's poll in the scheduler
+     */
+    size_t pollID = 0;
+
+  private:
+    /**
+     * Runs in the scheduler, which times it
+     */
+    void poll()
+    {
+        analyze();
+
+        if (statsObject &&
+            (CycleStats::Clock::now() - lastPublish >= PUBLISH_INTERVAL))
+        {
+            publishStatistics();
+        }
+    }
+
+    /**
+     * Updates the statistics D-Bus properties
+     */
+    void publishStatistics()
+    {
+        const auto& stats = getStatistics();
+
+        statsObject->cycles(stats.getCycles());
+        statsObject->overruns(stats.getOverruns());
+        statsObject->durationHistogram(std::vector<uint64_t>(
+            stats.getHistogram().begin(), stats.getHistogram().end()));
+        statsObject->meanDuration(
+            toMicroseconds(stats.getDuration().getMean()));
+        statsObject->maxDuration(toMicroseconds(stats.getDuration().getMax()));
+        statsObject->meanLateness(
+            toMicroseconds(stats.getLateness().getMean()));
+        statsObject->maxLateness(toMicroseconds(stats.getLateness().getMax()));
+
+        std::map<std::string, uint64_t> means;
+        std::map<std::string, uint64_t> maxes;
+        for (const auto& phase : device->getPhaseStats())
+        {
+            means.emplace(phase.first, toMicroseconds(phase.second.getMean()));
+            maxes.emplace(phase.first, toMicroseconds(phase.second.getMax()));
+        }
+
+        statsObject->phaseMeanDuration(std::move(means));
+        statsObject->phaseMaxDuration(std::move(maxes));
+
+        lastPublish = CycleStats::Clock::now();
+    }
+
+    /**
+     * Converts a duration to whole microseconds
+     *
+     * @param[in] duration - the duration
+     */
+    template <typename T>
+    static uint64_t toMicroseconds(T duration)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+            .count();
+    }
 };
 
 } // namespace power
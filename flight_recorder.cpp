@@ -0,0 +1,338 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <phosphor-logging/log.hpp>
+#include <stdexcept>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+void putVarint(std::vector<uint8_t>& data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+uint8_t getByte(const std::vector<uint8_t>& data, size_t& offset)
+{
+    if (offset >= data.size())
+    {
+        throw std::runtime_error("Truncated flight recorder dump");
+    }
+    return data[offset++];
+}
+
+uint64_t getVarint(const std::vector<uint8_t>& data, size_t& offset)
+{
+    uint64_t value = 0;
+
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        auto byte = getByte(data, offset);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+
+    throw std::runtime_error("Invalid flight recorder varint");
+}
+
+// The sequence number follows the device name in a dump's file name.
+// Files without one, like from an older version, sort as the oldest.
+uint64_t getSequence(const std::string& name, size_t offset)
+{
+    uint64_t sequence = 0;
+
+    for (auto c = name.begin() + offset; c != name.end(); ++c)
+    {
+        if (*c == '_')
+        {
+            return sequence;
+        }
+        if (!std::isdigit(static_cast<unsigned char>(*c)) ||
+            (sequence > (std::numeric_limits<uint64_t>::max() - 9) / 10))
+        {
+            break;
+        }
+        sequence = sequence * 10 + (*c - '0');
+    }
+
+    return 0;
+}
+
+} // namespace
+
+FlightRecorder::FlightRecorder(const std::string& device, size_t capacity) :
+    device(device), entries(std::max<size_t>(capacity, 1))
+{
+}
+
+uint16_t FlightRecorder::addName(const std::string& name)
+{
+    // There are only ever a handful of names
+    auto n = std::find(names.begin(), names.end(), name);
+    if (n == names.end())
+    {
+        if (names.size() > std::numeric_limits<uint16_t>::max())
+        {
+            throw std::length_error("Too many flight recorder names");
+        }
+        n = names.insert(names.end(), name);
+    }
+
+    return static_cast<uint16_t>(n - names.begin());
+}
+
+void FlightRecorder::record(Type type, uint16_t name, uint32_t value)
+{
+    record(getMonotonicTime(), type, name, value);
+}
+
+void FlightRecorder::record(uint64_t timestamp, Type type, uint16_t name,
+                            uint32_t value)
+{
+    if (name >= names.size())
+    {
+        throw std::out_of_range("Invalid flight recorder name");
+    }
+
+    entries[head] = {timestamp, value, name, type};
+
+    head = (head + 1) % entries.size();
+    count = std::min(count + 1, entries.size());
+}
+
+void FlightRecorder::record(Type type, const std::string& name,
+                            uint32_t value)
+{
+    record(getMonotonicTime(), type, addName(name), value);
+}
+
+void FlightRecorder::record(uint64_t timestamp, Type type,
+                            const std::string& name, uint32_t value)
+{
+    record(timestamp, type, addName(name), value);
+}
+
+void FlightRecorder::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+void FlightRecorder::fault(const std::string& errName)
+{
+    auto reason = errName.substr(errName.rfind('.') + 1);
+
+    record(Type::state, reason, true);
+    dump(reason);
+}
+
+std::vector<uint8_t> FlightRecorder::encode() const
+{
+    std::vector<uint8_t> data;
+
+    for (size_t i = 0; i < sizeof(MAGIC); i++)
+    {
+        data.push_back(static_cast<uint8_t>(MAGIC >> (i * 8)));
+    }
+    data.push_back(VERSION);
+
+    putVarint(data, names.size());
+    for (const auto& name : names)
+    {
+        putVarint(data, name.size());
+        data.insert(data.end(), name.begin(), name.end());
+    }
+
+    putVarint(data, count);
+
+    std::vector<uint32_t> lastValues(names.size(), 0);
+    uint64_t lastTime = 0;
+
+    auto oldest = (head + entries.size() - count) % entries.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& entry = entries[(oldest + i) % entries.size()];
+
+        // The clock can't go backwards, but be safe
+        auto delta = (entry.timestamp >= lastTime)
+                         ? entry.timestamp - lastTime
+                         : 0;
+        putVarint(data, delta);
+        data.push_back(static_cast<uint8_t>(entry.type));
+        putVarint(data, entry.name);
+        putVarint(data, entry.value ^ lastValues[entry.name]);
+
+        lastTime += delta;
+        lastValues[entry.name] = entry.value;
+    }
+
+    return data;
+}
+
+FlightRecorder::Dump FlightRecorder::decode(const std::vector<uint8_t>& data)
+{
+    Dump dump;
+    size_t offset = 0;
+
+    uint32_t magic = 0;
+    for (size_t i = 0; i < sizeof(MAGIC); i++)
+    {
+        magic |= static_cast<uint32_t>(getByte(data, offset)) << (i * 8);
+    }
+
+    if ((magic != MAGIC) || (getByte(data, offset) != VERSION))
+    {
+        throw std::runtime_error("Not a flight recorder dump");
+    }
+
+    auto numNames = getVarint(data, offset);
+    for (uint64_t i = 0; i < numNames; i++)
+    {
+        auto size = getVarint(data, offset);
+        if (size > data.size() - offset)
+        {
+            throw std::runtime_error("Truncated flight recorder dump");
+        }
+
+        dump.names.emplace_back(data.begin() + offset,
+                                data.begin() + offset + size);
+        offset += size;
+    }
+
+    std::vector<uint32_t> lastValues(dump.names.size(), 0);
+    uint64_t lastTime = 0;
+
+    auto numEntries = getVarint(data, offset);
+    for (uint64_t i = 0; i < numEntries; i++)
+    {
+        Entry entry;
+        lastTime += getVarint(data, offset);
+        entry.timestamp = lastTime;
+        entry.type = static_cast<Type>(getByte(data, offset));
+
+        auto name = getVarint(data, offset);
+        if (name >= dump.names.size())
+        {
+            throw std::runtime_error("Invalid flight recorder name");
+        }
+        entry.name = name;
+
+        entry.value = lastValues[name] ^ getVarint(data, offset);
+        lastValues[name] = entry.value;
+
+        dump.entries.push_back(entry);
+    }
+
+    return dump;
+}
+
+std::string FlightRecorder::dump(const std::string& reason,
+                                 const std::string& dir) const
+{
+    auto prefix = device + '_';
+    fs::path path;
+
+    try
+    {
+        fs::create_directories(dir);
+
+        // Find the existing dumps of this device, oldest first
+        std::vector<std::pair<uint64_t, fs::path>> dumps;
+        for (const auto& file : fs::directory_iterator(dir))
+        {
+            auto name = file.path().filename().string();
+            if ((name.compare(0, prefix.size(), prefix) == 0) &&
+                (file.path().extension() == ".bin"))
+            {
+                dumps.emplace_back(getSequence(name, prefix.size()),
+                                   file.path());
+            }
+        }
+        std::sort(dumps.begin(), dumps.end());
+
+        auto sequence = dumps.empty() ? 1 : dumps.back().first + 1;
+        path = fs::path{dir} /
+               (prefix + std::to_string(sequence) + '_' + reason + ".bin");
+
+        auto data = encode();
+
+        // Written under a temporary name so a partial dump is never seen
+        auto temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream file;
+            file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            file.open(temp, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(data.data()),
+                       data.size());
+        }
+        fs::rename(temp, path);
+
+        // Only keep the newest dumps of this device, counting this one
+        for (size_t i = 0; dumps.size() - i >= MAX_DUMPS; i++)
+        {
+            fs::remove(dumps[i].second);
+        }
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed writing flight recorder dump",
+                        entry("DEVICE=%s", device.c_str()),
+                        entry("REASON=%s", reason.c_str()),
+                        entry("ERROR=%s", e.what()));
+        return std::string{};
+    }
+
+    log<level::INFO>("Wrote flight recorder dump",
+                     entry("PATH=%s", path.c_str()),
+                     entry("ENTRIES=%zu", count));
+
+    return path;
+}
+
+uint64_t FlightRecorder::getMonotonicTime()
+{
+    using namespace std::chrono;
+
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace power
+} // namespace witherspoon
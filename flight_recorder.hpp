@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class FlightRecorder
+ *
+ * Remembers the most recent register reads, GPI samples, and state
+ * changes of a device, with monotonic timestamps, in a fixed size
+ * ring.  When the device faults the ring is dumped to a file so the
+ * lead up to the fault can be seen, not just the registers at the
+ * time the error was created.
+ *
+ * Each value is recorded under a name, like 'status0' or 'present',
+ * which is stored once in a table rather than in every entry.
+ *
+ * The dump is compressed with delta and varint encoding, which shrinks
+ * the typical entry from 16 bytes to about 6, since the timestamps are
+ * close together and most values are the same as the last time:
+ *
+ *   uint32  magic, MAGIC
+ *   uint8   version, VERSION
+ *   varint  number of names, then each as a varint length and bytes
+ *   varint  number of entries, oldest first, then for each:
+ *     varint  microseconds since the previous entry, or since 0
+ *     uint8   Type
+ *     varint  name index
+ *     varint  value XORed with the previous value of the same name
+ */
+class FlightRecorder
+{
+  public:
+    static constexpr uint32_t MAGIC = 0x52464650; // 'PFFR'
+    static constexpr uint8_t VERSION = 1;
+
+    /**
+     * @brief How many dumps of a device to keep
+     */
+    static constexpr size_t MAX_DUMPS = 8;
+
+    /**
+     * @brief Where the dumps are written
+     */
+    static constexpr auto DUMP_DIR = "/var/lib/power-faults";
+
+    /**
+     * @brief What a recorded value is
+     */
+    enum class Type : uint8_t
+    {
+        reg = 0,
+        gpi = 1,
+        state = 2
+    };
+
+    /**
+     * @brief A recorded value
+     */
+    struct Entry
+    {
+        /**
+         * @brief The monotonic time in microseconds
+         */
+        uint64_t timestamp;
+
+        /**
+         * @brief The value
+         */
+        uint32_t value;
+
+        /**
+         * @brief The index of the name
+         */
+        uint16_t name;
+
+        /**
+         * @brief The type of the value
+         */
+        Type type;
+    };
+
+    /**
+     * @brief The contents of a dump
+     */
+    struct Dump
+    {
+        std::vector<std::string> names;
+        std::vector<Entry> entries;
+    };
+
+    FlightRecorder() = delete;
+    ~FlightRecorder() = default;
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    FlightRecorder(FlightRecorder&&) = default;
+    FlightRecorder& operator=(FlightRecorder&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] device - the device name used in the dump file names
+     * @param[in] capacity - the number of entries to keep
+     */
+    FlightRecorder(const std::string& device, size_t capacity);
+
+    /**
+     * @brief Adds a name to the table, if it isn't already there
+     *
+     * Values recorded on every poll should use the returned index,
+     * so the name doesn't have to be looked up each time.
+     *
+     * @param[in] name - the name of a value
+     *
+     * @return uint16_t - the index of the name
+     */
+    uint16_t addName(const std::string& name);
+
+    /**
+     * @brief Records a value with the current time
+     *
+     * @param[in] type - the type of the value
+     * @param[in] name - the index of the name, from addName()
+     * @param[in] value - the value
+     */
+    void record(Type type, uint16_t name, uint32_t value);
+
+    /**
+     * @brief Records a value
+     *
+     * @param[in] timestamp - the monotonic time in microseconds
+     * @param[in] type - the type of the value
+     * @param[in] name - the index of the name, from addName()
+     * @param[in] value - the value
+     */
+    void record(uint64_t timestamp, Type type, uint16_t name, uint32_t value);
+
+    /**
+     * @brief Records a value with the current time
+     *
+     * @param[in] type - the type of the value
+     * @param[in] name - the name of the value
+     * @param[in] value - the value
+     */
+    void record(Type type, const std::string& name, uint32_t value);
+
+    /**
+     * @brief Records a value
+     *
+     * @param[in] timestamp - the monotonic time in microseconds
+     * @param[in] type - the type of the value
+     * @param[in] name - the name of the value
+     * @param[in] value - the value
+     */
+    void record(uint64_t timestamp, Type type, const std::string& name,
+                uint32_t value);
+
+    /**
+     * @brief Records that an error was logged, and dumps the entries
+     *
+     * @param[in] errName - the error name, like
+     *                      org.open_power.Witherspoon.Fault.Error.Foo,
+     *                      of which just the last part is used
+     */
+    void fault(const std::string& errName);
+
+    /**
+     * @brief Writes the entries to a new file in a directory, and
+     *        removes the oldest dumps beyond MAX_DUMPS.
+     *
+     * The files are named <device>_<sequence>_<reason>.bin, where the
+     * sequence number is one more than the newest dump of the device,
+     * so the order doesn't depend on the file times.
+     *
+     * Failures are logged but not thrown, since this is done
+     * while handling a fault.
+     *
+     * @param[in] reason - what the dump is for, like the error name
+     * @param[in] dir - the directory
+     *
+     * @return std::string - the file path, or empty on a failure
+     */
+    std::string dump(const std::string& reason,
+                     const std::string& dir = DUMP_DIR) const;
+
+    /**
+     * @brief Returns the entries, compressed as described above
+     */
+    std::vector<uint8_t> encode() const;
+
+    /**
+     * @brief Reads back the output of encode()
+     *
+     * @param[in] data - the encoded entries
+     *
+     * @return Dump - the names and entries
+     */
+    static Dump decode(const std::vector<uint8_t>& data);
+
+    /**
+     * @brief Removes all of the entries
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of entries
+     */
+    inline size_t getCount() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Returns the current monotonic time in microseconds
+     */
+    static uint64_t getMonotonicTime();
+
+  private:
+    /**
+     * @brief The device name
+     */
+    std::string device;
+
+    /**
+     * @brief The names, indexed by Entry::name
+     */
+    std::vector<std::string> names;
+
+    /**
+     * @brief The ring of entries, allocated once
+     */
+    std::vector<Entry> entries;
+
+    /**
+     * @brief The index of the next entry to write
+     */
+    size_t head = 0;
+
+    /**
+     * @brief The number of valid entries
+     */
+    size_t count = 0;
+};
+
+} // namespace power
+} // namespace witherspoon
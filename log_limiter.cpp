@@ -0,0 +1,79 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_limiter.hpp"
+
+#include <algorithm>
+
+namespace witherspoon
+{
+namespace power
+{
+
+LogLimiter::LogLimiter(size_t burst, Clock::duration refill) :
+    burst(std::max<size_t>(burst, 1)), refill(refill), tokens(this->burst)
+{
+}
+
+bool LogLimiter::allow()
+{
+    return allow(Clock::now());
+}
+
+bool LogLimiter::allow(Clock::time_point now)
+{
+    if ((tokens < burst) && (refill.count() > 0) && (now > lastRefill))
+    {
+        auto added = static_cast<size_t>((now - lastRefill) / refill);
+        if (added >= burst - tokens)
+        {
+            tokens = burst;
+        }
+        else
+        {
+            tokens += added;
+            lastRefill += added * refill;
+        }
+    }
+
+    if ((tokens == 0) && (refill.count() > 0))
+    {
+        suppressed++;
+        return false;
+    }
+
+    // Refilling starts once the bucket isn't full
+    if (tokens == burst)
+    {
+        lastRefill = now;
+    }
+
+    if (tokens > 0)
+    {
+        tokens--;
+    }
+
+    return true;
+}
+
+size_t LogLimiter::takeSuppressed()
+{
+    auto count = suppressed;
+    suppressed = 0;
+    return count;
+}
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class LogLimiter
+ *
+ * Limits how often a single journal message can be logged, for
+ * messages that would otherwise be logged on every poll while a
+ * condition holds.
+ *
+ * It is a token bucket: it starts with 'burst' tokens, each logged
+ * message uses one, and one is added back every 'refill' up to the
+ * burst.  Messages that come in with no tokens left are counted as
+ * suppressed, and the count is taken and logged with the next message
+ * that is allowed, so nothing goes missing without a trace.
+ *
+ * There should be one of these per message, or per condition when
+ * its set and cleared messages would flap together.
+ */
+class LogLimiter
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The defaults, which let a poll loop log a few times right
+     *        away and then about once a minute
+     */
+    static constexpr size_t DEFAULT_BURST = 3;
+    static constexpr auto DEFAULT_REFILL = std::chrono::seconds{60};
+
+    ~LogLimiter() = default;
+    LogLimiter(const LogLimiter&) = default;
+    LogLimiter& operator=(const LogLimiter&) = default;
+    LogLimiter(LogLimiter&&) = default;
+    LogLimiter& operator=(LogLimiter&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] burst - how many messages can be logged back to back
+     * @param[in] refill - how long it takes to get another token
+     */
+    explicit LogLimiter(size_t burst = DEFAULT_BURST,
+                        Clock::duration refill = DEFAULT_REFILL);
+
+    /**
+     * @brief Says if a message can be logged now, and if not counts
+     *        it as suppressed.
+     *
+     * @return bool - true if the message should be logged
+     */
+    bool allow();
+
+    /**
+     * @brief Says if a message can be logged at a point in time
+     *
+     * @param[in] now - the current time
+     *
+     * @return bool - true if the message should be logged
+     */
+    bool allow(Clock::time_point now);
+
+    /**
+     * @brief Returns the number of messages suppressed since this was
+     *        last called, and resets it.
+     *
+     * Meant to be added to the next message that is logged, like:
+     *   entry("SUPPRESSED=%zu", limiter.takeSuppressed())
+     */
+    size_t takeSuppressed();
+
+  private:
+    /**
+     * @brief The maximum number of tokens
+     */
+    size_t burst;
+
+    /**
+     * @brief How long it takes to add a token
+     */
+    Clock::duration refill;
+
+    /**
+     * @brief The current number of tokens
+     */
+    size_t tokens;
+
+    /**
+     * @brief When the last token was added, or when the bucket
+     *        was last full
+     */
+    Clock::time_point lastRefill;
+
+    /**
+     * @brief The number of messages suppressed
+     */
+    size_t suppressed = 0;
+};
+
+} // namespace power
+} // namespace witherspoon
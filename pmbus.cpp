@@ -57,6 +57,8 @@ std::string PMBus::insertPageNum(const std::string& templateName, size_t page)
     return name;
 }
 
+fs::path PMBus::debugRoot = "/sys/kernel/debug/";
+
 fs::path PMBus::getPath(Type type)
 {
     switch (type)
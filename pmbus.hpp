@@ -147,6 +147,18 @@ class PMBus
         findHwmonDir();
     }
 
+    /**
+     * Changes where the debug directories are, for running against
+     * a fake sysfs and debugfs tree.  Only affects PMBus objects
+     * created after it is called.
+     *
+     * @param[in] path - the new root, in place of /sys/kernel/debug/
+     */
+    static void setDebugRoot(const fs::path& path)
+    {
+        debugRoot = path;
+    }
+
     /**
      * Reads a file in sysfs that represents a single bit,
      * therefore doing a PMBus read.
@@ -300,10 +312,15 @@ class PMBus
      */
     size_t instance = 0;
 
+    /**
+     * The root of the debug directories, normally /sys/kernel/debug/
+     */
+    static fs::path debugRoot;
+
     /**
      * The pmbus debug path with status files
      */
-    const fs::path debugPath = "/sys/kernel/debug/";
+    const fs::path debugPath = debugRoot;
 };
 
 } // namespace pmbus
@@ -17,6 +17,7 @@
 #include "pgood_monitor.hpp"
 #include "runtime_monitor.hpp"
 #include "ucd90160.hpp"
+#include "work_queue.hpp"
 
 #include <chrono>
 #include <iostream>
@@ -49,7 +50,8 @@ int main(int argc, char** argv)
 
     auto event = sdeventplus::Event::get_default();
     auto bus = sdbusplus::bus::new_default();
-    bus.attach_event(event.get(), SD_EVENT_PRIORITY_NORMAL);
+    // The PowerLost signal is handled along with the polling
+    bus.attach_event(event.get(), PRIORITY_FAULT);
 
     auto device = std::make_unique<UCD90160>(0, bus);
 
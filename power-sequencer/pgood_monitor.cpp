@@ -60,8 +60,8 @@ bool PGOODMonitor::pgoodPending()
 
 void PGOODMonitor::analyze()
 {
-    // Timer callback.
-    // The timer expired before it was stopped.
+    // Poll callback.
+    // The time ran out before it was stopped.
     // If PGOOD is still pending (it should be),
     // then there is a real failure.
 
@@ -75,7 +75,7 @@ void PGOODMonitor::analyze()
 
     // The pgood-wait service (with a longer timeout)
     // will handle powering off the system.
-    timer.get_event().exit(EXIT_SUCCESS);
+    scheduler.getEvent().exit(EXIT_SUCCESS);
 }
 
 void PGOODMonitor::propertyChanged()
@@ -85,7 +85,7 @@ void PGOODMonitor::propertyChanged()
     if (!pgoodPending())
     {
         // PGOOD is on, or system is off, so we are done.
-        timer.get_event().exit(EXIT_SUCCESS);
+        scheduler.getEvent().exit(EXIT_SUCCESS);
     }
 }
 
@@ -112,7 +112,7 @@ int PGOODMonitor::run()
             return EXIT_SUCCESS;
         }
 
-        return timer.get_event().loop();
+        return scheduler.run();
     }
     catch (std::exception& e)
     {
@@ -46,7 +46,7 @@ void RuntimeMonitor::onPowerLost(sdbusplus::message::message& msg)
 
     try
     {
-        timer.setEnabled(false);
+        scheduler.setEnabled(pollID, false);
 
 #ifdef UCD90160_DEVICE_ACCESS
         device->onFailure();
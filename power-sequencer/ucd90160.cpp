@@ -37,7 +37,10 @@ const auto MFR_STATUS = "mfr_status"s;
 
 const auto DEVICE_NAME = "UCD90160"s;
 const auto DRIVER_NAME = "ucd9000"s;
-constexpr auto NUM_PAGES = 16;
+
+// Enough for several minutes of polling
+constexpr auto FLIGHT_RECORDER_ENTRIES = 1024;
+constexpr auto FAILURE_STATE = "on_failure";
 
 constexpr auto INVENTORY_OBJ_PATH = "/xyz/openbmc_project/inventory";
 
@@ -53,12 +56,24 @@ UCD90160::UCD90160(size_t instance, sdbusplus::bus::bus& bus) :
     Device(DEVICE_NAME, instance),
     interface(std::get<ucd90160::pathField>(deviceMap.find(instance)->second),
               DRIVER_NAME, instance),
-    gpioDevice(findGPIODevice(interface.path())), bus(bus)
+    gpioDevice(findGPIODevice(interface.path())), bus(bus),
+    flightRecorder(DEVICE_NAME + std::to_string(instance),
+                   FLIGHT_RECORDER_ENTRIES)
 {
+    auto& gpiConfigs = std::get<ucd90160::gpiConfigField>(
+        deviceMap.find(instance)->second);
+
+    for (const auto& gpiConfig : gpiConfigs)
+    {
+        gpiNames.push_back(flightRecorder.addName(
+            std::get<ucd90160::gpiNameField>(gpiConfig)));
+    }
 }
 
 void UCD90160::onFailure()
 {
+    flightRecorder.record(FlightRecorder::Type::state, FAILURE_STATE, true);
+
     try
     {
         auto voutError = checkVOUTFaults();
@@ -103,12 +118,16 @@ void UCD90160::analyze()
 
 uint16_t UCD90160::readStatusWord()
 {
-    return interface.read(STATUS_WORD, Type::Debug);
+    uint16_t value = interface.read(STATUS_WORD, Type::Debug);
+    flightRecorder.record(FlightRecorder::Type::reg, STATUS_WORD, value);
+    return value;
 }
 
 uint32_t UCD90160::readMFRStatus()
 {
-    return interface.read(MFR_STATUS, Type::HwmonDeviceDebug);
+    uint32_t value = interface.read(MFR_STATUS, Type::HwmonDeviceDebug);
+    flightRecorder.record(FlightRecorder::Type::reg, MFR_STATUS, value);
+    return value;
 }
 
 bool UCD90160::checkVOUTFaults()
@@ -132,14 +151,17 @@ bool UCD90160::checkVOUTFaults()
 
         auto statusVout = interface.insertPageNum(STATUS_VOUT, page);
         uint8_t vout = interface.read(statusVout, Type::Debug);
+        flightRecorder.record(FlightRecorder::Type::reg, statusVout, vout);
 
         // If any bits are on log them, though some are just
         // warnings so they won't cause errors
-        if (vout)
+        auto& voutLog = voutLogs[page];
+        if (vout && voutLog.allow())
         {
             log<level::INFO>("A voltage rail has bits on in STATUS_VOUT",
                              entry("STATUS_VOUT=0x%X", vout),
-                             entry("PAGE=%d", page));
+                             entry("PAGE=%d", page),
+                             entry("SUPPRESSED=%zu", voutLog.takeSuppressed()));
         }
 
         // Log errors if any non-warning bits on
@@ -169,6 +191,9 @@ bool UCD90160::checkVOUTFaults()
                 metadata::RAIL(page), metadata::RAIL_NAME(railName.c_str()),
                 metadata::RAW_STATUS(nv.get().c_str()));
 
+            flightRecorder.fault(
+                power_error::PowerSequencerVoltageFault::errName);
+
             setVoutFaultLogged(page);
             errorCreated = true;
         }
@@ -191,8 +216,9 @@ bool UCD90160::checkPGOODFaults(bool polling)
     auto& gpiConfigs = std::get<ucd90160::gpiConfigField>(
         deviceMap.find(getInstance())->second);
 
-    for (const auto& gpiConfig : gpiConfigs)
+    for (size_t i = 0; i < gpiConfigs.size(); i++)
     {
+        const auto& gpiConfig = gpiConfigs[i];
         auto gpiNum = std::get<ucd90160::gpiNumField>(gpiConfig);
         auto doPoll = std::get<ucd90160::pollField>(gpiConfig);
 
@@ -231,6 +257,9 @@ bool UCD90160::checkPGOODFaults(bool polling)
             continue;
         }
 
+        flightRecorder.record(FlightRecorder::Type::gpi, gpiNames[i],
+                              static_cast<uint32_t>(gpiStatus));
+
         if (gpiStatus == Value::low)
         {
             // There may be some extra analysis we can do to narrow the
@@ -268,6 +297,9 @@ bool UCD90160::checkPGOODFaults(bool polling)
                 metadata::INPUT_NAME(gpiName.c_str()),
                 metadata::RAW_STATUS(nv.get().c_str()));
 
+            flightRecorder.fault(
+                power_error::PowerSequencerPGOODFault::errName);
+
             setPGOODFaultLogged(gpiNum);
             errorCreated = true;
         }
@@ -295,6 +327,8 @@ void UCD90160::createPowerFaultLog()
 
     report<power_error::PowerSequencerFault>(
         metadata::RAW_STATUS(nv.get().c_str()));
+
+    flightRecorder.fault(power_error::PowerSequencerFault::errName);
 }
 
 fs::path UCD90160::findGPIODevice(const fs::path& path)
@@ -397,6 +431,10 @@ bool UCD90160::doGPIOAnalysis(ucd90160::extraAnalysisType type)
             continue;
         }
 
+        flightRecorder.record(FlightRecorder::Type::gpi,
+                              std::get<ucd90160::gpioCalloutField>(gpio),
+                              static_cast<uint32_t>(value));
+
         if (value == polarity)
         {
             errorFound = true;
@@ -460,6 +498,8 @@ void UCD90160::gpuPGOODError(const std::string& callout)
     report<power_error::GPUPowerFault>(
         metadata::RAW_STATUS(nv.get().c_str()),
         metadata::CALLOUT_INVENTORY_PATH(callout.c_str()));
+
+    flightRecorder.fault(power_error::GPUPowerFault::errName);
 }
 
 void UCD90160::gpuOverTempError(const std::string& callout)
@@ -482,6 +522,8 @@ void UCD90160::gpuOverTempError(const std::string& callout)
     report<power_error::GPUOverTemp>(
         metadata::RAW_STATUS(nv.get().c_str()),
         metadata::CALLOUT_INVENTORY_PATH(callout.c_str()));
+
+    flightRecorder.fault(power_error::GPUOverTemp::errName);
 }
 
 void UCD90160::memGoodError(const std::string& callout)
@@ -504,6 +546,8 @@ void UCD90160::memGoodError(const std::string& callout)
     report<power_error::MemoryPowerFault>(
         metadata::RAW_STATUS(nv.get().c_str()),
         metadata::CALLOUT_INVENTORY_PATH(callout.c_str()));
+
+    flightRecorder.fault(power_error::MemoryPowerFault::errName);
 }
 
 } // namespace power
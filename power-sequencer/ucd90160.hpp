@@ -1,11 +1,14 @@
 #pragma once
 
 #include "device.hpp"
+#include "flight_recorder.hpp"
 #include "gpio.hpp"
+#include "log_limiter.hpp"
 #include "pmbus.hpp"
 #include "types.hpp"
 
 #include <algorithm>
+#include <array>
 #include <filesystem>
 #include <map>
 #include <sdbusplus/bus.hpp>
@@ -64,6 +67,11 @@ class UCD90160 : public Device
     }
 
   private:
+    /**
+     * The number of PMBus pages, one per voltage rail
+     */
+    static constexpr size_t NUM_PAGES = 16;
+
     /**
      * Reports an error for a GPU PGOOD failure
      *
@@ -303,6 +311,25 @@ class UCD90160 : public Device
      */
     sdbusplus::bus::bus& bus;
 
+    /**
+     * Records the recent register reads and GPI samples,
+     * to dump when a fault is found
+     */
+    FlightRecorder flightRecorder;
+
+    /**
+     * The flight recorder name index of each GPI, in the same
+     * order as the GPI configs, since they're recorded every poll
+     */
+    std::vector<uint16_t> gpiNames;
+
+    /**
+     * Limits the STATUS_VOUT journal messages of each page, since
+     * warning bits can stay on for every poll.  Per page, so a rail
+     * with warnings doesn't hide another rail's messages.
+     */
+    std::array<LogLimiter, NUM_PAGES> voutLogs;
+
     /**
      * Map of device instance to the instance specific data
      */
@@ -79,6 +79,25 @@ void ArgumentParser::usage(char** argv)
                  " for the GPIO that performs the sync function\n";
     std::cerr << "    --sync-gpio-num=<path>              GPIO number for the"
                  " GPIO that performs the sync function\n";
+    std::cerr << "    --full-history-interval=<records>   Number of new"
+                 " records between updates of the full history arrays,"
+                 " 0 for never\n";
+    std::cerr << "    --history-file-dir=<dir>            Directory to keep"
+                 " the history records in across restarts\n";
+    std::cerr << "    --history-archive-dir=<dir>         Directory to keep"
+                 " weeks of history records in on flash\n";
+    std::cerr << "    --system-history=<num supplies>     Also provide the"
+                 " system total history of this many power supplies\n";
+    std::cerr << "    --sample-interval=<ms>              Sample the sensors"
+                 " this often, from 100 to 10000 ms\n";
+    std::cerr << "    --sample-window=<samples>           Number of samples"
+                 " in each window of sensor statistics\n";
+    std::cerr << "    --telemetry-slots=<samples>         Number of samples"
+                 " to keep in the shared memory telemetry ring\n";
+    std::cerr << "    --vpd-cache-dir=<dir>               Directory to keep"
+                 " the VPD of known power supplies in\n";
+    std::cerr << "    --energy-dir=<dir>                  Accumulate the"
+                 " input energy, kept in this directory across restarts\n";
     std::cerr << std::flush;
 }
 
@@ -89,11 +108,20 @@ const option ArgumentParser::options[] = {
     {"num-history-records", required_argument, NULL, 'r'},
     {"sync-gpio-path", required_argument, NULL, 'a'},
     {"sync-gpio-num", required_argument, NULL, 'u'},
+    {"full-history-interval", required_argument, NULL, 'f'},
+    {"history-file-dir", required_argument, NULL, 'd'},
+    {"history-archive-dir", required_argument, NULL, 'c'},
+    {"system-history", required_argument, NULL, 's'},
+    {"sample-interval", required_argument, NULL, 'm'},
+    {"sample-window", required_argument, NULL, 'w'},
+    {"telemetry-slots", required_argument, NULL, 't'},
+    {"vpd-cache-dir", required_argument, NULL, 'v'},
+    {"energy-dir", required_argument, NULL, 'e'},
     {"help", no_argument, NULL, 'h'},
     {0, 0, 0, 0},
 };
 
-const char* ArgumentParser::optionStr = "p:n:i:r:a:u:h";
+const char* ArgumentParser::optionStr = "p:n:i:r:a:u:f:d:c:s:m:w:t:v:e:h";
 
 const std::string ArgumentParser::trueString = "true";
 const std::string ArgumentParser::emptyString = "";
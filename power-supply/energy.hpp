@@ -0,0 +1,90 @@
+#pragma once
+#include "energy_accumulator.hpp"
+
+#include <functional>
+#include <org/open_power/Witherspoon/Sensor/Energy/server.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+template <typename T>
+using ServerObject = typename sdbusplus::server::object::object<T>;
+
+using EnergyInterface =
+    sdbusplus::org::open_power::Witherspoon::Sensor::server::Energy;
+
+/**
+ * @class Energy
+ *
+ * Implements Witherspoon.Sensor.Energy
+ *
+ * This includes properties for the accumulated energy in watt-hours,
+ * when accumulation started, the time no measurement covered, and
+ * where the energy came from.
+ */
+class Energy : public ServerObject<EnergyInterface>
+{
+  public:
+    static constexpr auto interface =
+        "org.open_power.Witherspoon.Sensor.Energy";
+
+    /**
+     * @brief The D-Bus object path the energy objects go under
+     */
+    static constexpr auto ENERGY_ROOT = "/org/open_power/sensors/energy";
+
+    Energy() = delete;
+    Energy(const Energy&) = delete;
+    Energy& operator=(const Energy&) = delete;
+    Energy(Energy&&) = delete;
+    Energy& operator=(Energy&&) = delete;
+    ~Energy() = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path
+     */
+    Energy(sdbusplus::bus::bus& bus, const std::string& objectPath) :
+        ServerObject<EnergyInterface>(bus, objectPath.c_str())
+    {
+    }
+
+    /**
+     * @brief Updates the properties from an accumulator
+     *
+     * @param[in] accumulator - the accumulator
+     */
+    void update(const EnergyAccumulator& accumulator)
+    {
+        using Accumulated = EnergyAccumulator::Source;
+
+        value(accumulator.getWattHours());
+        start(accumulator.getStart());
+        unmeasured(accumulator.getUnmeasured());
+
+        switch (accumulator.getSource())
+        {
+            case Accumulated::InputHistory:
+                source(Source::InputHistory);
+                break;
+            case Accumulated::Samples:
+                source(Source::Samples);
+                break;
+            case Accumulated::ReadEIN:
+                source(Source::ReadEIN);
+                break;
+            case Accumulated::None:
+                break;
+        }
+    }
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
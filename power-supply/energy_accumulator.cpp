@@ -0,0 +1,220 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "energy_accumulator.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <phosphor-logging/log.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr uint64_t maxFillGap =
+    std::chrono::duration_cast<std::chrono::milliseconds>(
+        EnergyAccumulator::MAX_FILL_GAP)
+        .count();
+
+} // namespace
+
+EnergyAccumulator::EnergyAccumulator(const std::string& path) : path(path)
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    std::ifstream file{path};
+    if (!(file >> start >> end >> unmeasured >> joules) || (end < start) ||
+        !std::isfinite(joules))
+    {
+        start = 0;
+        end = 0;
+        unmeasured = 0;
+        joules = 0;
+    }
+}
+
+void EnergyAccumulator::add(uint64_t from, uint64_t to, double watts,
+                            Source powerSource)
+{
+    if (to <= from)
+    {
+        return;
+    }
+
+    watts = std::max(watts, 0.0);
+
+    if (start == 0)
+    {
+        start = from;
+        end = from;
+    }
+
+    // The clock was set back, so continue from the new time
+    if (to + maxFillGap < end)
+    {
+        end = from;
+    }
+
+    if (from > end)
+    {
+        auto gap = from - end;
+        if (gap <= maxFillGap)
+        {
+            joules += watts * gap / 1000.0;
+        }
+        else
+        {
+            unmeasured += gap;
+        }
+        end = from;
+    }
+
+    // Already covered by an earlier or finer interval
+    if (to <= end)
+    {
+        return;
+    }
+
+    joules += watts * (to - end) / 1000.0;
+    end = to;
+    source = powerSource;
+}
+
+void EnergyAccumulator::addSample(uint64_t timestamp, double watts)
+{
+    if (lastSample && (timestamp > lastSample->first) &&
+        (timestamp - lastSample->first <= maxFillGap))
+    {
+        add(lastSample->first, timestamp, (lastSample->second + watts) / 2,
+            Source::Samples);
+    }
+
+    lastSample = std::make_pair(timestamp, watts);
+}
+
+void EnergyAccumulator::addEIN(uint64_t timestamp,
+                               const std::vector<uint8_t>& data)
+{
+    if (data.size() != EIN_SIZE)
+    {
+        return;
+    }
+
+    EINReading reading;
+    reading.timestamp = timestamp;
+    reading.accumulator = data[0] | (data[1] << 8);
+    reading.rollovers = data[2];
+    reading.samples = data[3] | (data[4] << 8) | (data[5] << 16);
+
+    if (lastEIN && (timestamp > lastEIN->timestamp) &&
+        (timestamp - lastEIN->timestamp <= maxFillGap))
+    {
+        uint32_t samples = (reading.samples - lastEIN->samples) & 0xFFFFFF;
+
+        // Nothing new was sampled, so wait for a reading that has
+        if (samples == 0)
+        {
+            return;
+        }
+
+        uint8_t rollovers = reading.rollovers - lastEIN->rollovers;
+        int64_t growth = static_cast<int64_t>(rollovers) * EIN_ROLLOVER +
+                         reading.accumulator - lastEIN->accumulator;
+
+        auto y = static_cast<double>(growth) / samples;
+        auto watts = (y * std::pow(10.0, -einR) - einB) / einM;
+
+        add(lastEIN->timestamp, timestamp, watts, Source::ReadEIN);
+    }
+
+    lastEIN = reading;
+}
+
+void EnergyAccumulator::setEINCoefficients(int16_t m, int16_t b, int8_t r)
+{
+    if (m == 0)
+    {
+        return;
+    }
+
+    einM = m;
+    einB = b;
+    einR = r;
+    lastEIN.reset();
+}
+
+void EnergyAccumulator::reset()
+{
+    lastSample.reset();
+    lastEIN.reset();
+}
+
+void EnergyAccumulator::save() const
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path{path}.parent_path(), ec);
+
+    // Written under a temporary name so a partial file is never seen
+    auto temp = path + ".tmp";
+
+    {
+        std::ofstream file{temp, std::ios::trunc};
+        file << start << ' ' << end << ' ' << unmeasured << ' '
+             << std::setprecision(std::numeric_limits<double>::max_digits10)
+             << joules << '\n';
+
+        file.flush();
+        if (!file)
+        {
+            log<level::ERR>("Failed writing the input energy",
+                            entry("PATH=%s", temp.c_str()));
+            return;
+        }
+    }
+
+    if (std::rename(temp.c_str(), path.c_str()) != 0)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed renaming the input energy file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+    }
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class EnergyAccumulator
+ *
+ * Integrates the input power of a power supply into energy.
+ *
+ * The power comes in as the average power over intervals of time, from
+ * whichever sources the power supply has: the deltas of the PMBus
+ * READ_EIN energy accumulator, the sampled input power sensor, or the
+ * 30 second input power history averages.  The accumulator keeps the
+ * time it has energy up to, and only adds the part of an interval
+ * after it, so when the finer sources have already covered a history
+ * record's 30 seconds that record adds nothing, and a record that
+ * overlaps the previous one after a SYNC isn't counted twice.
+ *
+ * A gap between intervals of up to MAX_FILL_GAP, like a missed record,
+ * is filled in with the power of the interval after it.  A longer gap,
+ * like the power supply being pulled, is left out of the energy and
+ * added to the unmeasured time instead.
+ *
+ * The state is kept in a file so the energy continues across
+ * restarts.  The caller decides how often to save it.
+ */
+class EnergyAccumulator
+{
+  public:
+    /**
+     * @brief Where the power came from
+     */
+    enum class Source
+    {
+        None,
+        InputHistory,
+        Samples,
+        ReadEIN
+    };
+
+    /**
+     * @brief The longest gap between intervals that is filled in
+     */
+    static constexpr auto MAX_FILL_GAP = std::chrono::minutes{2};
+
+    /**
+     * @brief The size of a READ_EIN response, which is a 2 byte
+     *        accumulator, a 1 byte rollover count, and a 3 byte
+     *        sample count.
+     */
+    static constexpr size_t EIN_SIZE = 6;
+
+    /**
+     * @brief The READ_EIN accumulator rolls over to 0 after this
+     */
+    static constexpr uint32_t EIN_ROLLOVER = 0x8000;
+
+    EnergyAccumulator() = delete;
+    ~EnergyAccumulator() = default;
+    EnergyAccumulator(const EnergyAccumulator&) = delete;
+    EnergyAccumulator& operator=(const EnergyAccumulator&) = delete;
+    EnergyAccumulator(EnergyAccumulator&&) = delete;
+    EnergyAccumulator& operator=(EnergyAccumulator&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Restores the state from the file, if there is one.
+     *
+     * @param[in] path - the file to keep the state in, or empty
+     *                   to not keep it
+     */
+    explicit EnergyAccumulator(const std::string& path);
+
+    /**
+     * @brief Adds the energy of an interval of average power
+     *
+     * @param[in] from - the start of the interval, in milliseconds
+     *                   since the epoch
+     * @param[in] to - the end of the interval
+     * @param[in] watts - the average power over it
+     * @param[in] powerSource - where the power came from
+     */
+    void add(uint64_t from, uint64_t to, double watts, Source powerSource);
+
+    /**
+     * @brief Adds the energy since the previous power sample, using
+     *        the mean of the two samples.
+     *
+     * @param[in] timestamp - the sample time, in milliseconds
+     *                        since the epoch
+     * @param[in] watts - the power
+     */
+    void addSample(uint64_t timestamp, double watts);
+
+    /**
+     * @brief Adds the energy since the previous READ_EIN response
+     *
+     * The average power over the time between them is the growth of
+     * the accumulator, including its rollovers, divided by the growth
+     * of the sample count, converted from the DIRECT format with the
+     * coefficients from setEINCoefficients().
+     *
+     * @param[in] timestamp - the time it was read, in milliseconds
+     *                        since the epoch
+     * @param[in] data - the READ_EIN response
+     */
+    void addEIN(uint64_t timestamp, const std::vector<uint8_t>& data);
+
+    /**
+     * @brief Sets the DIRECT format coefficients of READ_EIN, from
+     *        the power supply's COEFFICIENTS command, where the
+     *        power is (Y * 10^-R - b) / m.
+     *
+     * @param[in] m - the slope
+     * @param[in] b - the offset
+     * @param[in] r - the exponent
+     */
+    void setEINCoefficients(int16_t m, int16_t b, int8_t r);
+
+    /**
+     * @brief Forgets the previous sample and READ_EIN response, for
+     *        when the power supply is removed.
+     */
+    void reset();
+
+    /**
+     * @brief Writes the state to the file
+     */
+    void save() const;
+
+    /**
+     * @brief Returns the energy in watt-hours
+     */
+    inline double getWattHours() const
+    {
+        return joules / 3600.0;
+    }
+
+    /**
+     * @brief Returns when accumulation started, in milliseconds
+     *        since the epoch, or 0 if it hasn't.
+     */
+    inline uint64_t getStart() const
+    {
+        return start;
+    }
+
+    /**
+     * @brief Returns the time the energy goes up to
+     */
+    inline uint64_t getEnd() const
+    {
+        return end;
+    }
+
+    /**
+     * @brief Returns the milliseconds not covered by any interval
+     */
+    inline uint64_t getUnmeasured() const
+    {
+        return unmeasured;
+    }
+
+    /**
+     * @brief Returns where the most recent energy came from
+     */
+    inline Source getSource() const
+    {
+        return source;
+    }
+
+  private:
+    /**
+     * @brief A READ_EIN response
+     */
+    struct EINReading
+    {
+        uint64_t timestamp;
+        uint32_t accumulator;
+        uint8_t rollovers;
+        uint32_t samples;
+    };
+
+    /**
+     * @brief The file to keep the state in
+     */
+    const std::string path;
+
+    /**
+     * @brief The energy in joules
+     */
+    double joules = 0;
+
+    /**
+     * @brief When accumulation started
+     */
+    uint64_t start = 0;
+
+    /**
+     * @brief The time the energy goes up to
+     */
+    uint64_t end = 0;
+
+    /**
+     * @brief The milliseconds not covered by any interval
+     */
+    uint64_t unmeasured = 0;
+
+    /**
+     * @brief Where the most recent energy came from
+     */
+    Source source = Source::None;
+
+    /**
+     * @brief The previous power sample time and power
+     */
+    std::optional<std::pair<uint64_t, double>> lastSample;
+
+    /**
+     * @brief The previous READ_EIN response
+     */
+    std::optional<EINReading> lastEIN;
+
+    /**
+     * @brief The READ_EIN DIRECT format coefficients
+     */
+    int16_t einM = 1;
+    int16_t einB = 0;
+    int8_t einR = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
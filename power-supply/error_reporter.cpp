@@ -0,0 +1,144 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "error_reporter.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+
+ErrorReporter::ErrorReporter(const sdeventplus::Event& event,
+                             Clock::duration window) :
+    window(window),
+    timer(event, std::bind([this]() {
+              this->commitNext();
+
+              // One at a time so the polling isn't held up
+              if (!this->pending.empty())
+              {
+                  this->timer.restartOnce(std::chrono::milliseconds{0});
+              }
+          }))
+{
+}
+
+ErrorReporter::~ErrorReporter()
+{
+    flush();
+}
+
+bool ErrorReporter::report(const std::string& errName,
+                           const std::string& callout,
+                           const std::string& registers, Commit&& commit)
+{
+    return report(Clock::now(), errName, callout, registers,
+                  std::move(commit));
+}
+
+bool ErrorReporter::report(Clock::time_point now, const std::string& errName,
+                           const std::string& callout,
+                           const std::string& registers, Commit&& commit)
+{
+    for (auto f = faults.begin(); f != faults.end();)
+    {
+        if (now - f->second.first >= window)
+        {
+            f = faults.erase(f);
+        }
+        else
+        {
+            ++f;
+        }
+    }
+
+    auto fingerprint = errName + '\n' + callout + '\n' + registers;
+
+    auto f = faults.find(fingerprint);
+    if (f != faults.end())
+    {
+        f->second.count++;
+
+        log<level::INFO>("Coalesced a repeated error",
+                         entry("ERROR=%s", errName.c_str()),
+                         entry("CALLOUT=%s", callout.c_str()),
+                         entry("OCCURRENCES=%zu", f->second.count));
+        return false;
+    }
+
+    faults.emplace(fingerprint, Occurrence{errName, callout, now, 1});
+
+    pending.push_back(std::move(commit));
+    if (!timer.isEnabled())
+    {
+        timer.restartOnce(std::chrono::milliseconds{0});
+    }
+
+    return true;
+}
+
+void ErrorReporter::resolve(const std::string& errName,
+                            const std::string& callout)
+{
+    for (auto f = faults.begin(); f != faults.end();)
+    {
+        if ((f->second.errName == errName) && (f->second.callout == callout))
+        {
+            f = faults.erase(f);
+        }
+        else
+        {
+            ++f;
+        }
+    }
+}
+
+void ErrorReporter::flush()
+{
+    timer.setEnabled(false);
+
+    while (!pending.empty())
+    {
+        commitNext();
+    }
+}
+
+void ErrorReporter::commitNext()
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    auto commit = std::move(pending.front());
+    pending.pop_front();
+
+    try
+    {
+        commit();
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to create an error log",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+#include <string>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class ErrorReporter
+ *
+ * Sits between fault analysis and phosphor-logging, so that:
+ *
+ * 1) The same fault seen again within a window, like when a power
+ *    supply is pulled and reseated and the faults are cleared, doesn't
+ *    create another error log.  A fault is identified by a fingerprint
+ *    of its error name, callout, and key register values.  The repeats
+ *    are counted and the count is put in the journal.
+ *
+ * 2) Creating the error log, which is a D-Bus call into the logging
+ *    daemon, is done from the event loop after the current analysis
+ *    returns instead of in the middle of it.  Anything still queued
+ *    is committed when this is destroyed.
+ */
+class ErrorReporter
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Creates the error log when called
+     */
+    using Commit = std::function<void()>;
+
+    /**
+     * @brief How long a fault is remembered
+     */
+    static constexpr auto DEFAULT_WINDOW = std::chrono::minutes{10};
+
+    ErrorReporter() = delete;
+    ~ErrorReporter();
+    ErrorReporter(const ErrorReporter&) = delete;
+    ErrorReporter& operator=(const ErrorReporter&) = delete;
+    ErrorReporter(ErrorReporter&&) = delete;
+    ErrorReporter& operator=(ErrorReporter&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] event - the event loop to commit from
+     * @param[in] window - how long to coalesce repeats of a fault for
+     */
+    ErrorReporter(const sdeventplus::Event& event,
+                  Clock::duration window = DEFAULT_WINDOW);
+
+    /**
+     * @brief Queues an error log, unless the same fault was already
+     *        reported within the window.
+     *
+     * The commit function runs later, so it must hold copies of
+     * anything it needs and not pointers into the caller.
+     *
+     * @param[in] errName - the error name
+     * @param[in] callout - the callout, like an inventory path
+     * @param[in] registers - the key register values
+     * @param[in] commit - creates the error log
+     *
+     * @return bool - true if it was queued, false if it was a repeat
+     */
+    bool report(const std::string& errName, const std::string& callout,
+                const std::string& registers, Commit&& commit);
+
+    /**
+     * @brief Like above, with the current time passed in
+     */
+    bool report(Clock::time_point now, const std::string& errName,
+                const std::string& callout, const std::string& registers,
+                Commit&& commit);
+
+    /**
+     * @brief Forgets the faults of an error name and callout, for when
+     *        their error logs are resolved, so a new occurrence is
+     *        logged again.
+     *
+     * @param[in] errName - the error name
+     * @param[in] callout - the callout
+     */
+    void resolve(const std::string& errName, const std::string& callout);
+
+    /**
+     * @brief Commits everything queued now
+     */
+    void flush();
+
+    /**
+     * @brief Returns the number of error logs waiting to be committed
+     */
+    inline size_t getPending() const
+    {
+        return pending.size();
+    }
+
+  private:
+    /**
+     * @brief What is remembered about a fault
+     */
+    struct Occurrence
+    {
+        std::string errName;
+        std::string callout;
+        Clock::time_point first;
+        size_t count;
+    };
+
+    /**
+     * @brief Commits the oldest queued error log
+     */
+    void commitNext();
+
+    /**
+     * @brief The faults reported within the window, by fingerprint
+     */
+    std::map<std::string, Occurrence> faults;
+
+    /**
+     * @brief The error logs waiting to be committed
+     */
+    std::deque<Commit> pending;
+
+    /**
+     * @brief How long to coalesce repeats for
+     */
+    Clock::duration window;
+
+    /**
+     * @brief Runs the commits from the event loop
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+};
+
+} // namespace power
+} // namespace witherspoon
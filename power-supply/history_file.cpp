@@ -0,0 +1,214 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "history_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/log.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+using InternalFailure =
+    sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+HistoryFile::HistoryFile(const std::string& path, size_t capacity) :
+    capacity(capacity),
+    size(HEADER_SLOTS * HEADER_SLOT_SIZE + capacity * sizeof(PackedRecord))
+{
+    std::error_code ec;
+    fs::create_directories(fs::path{path}.parent_path(), ec);
+
+    fd.set(open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+    if (!fd)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed opening history file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    struct stat st;
+    if (fstat(fd(), &st) == -1)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to stat history file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    // A file of the wrong size was made for a different capacity,
+    // so it gets started over.
+    bool reset = (static_cast<size_t>(st.st_size) != size);
+    if (reset)
+    {
+        if ((ftruncate(fd(), 0) == -1) || (ftruncate(fd(), size) == -1))
+        {
+            auto e = errno;
+            log<level::ERR>("Failed to size history file",
+                            entry("PATH=%s", path.c_str()),
+                            entry("ERRNO=%d", e));
+            elog<InternalFailure>();
+        }
+    }
+
+    auto mapping =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd(), 0);
+    if (mapping == MAP_FAILED)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to map history file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    base = static_cast<uint8_t*>(mapping);
+
+    if (!reset)
+    {
+        load();
+    }
+}
+
+HistoryFile::~HistoryFile()
+{
+    if (base)
+    {
+        munmap(base, size);
+    }
+}
+
+namespace
+{
+
+constexpr uint32_t fnvOffsetBasis = 2166136261;
+
+/**
+ * @brief Adds data to an FNV-1a checksum
+ *
+ * @param[in] checksum - the checksum so far
+ * @param[in] data - the data
+ * @param[in] size - the size of the data
+ *
+ * @return uint32_t - the new checksum
+ */
+uint32_t fnv1a(uint32_t checksum, const void* data, size_t size)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        checksum ^= bytes[i];
+        checksum *= 16777619;
+    }
+
+    return checksum;
+}
+
+} // namespace
+
+uint32_t HistoryFile::getChecksum(const Header& header)
+{
+    return fnv1a(fnvOffsetBasis, &header, offsetof(Header, checksum));
+}
+
+uint32_t HistoryFile::getRecordsChecksum(const State& state)
+{
+    uint32_t checksum = fnvOffsetBasis;
+
+    for (size_t i = 0; i < state.count; i++)
+    {
+        checksum = fnv1a(checksum,
+                         &records()[(state.head + capacity - i) % capacity],
+                         sizeof(PackedRecord));
+    }
+
+    return checksum;
+}
+
+bool HistoryFile::isValid(const Header& header)
+{
+    return (header.magic == MAGIC) && (header.version == VERSION) &&
+           (header.recordSize == sizeof(PackedRecord)) &&
+           (header.capacity == capacity) &&
+           (header.checksum == getChecksum(header)) &&
+           (header.state.head < capacity) &&
+           (header.state.count <= capacity) &&
+           (header.recordsChecksum == getRecordsChecksum(header.state));
+}
+
+void HistoryFile::load()
+{
+    const Header* newest = nullptr;
+
+    for (size_t slot = 0; slot < HEADER_SLOTS; slot++)
+    {
+        auto h = header(slot);
+        if (isValid(*h) && (!newest || (h->generation > newest->generation)))
+        {
+            newest = h;
+        }
+    }
+
+    if (newest)
+    {
+        generation = newest->generation;
+        savedState = newest->state;
+    }
+}
+
+void HistoryFile::commit(const State& state)
+{
+    Header h;
+
+    // Zero the padding too, as it is part of the checksum
+    std::memset(&h, 0, sizeof(h));
+
+    h.magic = MAGIC;
+    h.version = VERSION;
+    h.recordSize = sizeof(PackedRecord);
+    h.capacity = capacity;
+    h.generation = generation + 1;
+    h.state = state;
+    h.recordsChecksum = getRecordsChecksum(state);
+    h.checksum = getChecksum(h);
+
+    // Never overwrite the newest valid header
+    std::memcpy(header(h.generation % HEADER_SLOTS), &h, sizeof(h));
+    generation = h.generation;
+
+    // Start writing it out, but don't wait for it
+    msync(base, size, MS_ASYNC);
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "file.hpp"
+#include "record_manager.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class HistoryFile
+ *
+ * A memory mapped file that holds the ring buffer of input power
+ * history records, so they survive a restart of the application
+ * or the BMC.
+ *
+ * The file layout is:
+ *   - 2 header slots, each HEADER_SLOT_SIZE bytes
+ *   - capacity PackedRecords
+ *
+ * The file size never changes after it is created.
+ *
+ * Each header holds the state of the ring buffer along with a
+ * generation count and a checksum.  A commit writes the new state
+ * into the slot not holding the newest generation, so if the write
+ * is torn the checksum won't match and the other slot is used on
+ * the next startup.  The caller must never write a record slot that
+ * the last committed state refers to.
+ *
+ * The pages are written out asynchronously, in no particular order,
+ * so after a power loss a header can be on flash without the records
+ * it refers to.  Each header also has a checksum of its records, and
+ * a header whose records don't match it isn't used either.
+ */
+class HistoryFile
+{
+  public:
+    static constexpr uint32_t MAGIC = 0x46485057; // "WPHF"
+    static constexpr uint16_t VERSION = 2;
+    static constexpr size_t HEADER_SLOTS = 2;
+    static constexpr size_t HEADER_SLOT_SIZE = 128;
+
+    /**
+     * @brief The state of the ring buffer kept in the header
+     */
+    struct State
+    {
+        uint64_t head;
+        uint64_t count;
+        int64_t baseTime;
+        uint64_t epoch;
+        uint64_t sequence;
+    };
+
+    HistoryFile() = delete;
+    HistoryFile(const HistoryFile&) = delete;
+    HistoryFile& operator=(const HistoryFile&) = delete;
+    HistoryFile(HistoryFile&&) = delete;
+    HistoryFile& operator=(HistoryFile&&) = delete;
+    ~HistoryFile();
+
+    /**
+     * @brief Constructor
+     *
+     * Opens and maps the file, creating it if necessary.  If it
+     * exists but was made for a different capacity or record
+     * layout, it is recreated.
+     *
+     * Throws InternalFailure on errors.
+     *
+     * @param[in] path - the file path
+     * @param[in] capacity - the number of records it holds
+     */
+    HistoryFile(const std::string& path, size_t capacity);
+
+    /**
+     * @brief Returns the state from the newest valid header
+     *
+     * @return optional<State> - the state, or empty if
+     *                            the file was just created
+     */
+    inline const std::optional<State>& getSavedState() const
+    {
+        return savedState;
+    }
+
+    /**
+     * @brief Returns the record slots in the file
+     */
+    inline PackedRecord* records()
+    {
+        return reinterpret_cast<PackedRecord*>(
+            base + HEADER_SLOTS * HEADER_SLOT_SIZE);
+    }
+
+    /**
+     * @brief Saves the state of the ring buffer into the header.
+     *
+     * Any records it refers to must already be written.
+     *
+     * @param[in] state - the state to save
+     */
+    void commit(const State& state);
+
+  private:
+    /**
+     * @brief The header in each header slot
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t recordSize;
+        uint64_t capacity;
+        uint64_t generation;
+        State state;
+        uint32_t recordsChecksum;
+        uint32_t checksum;
+    };
+
+    static_assert(sizeof(Header) <= HEADER_SLOT_SIZE,
+                  "Header must fit in a slot");
+
+    /**
+     * @brief Returns the checksum of a header, not including
+     *        the checksum field itself.
+     *
+     * @param[in] header - the header
+     *
+     * @return uint32_t - the checksum
+     */
+    static uint32_t getChecksum(const Header& header);
+
+    /**
+     * @brief Returns the checksum of the records a state refers to,
+     *        newest first.
+     *
+     * @param[in] state - the state
+     *
+     * @return uint32_t - the checksum
+     */
+    uint32_t getRecordsChecksum(const State& state);
+
+    /**
+     * @brief Returns a header slot
+     *
+     * @param[in] slot - the slot number
+     */
+    inline Header* header(size_t slot)
+    {
+        return reinterpret_cast<Header*>(base + slot * HEADER_SLOT_SIZE);
+    }
+
+    /**
+     * @brief Says if a header is valid for this file, and its
+     *        records are what it says they are.
+     *
+     * @param[in] header - the header
+     *
+     * @return bool - if the header can be used
+     */
+    bool isValid(const Header& header);
+
+    /**
+     * @brief Finds the newest valid header and saves its
+     *        state and generation.
+     */
+    void load();
+
+    /**
+     * @brief The file descriptor
+     */
+    util::FileDescriptor fd;
+
+    /**
+     * @brief The number of records the file holds
+     */
+    const size_t capacity;
+
+    /**
+     * @brief The size of the file, and the mapping
+     */
+    const size_t size;
+
+    /**
+     * @brief The start of the mapping
+     */
+    uint8_t* base = nullptr;
+
+    /**
+     * @brief The generation of the last committed header
+     */
+    uint64_t generation = 0;
+
+    /**
+     * @brief The state found in the file when it was opened
+     */
+    std::optional<State> savedState;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
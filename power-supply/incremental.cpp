@@ -0,0 +1,105 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "incremental.hpp"
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+std::tuple<uint64_t, uint64_t, RecordManager::DBusCombinedRecordList>
+    Incremental::getRecordsSince(uint64_t epoch, uint64_t sequence)
+{
+    // Send everything if the consumer is from an old epoch
+    if (epoch != manager.getEpoch())
+    {
+        sequence = 0;
+    }
+
+    return std::make_tuple(manager.getEpoch(), manager.getSequence(),
+                           manager.getRecordsSince(sequence));
+}
+
+std::tuple<uint64_t, uint64_t, RecordManager::DBusCombinedRecordList>
+    Incremental::getRecordsInRange(uint64_t start, uint64_t end,
+                                   uint64_t resolution)
+{
+    return std::make_tuple(manager.getEpoch(), manager.getSequence(),
+                           manager.getRecordsInRange(start, end, resolution));
+}
+
+std::tuple<uint64_t, uint64_t, uint64_t, sdbusplus::message::unix_fd>
+    Incremental::exportRecords(uint64_t start, uint64_t end)
+{
+    if (!exported || !exported->isCurrent(manager, start, end))
+    {
+        exported = std::make_unique<RecordExport>(manager, start, end);
+    }
+
+    return std::make_tuple(manager.getEpoch(), manager.getSequence(),
+                           exported->getCount(),
+                           sdbusplus::message::unix_fd{exported->getFD()});
+}
+
+RecordManager::DBusCombinedRecordList
+    Incremental::getArchivedRecords(uint64_t start, uint64_t end)
+{
+    RecordManager::DBusCombinedRecordList records;
+    if (!archive)
+    {
+        return records;
+    }
+
+    // The archive has them oldest first
+    auto archived = archive->getRecords(start, end, MAX_ARCHIVED_RECORDS);
+    records.reserve(archived.size());
+
+    for (auto r = archived.rbegin(); r != archived.rend(); ++r)
+    {
+        records.emplace_back(r->timestamp, r->average, r->maximum, r->id);
+    }
+
+    return records;
+}
+
+void Incremental::emitRecordsAdded()
+{
+    auto epoch = manager.getEpoch();
+    auto sequence = manager.getSequence();
+
+    if (epoch != emittedEpoch)
+    {
+        emittedSequence = 0;
+    }
+    else if (sequence == emittedSequence)
+    {
+        return;
+    }
+
+    auto msg = bus.new_signal(path.c_str(), interface, "RecordsAdded");
+
+    msg.append(epoch, sequence, manager.getRecordsSince(emittedSequence));
+    msg.signal_send();
+
+    emittedEpoch = epoch;
+    emittedSequence = sequence;
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,182 @@
+#pragma once
+#include "record_export.hpp"
+#include "record_manager.hpp"
+#include "segment_store.hpp"
+
+#include <memory>
+#include <org/open_power/Witherspoon/Sensor/History/Incremental/server.hpp>
+#include <sdbusplus/message/types.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+template <typename T>
+using ServerObject = typename sdbusplus::server::object::object<T>;
+
+using IncrementalInterface = sdbusplus::org::open_power::Witherspoon::Sensor::
+    History::server::Incremental;
+
+/**
+ * @class Incremental
+ *
+ * Implements Witherspoon.Sensor.History.Incremental
+ *
+ * This provides just the input power history records that were
+ * added since the consumer last looked, via the RecordsAdded signal
+ * or the GetRecordsSince method, along with an epoch and sequence
+ * number so the consumer can tell if it is out of sync.
+ *
+ * A time range of the history can be fetched with GetRecordsInRange,
+ * or in a memfd with ExportRecords for long histories.  Older records
+ * can be fetched from the archive on flash with GetArchivedRecords.
+ */
+class Incremental : public ServerObject<IncrementalInterface>
+{
+  public:
+    static constexpr auto interface =
+        "org.open_power.Witherspoon.Sensor.History.Incremental";
+
+    /**
+     * @brief The most records GetArchivedRecords returns, a day's
+     *        worth, so one call can't hold up the bus for long
+     */
+    static constexpr size_t MAX_ARCHIVED_RECORDS = 2880;
+
+    Incremental() = delete;
+    Incremental(const Incremental&) = delete;
+    Incremental& operator=(const Incremental&) = delete;
+    Incremental(Incremental&&) = delete;
+    Incremental& operator=(Incremental&&) = delete;
+    ~Incremental() = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path
+     * @param[in] manager - the manager of the history records
+     */
+    Incremental(sdbusplus::bus::bus& bus, const std::string& objectPath,
+                const RecordManager& manager) :
+        ServerObject<IncrementalInterface>(bus, objectPath.c_str()),
+        bus(bus), path(objectPath), manager(manager)
+    {
+    }
+
+    /**
+     * @brief Implements the GetRecordsSince method
+     *
+     * @param[in] epoch - the epoch the consumer is in
+     * @param[in] sequence - the sequence number of the last
+     *                       record the consumer has
+     *
+     * @return The current epoch and sequence number, and
+     *         the records added since the one passed in.
+     */
+    std::tuple<uint64_t, uint64_t, RecordManager::DBusCombinedRecordList>
+        getRecordsSince(uint64_t epoch, uint64_t sequence) override;
+
+    /**
+     * @brief Implements the GetRecordsInRange method
+     *
+     * @param[in] start - the oldest timestamp to include
+     * @param[in] end - the newest timestamp to include, or 0
+     * @param[in] resolution - the downsampling bucket size, or 0
+     *
+     * @return The current epoch and sequence number, and the
+     *         records in the range.
+     */
+    std::tuple<uint64_t, uint64_t, RecordManager::DBusCombinedRecordList>
+        getRecordsInRange(uint64_t start, uint64_t end,
+                          uint64_t resolution) override;
+
+    /**
+     * @brief Implements the ExportRecords method
+     *
+     * The last export is kept open, since the reply only holds a
+     * duplicate of the memfd, and handed out again if the records
+     * and time range are the same.
+     *
+     * @param[in] start - the oldest timestamp to include
+     * @param[in] end - the newest timestamp to include, or 0
+     *
+     * @return The current epoch and sequence number, the number
+     *         of records in the file, and the memfd.
+     */
+    std::tuple<uint64_t, uint64_t, uint64_t, sdbusplus::message::unix_fd>
+        exportRecords(uint64_t start, uint64_t end) override;
+
+    /**
+     * @brief Implements the GetArchivedRecords method
+     *
+     * @param[in] start - the oldest timestamp to include
+     * @param[in] end - the newest timestamp to include, or 0
+     *
+     * @return The newest MAX_ARCHIVED_RECORDS records in the
+     *         range, or none if there isn't an archive.
+     */
+    RecordManager::DBusCombinedRecordList
+        getArchivedRecords(uint64_t start, uint64_t end) override;
+
+    /**
+     * @brief Sets the archive that GetArchivedRecords reads
+     *
+     * @param[in] store - the archive, which must outlive this object
+     */
+    inline void setArchive(const SegmentStore* store)
+    {
+        archive = store;
+    }
+
+    /**
+     * @brief Emits the RecordsAdded signal with the records
+     *        added since it was last emitted.
+     *
+     * If the epoch changed since then, all records are sent.
+     */
+    void emitRecordsAdded();
+
+  private:
+    /**
+     * @brief The D-Bus object
+     */
+    sdbusplus::bus::bus& bus;
+
+    /**
+     * @brief The D-Bus object path
+     */
+    const std::string path;
+
+    /**
+     * @brief The manager of the history records
+     */
+    const RecordManager& manager;
+
+    /**
+     * @brief The archive of the records on flash, if there is one
+     */
+    const SegmentStore* archive = nullptr;
+
+    /**
+     * @brief The last export
+     */
+    std::unique_ptr<RecordExport> exported;
+
+    /**
+     * @brief The epoch of the last RecordsAdded signal
+     */
+    uint64_t emittedEpoch = 0;
+
+    /**
+     * @brief The sequence number of the last RecordsAdded signal
+     */
+    uint64_t emittedSequence = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
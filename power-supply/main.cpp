@@ -18,10 +18,14 @@
 #include "argument.hpp"
 #include "device_monitor.hpp"
 #include "power_supply.hpp"
+#include "system_monitor.hpp"
+#include "work_queue.hpp"
 
+#include <csignal>
 #include <iostream>
 #include <phosphor-logging/log.hpp>
 #include <sdeventplus/event.hpp>
+#include <sdeventplus/source/signal.hpp>
 
 using namespace witherspoon::power;
 using namespace phosphor::logging;
@@ -63,7 +67,23 @@ int main(int argc, char* argv[])
 
     // Attach the event object to the bus object so we can
     // handle both sd_events (for the timers) and dbus signals.
-    bus.attach_event(event.get(), SD_EVENT_PRIORITY_NORMAL);
+    // The signals include power state changes, which the fault
+    // checks depend on, so they get the fault priority.
+    bus.attach_event(event.get(), PRIORITY_FAULT);
+
+    // Leave the loop on SIGTERM instead of being killed, so the
+    // destructors run and write out what is only in memory, like
+    // the history archive's batched records.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    using sdeventplus::source::Signal;
+    Signal sigterm{event, SIGTERM,
+                   [](Signal& source, const struct signalfd_siginfo*) {
+                       source.get_event().exit(0);
+                   }};
 
     auto objname = "power_supply" + instnum;
     auto instance = std::stoul(instnum);
@@ -84,6 +104,13 @@ int main(int argc, char* argv[])
         objname, std::move(instance), std::move(objpath), std::move(invpath),
         bus, event, powerOnDelay, presentDelay);
 
+    // Optionally remember the VPD of known power supplies across restarts
+    auto vpdCacheDir = (options)["vpd-cache-dir"];
+    if (vpdCacheDir != ArgumentParser::emptyString)
+    {
+        psuDevice->enableVPDCache(vpdCacheDir + "/ps" + instnum + "_vpd");
+    }
+
     // Get the number of input power history records to keep in D-Bus.
     long int numRecords = 0;
     auto records = (options)["num-history-records"];
@@ -97,6 +124,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    std::unique_ptr<history::SystemMonitor> systemMonitor;
+
     if (numRecords != 0)
     {
         // Get the GPIO information for controlling the SYNC signal.
@@ -123,7 +152,32 @@ int main(int argc, char* argv[])
         std::string basePath =
             std::string{INPUT_HISTORY_SENSOR_ROOT} + '/' + name;
 
-        psuDevice->enableHistory(basePath, numRecords, syncGPIOPath, gpioNum);
+        // Get how often to update the full history arrays, in records.
+        // They are always available incrementally.
+        size_t fullInterval = 1;
+        auto interval = (options)["full-history-interval"];
+        if (interval != ArgumentParser::emptyString)
+        {
+            fullInterval = stoul(interval);
+        }
+
+        // Optionally keep the records in a file across restarts
+        std::string historyFile;
+        auto fileDir = (options)["history-file-dir"];
+        if (fileDir != ArgumentParser::emptyString)
+        {
+            historyFile = fileDir + '/' + name;
+        }
+
+        psuDevice->enableHistory(basePath, numRecords, syncGPIOPath, gpioNum,
+                                 fullInterval, historyFile);
+
+        // Optionally also keep weeks of the records on flash
+        auto archiveDir = (options)["history-archive-dir"];
+        if (archiveDir != ArgumentParser::emptyString)
+        {
+            psuDevice->enableArchive(archiveDir + '/' + name);
+        }
 
         // Systemd object manager
         sdbusplus::server::manager::manager objManager{bus, basePath.c_str()};
@@ -131,8 +185,126 @@ int main(int argc, char* argv[])
         std::string busName =
             std::string{INPUT_HISTORY_BUSNAME_ROOT} + '.' + name;
         bus.request_name(busName.c_str());
+
+        // Optionally also provide the system total history, made
+        // from the histories of all of the power supplies.
+        auto numPowerSupplies = (options)["system-history"];
+        if (numPowerSupplies != ArgumentParser::emptyString)
+        {
+            auto num = stoul(numPowerSupplies);
+            if (num > history::SystemHistory::MAX_POWER_SUPPLIES)
+            {
+                std::cerr << "Invalid number of power supplies specified.\n";
+                return -8;
+            }
+
+            std::vector<std::string> paths;
+            for (size_t i = 0; i < num; i++)
+            {
+                paths.push_back(std::string{INPUT_HISTORY_SENSOR_ROOT} +
+                                "/ps" + std::to_string(i) + "_input_power");
+            }
+
+            std::string systemPath = std::string{INPUT_HISTORY_SENSOR_ROOT} +
+                                     '/' + history::SystemMonitor::name;
+
+            systemMonitor = std::make_unique<history::SystemMonitor>(
+                bus, systemPath, paths, numRecords);
+
+            busName = std::string{INPUT_HISTORY_BUSNAME_ROOT} + '.' +
+                      history::SystemMonitor::name;
+            bus.request_name(busName.c_str());
+        }
+    }
+
+    // Optionally sample the sensors faster than the hwmon
+    // sensor application does, with statistics over each window.
+    std::unique_ptr<sdbusplus::server::manager::manager> sensorManager;
+    auto sampleInterval = (options)["sample-interval"];
+    if (sampleInterval != ArgumentParser::emptyString)
+    {
+        std::chrono::milliseconds interval{stoul(sampleInterval)};
+        if ((interval < Sampler::MIN_INTERVAL) ||
+            (interval > Sampler::MAX_INTERVAL))
+        {
+            std::cerr << "Invalid sample interval specified.\n";
+            return -9;
+        }
+
+        size_t windowSize = 10;
+        auto window = (options)["sample-window"];
+        if (window != ArgumentParser::emptyString)
+        {
+            windowSize = stoul(window);
+            if (windowSize == 0)
+            {
+                std::cerr << "Invalid sample window specified.\n";
+                return -10;
+            }
+        }
+
+        sensorManager = std::make_unique<sdbusplus::server::manager::manager>(
+            bus, Sampler::SENSOR_ROOT);
+
+        psuDevice->enableSampling(event, interval, windowSize);
+
+        auto busName = std::string{INPUT_HISTORY_BUSNAME_ROOT} + ".ps" +
+                       instnum + "_sensors";
+        bus.request_name(busName.c_str());
+    }
+
+    // Optionally accumulate the input energy, kept across restarts
+    std::unique_ptr<sdbusplus::server::manager::manager> energyManager;
+    auto energyDir = (options)["energy-dir"];
+    if (energyDir != ArgumentParser::emptyString)
+    {
+        energyManager = std::make_unique<sdbusplus::server::manager::manager>(
+            bus, history::Energy::ENERGY_ROOT);
+
+        std::string name{"ps" + instnum + "_input_energy"};
+        psuDevice->enableEnergy(
+            std::string{history::Energy::ENERGY_ROOT} + '/' + name,
+            energyDir + '/' + name);
+
+        // The system total goes along with the system history
+        if (systemMonitor)
+        {
+            std::vector<std::string> paths;
+            auto num = stoul((options)["system-history"]);
+            for (size_t i = 0; i < num; i++)
+            {
+                paths.push_back(std::string{history::Energy::ENERGY_ROOT} +
+                                "/ps" + std::to_string(i) + "_input_energy");
+            }
+
+            systemMonitor->enableEnergy(
+                std::string{history::Energy::ENERGY_ROOT} +
+                    "/system_input_energy",
+                paths);
+        }
+    }
+
+    // Optionally provide every poll's results in shared memory
+    auto telemetrySlots = (options)["telemetry-slots"];
+    if (telemetrySlots != ArgumentParser::emptyString)
+    {
+        auto numSlots = stoul(telemetrySlots);
+        if (numSlots != 0)
+        {
+            psuDevice->enableTelemetry(numSlots);
+        }
     }
 
     auto pollInterval = std::chrono::milliseconds(1000);
-    return DeviceMonitor(std::move(psuDevice), event, pollInterval).run();
+    DeviceMonitor monitor{std::move(psuDevice), event, pollInterval};
+
+    // Provide the poll timing statistics
+    monitor.enableStatistics(bus, std::string{DeviceMonitor::STATISTICS_ROOT} +
+                                      "/ps" + instnum);
+
+    auto busName =
+        std::string{INPUT_HISTORY_BUSNAME_ROOT} + ".ps" + instnum + "_monitor";
+    bus.request_name(busName.c_str());
+
+    return monitor.run();
 }
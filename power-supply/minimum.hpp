@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <org/open_power/Witherspoon/Sensor/History/Minimum/server.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+template <typename T>
+using ServerObject = typename sdbusplus::server::object::object<T>;
+
+using MinimumInterface =
+    sdbusplus::org::open_power::Witherspoon::Sensor::History::server::Minimum;
+
+/**
+ * @class Minimum
+ *
+ * Implements Witherspoon.Sensor.History.Minimum
+ *
+ * This includes a property that is an array of timestamp/minimum tuples
+ * and a property to specify the scale.
+ */
+class Minimum : public ServerObject<MinimumInterface>
+{
+  public:
+    static constexpr auto name = "minimum";
+
+    Minimum() = delete;
+    Minimum(const Minimum&) = delete;
+    Minimum& operator=(const Minimum&) = delete;
+    Minimum(Minimum&&) = delete;
+    Minimum& operator=(Minimum&&) = delete;
+    ~Minimum() = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path
+     */
+    Minimum(sdbusplus::bus::bus& bus, const std::string& objectPath) :
+        ServerObject<MinimumInterface>(bus, objectPath.c_str())
+    {
+        unit(Minimum::Unit::Watts);
+        scale(0);
+    }
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <org/open_power/Witherspoon/Sensor/History/Percentile/server.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+template <typename T>
+using ServerObject = typename sdbusplus::server::object::object<T>;
+
+using PercentileInterface = sdbusplus::org::open_power::Witherspoon::Sensor::
+    History::server::Percentile;
+
+/**
+ * @class Percentile
+ *
+ * Implements Witherspoon.Sensor.History.Percentile
+ *
+ * This includes a property that is an array of timestamp, p50, p95,
+ * p99, and maximum tuples and a property to specify the scale.
+ */
+class Percentile : public ServerObject<PercentileInterface>
+{
+  public:
+    static constexpr auto name = "percentile";
+
+    Percentile() = delete;
+    Percentile(const Percentile&) = delete;
+    Percentile& operator=(const Percentile&) = delete;
+    Percentile(Percentile&&) = delete;
+    Percentile& operator=(Percentile&&) = delete;
+    ~Percentile() = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path
+     */
+    Percentile(sdbusplus::bus::bus& bus, const std::string& objectPath) :
+        ServerObject<PercentileInterface>(bus, objectPath.c_str())
+    {
+        unit(Percentile::Unit::Watts);
+        scale(0);
+    }
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
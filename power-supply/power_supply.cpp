@@ -21,11 +21,17 @@
 #include "pmbus.hpp"
 #include "utility.hpp"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 #include <functional>
 #include <org/open_power/Witherspoon/Fault/error.hpp>
 #include <phosphor-logging/elog.hpp>
 #include <phosphor-logging/log.hpp>
 #include <xyz/openbmc_project/Common/Device/error.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
 #include <xyz/openbmc_project/Software/Version/server.hpp>
 
 namespace witherspoon
@@ -66,6 +72,56 @@ constexpr auto PART_NUMBER = "part_number";
 constexpr auto FW_VERSION = "fw_version";
 constexpr auto CCIN = "ccin";
 constexpr auto INPUT_HISTORY = "input_history";
+constexpr auto INPUT_POWER = "power1_input";
+constexpr auto READ_EIN = "read_ein";
+
+// The states kept in the flight recorder
+constexpr auto PRESENT_STATE = "present";
+constexpr auto POWER_ON_STATE = "power_on";
+constexpr auto READ_FAIL_STATE = "read_fail";
+
+// Enough for several minutes of polling
+constexpr auto FLIGHT_RECORDER_ENTRIES = 1024;
+
+// How often and how long to sample after a fault bit turns on
+constexpr auto CAPTURE_INTERVAL = std::chrono::milliseconds{10};
+constexpr auto CAPTURE_DURATION = std::chrono::seconds{2};
+constexpr size_t CAPTURE_SAMPLES = CAPTURE_DURATION / CAPTURE_INTERVAL;
+
+// The values read for each capture sample, STATUS_WORD and
+// STATUS_INPUT.  The hwmon input voltage and power are left out, as
+// the driver only reads them again every second.  STATUS_INPUT has
+// the input undervoltage and overvoltage bits, which show a sag.
+constexpr auto CAPTURE_VALUES = 2;
+
+// The STATUS_WORD bits that start a capture.  The rest only
+// mean something while the power is on.
+constexpr uint16_t CAPTURE_INPUT_BITS =
+    pmbus::status_word::INPUT_FAULT_WARN | pmbus::status_word::VIN_UV_FAULT;
+constexpr uint16_t CAPTURE_OUTPUT_BITS =
+    pmbus::status_word::VOUT_FAULT | pmbus::status_word::POWER_GOOD_NEGATED |
+    pmbus::status_word::FAN_FAULT | pmbus::status_word::UNIT_IS_OFF |
+    pmbus::status_word::VOUT_OV_FAULT | pmbus::status_word::IOUT_OC_FAULT |
+    pmbus::status_word::TEMPERATURE_FAULT_WARN;
+
+// When to read the input history after the next record is expected,
+// and when to read it again if the record wasn't there yet.
+constexpr auto HISTORY_READ_DELAY = std::chrono::milliseconds{500};
+constexpr auto HISTORY_CONFIRM_DELAY = std::chrono::seconds{2};
+
+// How often to read the input history when the record cadence is unknown
+constexpr auto HISTORY_POLL_INTERVAL = std::chrono::seconds{1};
+
+// How often to read READ_EIN and publish the energy, and how many
+// of those to save it after.  Saving less often spares the flash,
+// and the history records fill in what a restart loses.
+constexpr auto ENERGY_INTERVAL = std::chrono::seconds{10};
+constexpr size_t ENERGY_SAVE_TICKS = 30;
+
+// How long to wait before retrying the startup presence and power
+// state reads, doubled after each failure up to the maximum.
+constexpr auto STARTUP_RETRY_DELAY = std::chrono::seconds{1};
+constexpr auto STARTUP_RETRY_MAX_DELAY = std::chrono::seconds{32};
 
 PowerSupply::PowerSupply(const std::string& name, size_t inst,
                          const std::string& objpath, const std::string& invpath,
@@ -73,41 +129,70 @@ PowerSupply::PowerSupply(const std::string& name, size_t inst,
                          std::chrono::seconds& t, std::chrono::seconds& p) :
     Device(name, inst),
     monitorPath(objpath), pmbusIntf(objpath),
-    inventoryPath(INVENTORY_OBJ_PATH + invpath), bus(bus), presentInterval(p),
+    inventoryPath(INVENTORY_OBJ_PATH + invpath), bus(bus),
+    flightRecorder(name, FLIGHT_RECORDER_ENTRIES),
+    statusWordName(flightRecorder.addName(pmbus::STATUS_WORD)),
+    statusTemperatureName(flightRecorder.addName(pmbus::STATUS_TEMPERATURE)),
+    readFailName(flightRecorder.addName(READ_FAIL_STATE)), presentInterval(p),
     presentTimer(e, std::bind([this]() {
                      // The hwmon path may have changed.
                      pmbusIntf.findHwmonDir();
                      this->present = true;
+                     flightRecorder.record(FlightRecorder::Type::state,
+                                           PRESENT_STATE, true);
 
                      // Sync the INPUT_HISTORY data for all PSs
                      syncHistory();
 
                      // Update the inventory for the new device
-                     updateInventory();
+                     queueInventoryUpdate();
+
+                     if (sampler)
+                     {
+                         sampler->start();
+                     }
                  })),
+    presenceRetryTimer(e, std::bind([this]() { this->updatePresence(); })),
+    presenceRetryDelay(STARTUP_RETRY_DELAY),
     powerOnInterval(t),
-    powerOnTimer(e, std::bind([this]() { this->powerOn = true; }))
+    powerOnTimer(e, std::bind([this]() {
+                     this->powerOn = true;
+                     flightRecorder.record(FlightRecorder::Type::state,
+                                           POWER_ON_STATE, true);
+                 })),
+    powerStateRetryTimer(e,
+                         std::bind([this]() { this->updatePowerState(); })),
+    powerStateRetryDelay(STARTUP_RETRY_DELAY),
+    historyTimer(e, std::bind([this]() {
+                     // The INPUT_HISTORY read waits for the fault polls
+                     historyQueue.add([this]() { this->readHistory(); });
+                 })),
+    captureTimer(e, std::bind([this]() { this->readCapture(); })),
+    capture(name + "-capture", CAPTURE_SAMPLES * CAPTURE_VALUES),
+    reporter(e), historyQueue(e, PRIORITY_HISTORY),
+    housekeeping(e, PRIORITY_HOUSEKEEPING),
+    energyTimer(e, std::bind([this]() { this->updateEnergy(); }))
 {
     using namespace sdbusplus::bus;
     presentMatch = std::make_unique<match_t>(
         bus, match::rules::propertiesChanged(inventoryPath, INVENTORY_IFACE),
         [this](auto& msg) { this->inventoryChanged(msg); });
-    // Get initial presence state.
-    updatePresence();
-
-    // Write the SN, PN, etc to the inventory
-    updateInventory();
 
     // Subscribe to power state changes
     powerOnMatch = std::make_unique<match_t>(
         bus, match::rules::propertiesChanged(POWER_OBJ_PATH, POWER_IFACE),
         [this](auto& msg) { this->powerStateChanged(msg); });
-    // Get initial power state.
+
+    // Get the initial presence and power states at the same time, once
+    // the event loop runs.  Then the first analysis is done and the SN,
+    // PN, etc are written to the inventory.
+    updatePresence();
     updatePowerState();
 }
 
-void PowerSupply::captureCmd(util::NamesValues& nv, const std::string& cmd,
-                             witherspoon::pmbus::Type type)
+std::optional<uint64_t> PowerSupply::captureCmd(util::NamesValues& nv,
+                                                const std::string& cmd,
+                                                witherspoon::pmbus::Type type)
 {
     if (pmbusIntf.exists(cmd, type))
     {
@@ -115,6 +200,8 @@ void PowerSupply::captureCmd(util::NamesValues& nv, const std::string& cmd,
         {
             auto val = pmbusIntf.read(cmd, type);
             nv.add(cmd, val);
+            flightRecorder.record(FlightRecorder::Type::reg, cmd, val);
+            return val;
         }
         catch (std::exception& e)
         {
@@ -122,6 +209,8 @@ void PowerSupply::captureCmd(util::NamesValues& nv, const std::string& cmd,
                              entry("CMD=%s", cmd.c_str()));
         }
     }
+
+    return std::nullopt;
 }
 
 void PowerSupply::analyze()
@@ -135,8 +224,28 @@ void PowerSupply::analyze()
             std::uint16_t statusWord = 0;
 
             // Read the 2 byte STATUS_WORD value to check for faults.
+            auto start = PhaseStats::Clock::now();
             statusWord = pmbusIntf.read(STATUS_WORD, Type::Debug);
-            readFail = 0;
+
+            auto checkStart = PhaseStats::Clock::now();
+            statusWordPhase.add(checkStart - start);
+
+            if (readFail)
+            {
+                readFail = 0;
+                flightRecorder.record(FlightRecorder::Type::state,
+                                      readFailName, readFail);
+            }
+
+            flightRecorder.record(FlightRecorder::Type::reg, statusWordName,
+                                  statusWord);
+
+            checkCapture(statusWord);
+
+            if (telemetryRing)
+            {
+                addTelemetry(statusWord);
+            }
 
             checkInputFault(statusWord);
 
@@ -149,7 +258,7 @@ void PowerSupply::analyze()
                 checkPGOrUnitOffFault(statusWord);
             }
 
-            updateHistory();
+            faultCheckPhase.addSince(checkStart);
         }
     }
     catch (ReadFailure& e)
@@ -157,6 +266,8 @@ void PowerSupply::analyze()
         if (readFail < FAULT_COUNT)
         {
             readFail++;
+            flightRecorder.record(FlightRecorder::Type::state, readFailName,
+                                  readFail);
         }
 
         if (!readFailLogged && readFail >= FAULT_COUNT)
@@ -169,6 +280,14 @@ void PowerSupply::analyze()
     return;
 }
 
+std::vector<std::pair<std::string, PhaseStats>>
+    PowerSupply::getPhaseStats() const
+{
+    return {{"StatusWord", statusWordPhase},
+            {"FaultChecks", faultCheckPhase},
+            {"History", historyPhase}};
+}
+
 void PowerSupply::inventoryChanged(sdbusplus::message::message& msg)
 {
     std::string msgSensor;
@@ -179,6 +298,10 @@ void PowerSupply::inventoryChanged(sdbusplus::message::message& msg)
     auto valPropMap = msgData.find(PRESENT_PROP);
     if (valPropMap != msgData.end())
     {
+        // Newer than what the startup read would return
+        presenceCall.reset();
+        presenceRetryTimer.setEnabled(false);
+
         if (sdbusplus::message::variant_ns::get<bool>(valPropMap->second))
         {
             clearFaults();
@@ -188,9 +311,20 @@ void PowerSupply::inventoryChanged(sdbusplus::message::message& msg)
         {
             present = false;
             presentTimer.setEnabled(false);
+            flightRecorder.record(FlightRecorder::Type::state, PRESENT_STATE,
+                                  false);
+
+            if (sampler)
+            {
+                sampler->stop();
+            }
+
+            // A different power supply may be plugged in
+            telemetryPower.reset();
+            telemetryPowerExists.reset();
 
             // Clear out the now outdated inventory properties
-            updateInventory();
+            queueInventoryUpdate();
         }
     }
 
@@ -199,10 +333,86 @@ void PowerSupply::inventoryChanged(sdbusplus::message::message& msg)
 
 void PowerSupply::updatePresence()
 {
-    // Use getProperty utility function to get presence status.
+    // Get the presence status from the inventory manager.
     std::string service = "xyz.openbmc_project.Inventory.Manager";
-    util::getProperty(INVENTORY_IFACE, PRESENT_PROP, inventoryPath, service,
-                      bus, this->present);
+    auto method = bus.new_method_call(service.c_str(), inventoryPath.c_str(),
+                                      util::PROPERTY_INTF, "Get");
+    method.append(INVENTORY_IFACE, PRESENT_PROP);
+
+    presenceCall = std::make_unique<util::AsyncCall>(
+        bus, method, [this](auto& reply) {
+            sdbusplus::message::variant<bool> value;
+
+            try
+            {
+                if (reply.is_method_error())
+                {
+                    this->retryPresence();
+                    return;
+                }
+
+                reply.read(value);
+                this->present =
+                    sdbusplus::message::variant_ns::get<bool>(value);
+            }
+            catch (std::exception& e)
+            {
+                this->retryPresence();
+                return;
+            }
+
+            this->finishStartup();
+        });
+}
+
+void PowerSupply::retryPresence()
+{
+    // The Present signal only comes on a change, so if it was
+    // already present this is the only way to find out.
+    log<level::ERR>("Failed to get power supply presence",
+                    entry("PATH=%s", inventoryPath.c_str()),
+                    entry("RETRY_SECONDS=%lld",
+                          static_cast<long long>(presenceRetryDelay.count())));
+
+    presenceRetryTimer.restartOnce(presenceRetryDelay);
+    presenceRetryDelay =
+        std::min(presenceRetryDelay * 2, STARTUP_RETRY_MAX_DELAY);
+}
+
+void PowerSupply::finishStartup()
+{
+    using namespace std::chrono;
+
+    flightRecorder.record(FlightRecorder::Type::state, PRESENT_STATE,
+                          present);
+
+    // Don't wait for the poll interval, or for the inventory
+    analyze();
+
+    auto elapsed = steady_clock::now() - startTime;
+    log<level::INFO>(
+        "Power supply startup analysis done",
+        entry("POWERSUPPLY=%s", inventoryPath.c_str()),
+        entry("TIME_TO_FIRST_ANALYSIS_MS=%lld",
+              static_cast<long long>(
+                  duration_cast<milliseconds>(elapsed).count())));
+
+    queueInventoryUpdate();
+
+    housekeeping.add([this]() {
+        auto elapsed = steady_clock::now() - startTime;
+        log<level::INFO>(
+            "Power supply startup inventory update done",
+            entry("POWERSUPPLY=%s", inventoryPath.c_str()),
+            entry("TIME_TO_INVENTORY_MS=%lld",
+                  static_cast<long long>(
+                      duration_cast<milliseconds>(elapsed).count())));
+    });
+
+    if (present && sampler)
+    {
+        sampler->start();
+    }
 }
 
 void PowerSupply::powerStateChanged(sdbusplus::message::message& msg)
@@ -216,6 +426,11 @@ void PowerSupply::powerStateChanged(sdbusplus::message::message& msg)
     auto valPropMap = msgData.find("state");
     if (valPropMap != msgData.end())
     {
+        // Newer than what the startup read would return
+        powerServiceCall.reset();
+        powerStateCall.reset();
+        powerStateRetryTimer.setEnabled(false);
+
         state =
             sdbusplus::message::variant_ns::get<int32_t>(valPropMap->second);
 
@@ -230,22 +445,56 @@ void PowerSupply::powerStateChanged(sdbusplus::message::message& msg)
         {
             powerOnTimer.setEnabled(false);
             powerOn = false;
+            flightRecorder.record(FlightRecorder::Type::state, POWER_ON_STATE,
+                                  false);
         }
     }
 }
 
 void PowerSupply::updatePowerState()
+{
+    auto method = util::newGetServiceCall(POWER_OBJ_PATH, POWER_IFACE, bus);
+
+    powerServiceCall = std::make_unique<util::AsyncCall>(
+        bus, method, [this](auto& reply) {
+            std::string service;
+            if (!reply.is_method_error())
+            {
+                service = util::readGetServiceReply(reply);
+            }
+
+            if (service.empty())
+            {
+                this->retryPowerState();
+                return;
+            }
+
+            auto get = bus.new_method_call(service.c_str(), POWER_OBJ_PATH,
+                                           util::PROPERTY_INTF, "Get");
+            get.append(POWER_IFACE, "state");
+
+            powerStateCall = std::make_unique<util::AsyncCall>(
+                bus, get,
+                [this](auto& stateReply) { this->readPowerState(stateReply); });
+        });
+}
+
+void PowerSupply::readPowerState(sdbusplus::message::message& reply)
 {
     // When state = 1, system is powered on
     int32_t state = 0;
 
     try
     {
-        auto service = util::getService(POWER_OBJ_PATH, POWER_IFACE, bus);
+        if (reply.is_method_error())
+        {
+            retryPowerState();
+            return;
+        }
 
-        // Use getProperty utility function to get power state.
-        util::getProperty<int32_t>(POWER_IFACE, "state", POWER_OBJ_PATH,
-                                   service, bus, state);
+        sdbusplus::message::variant<int32_t> property;
+        reply.read(property);
+        state = sdbusplus::message::variant_ns::get<int32_t>(property);
 
         if (state)
         {
@@ -258,8 +507,51 @@ void PowerSupply::updatePowerState()
     }
     catch (std::exception& e)
     {
-        log<level::INFO>("Failed to get power state. Assuming it is off.");
-        powerOn = false;
+        retryPowerState();
+    }
+}
+
+void PowerSupply::retryPowerState()
+{
+    // Until then it's assumed off, so no power on faults are logged
+    log<level::INFO>("Failed to get power state. Assuming it is off.",
+                     entry("RETRY_SECONDS=%lld",
+                           static_cast<long long>(
+                               powerStateRetryDelay.count())));
+    powerOn = false;
+
+    powerStateRetryTimer.restartOnce(powerStateRetryDelay);
+    powerStateRetryDelay =
+        std::min(powerStateRetryDelay * 2, STARTUP_RETRY_MAX_DELAY);
+}
+
+template <typename Error, typename Metadata>
+void PowerSupply::reportFault(const std::string& rawStatus,
+                              uint16_t statusWord,
+                              std::optional<uint64_t> faultStatus)
+{
+    using RawStatus = typename Metadata::RAW_STATUS;
+    using Callout = typename Metadata::CALLOUT_INVENTORY_PATH;
+
+    // The other registers, like STATUS_MFR, can change between
+    // repeats of the same fault.
+    util::NamesValues fingerprint;
+    fingerprint.add("STATUS_WORD", statusWord);
+    if (faultStatus)
+    {
+        fingerprint.add("FAULT_STATUS", *faultStatus);
+    }
+
+    auto queued = reporter.report(
+        Error::errName, inventoryPath, fingerprint.get(),
+        [rawStatus, callout = inventoryPath]() {
+            report<Error>(RawStatus(rawStatus.c_str()),
+                          Callout(callout.c_str()));
+        });
+
+    if (queued)
+    {
+        dumpFaultData(Error::errName);
     }
 }
 
@@ -271,10 +563,12 @@ void PowerSupply::checkInputFault(const uint16_t statusWord)
         ((statusWord & status_word::INPUT_FAULT_WARN) ||
          (statusWord & status_word::VIN_UV_FAULT)))
     {
-        if (inputFault == 0)
+        if ((inputFault == 0) && inputFaultLog.allow())
         {
-            log<level::INFO>("INPUT or VIN_UV fault",
-                             entry("STATUS_WORD=0x%04X", statusWord));
+            log<level::INFO>(
+                "INPUT or VIN_UV fault",
+                entry("STATUS_WORD=0x%04X", statusWord),
+                entry("SUPPRESSED=%zu", inputFaultLog.takeSuppressed()));
         }
 
         inputFault++;
@@ -293,8 +587,13 @@ void PowerSupply::checkInputFault(const uint16_t statusWord)
             // the powerOnFault de-glitching.
             powerOnFault = 0;
 
-            log<level::INFO>("INPUT_FAULT_WARN cleared",
-                             entry("POWERSUPPLY=%s", inventoryPath.c_str()));
+            if (inputFaultLog.allow())
+            {
+                log<level::INFO>(
+                    "INPUT_FAULT_WARN cleared",
+                    entry("POWERSUPPLY=%s", inventoryPath.c_str()),
+                    entry("SUPPRESSED=%zu", inputFaultLog.takeSuppressed()));
+            }
 
             resolveError(inventoryPath,
                          std::string(PowerSupplyInputFault::errName));
@@ -304,6 +603,8 @@ void PowerSupply::checkInputFault(const uint16_t statusWord)
                 // The power supply will not be immediately powered on after
                 // the input power is restored.
                 powerOn = false;
+                flightRecorder.record(FlightRecorder::Type::state,
+                                      POWER_ON_STATE, false);
                 // Start up the timer that will set the state to indicate we
                 // are ready for the powered on fault checks.
                 powerOnTimer.restartOnce(powerOnInterval);
@@ -318,14 +619,13 @@ void PowerSupply::checkInputFault(const uint16_t statusWord)
         {
             util::NamesValues nv;
             nv.add("STATUS_WORD", statusWord);
-            captureCmd(nv, STATUS_INPUT, Type::Debug);
+            auto statusInput = captureCmd(nv, STATUS_INPUT, Type::Debug);
 
             using metadata =
                 org::open_power::Witherspoon::Fault::PowerSupplyInputFault;
 
-            report<PowerSupplyInputFault>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyInputFault, metadata>(nv.get(), statusWord,
+                                                         statusInput);
 
             faultFound = true;
         }
@@ -342,15 +642,25 @@ void PowerSupply::checkPGOrUnitOffFault(const uint16_t statusWord)
         if ((statusWord & status_word::POWER_GOOD_NEGATED) ||
             (statusWord & status_word::UNIT_IS_OFF))
         {
-            log<level::INFO>("PGOOD or UNIT_IS_OFF bit bad",
-                             entry("STATUS_WORD=0x%04X", statusWord));
+            if (powerOnFaultLog.allow())
+            {
+                log<level::INFO>(
+                    "PGOOD or UNIT_IS_OFF bit bad",
+                    entry("STATUS_WORD=0x%04X", statusWord),
+                    entry("SUPPRESSED=%zu", powerOnFaultLog.takeSuppressed()));
+            }
             powerOnFault++;
         }
         else
         {
             if (powerOnFault > 0)
             {
-                log<level::INFO>("PGOOD and UNIT_IS_OFF bits good");
+                if (powerOnFaultLog.allow())
+                {
+                    log<level::INFO>("PGOOD and UNIT_IS_OFF bits good",
+                                     entry("SUPPRESSED=%zu",
+                                           powerOnFaultLog.takeSuppressed()));
+                }
                 powerOnFault = 0;
             }
         }
@@ -371,9 +681,7 @@ void PowerSupply::checkPGOrUnitOffFault(const uint16_t statusWord)
                 org::open_power::Witherspoon::Fault::PowerSupplyShouldBeOn;
 
             // A power supply is OFF (or pgood low) but should be on.
-            report<PowerSupplyShouldBeOn>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyShouldBeOn, metadata>(nv.get(), statusWord);
         }
     }
 }
@@ -404,15 +712,14 @@ void PowerSupply::checkCurrentOutOverCurrentFault(const uint16_t statusWord)
             captureCmd(nv, STATUS_INPUT, Type::Debug);
             auto status0Vout = pmbusIntf.insertPageNum(STATUS_VOUT, 0);
             captureCmd(nv, status0Vout, Type::Debug);
-            captureCmd(nv, STATUS_IOUT, Type::Debug);
+            auto statusIout = captureCmd(nv, STATUS_IOUT, Type::Debug);
             captureCmd(nv, STATUS_MFR, Type::Debug);
 
             using metadata = org::open_power::Witherspoon::Fault::
                 PowerSupplyOutputOvercurrent;
 
-            report<PowerSupplyOutputOvercurrent>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyOutputOvercurrent, metadata>(
+                nv.get(), statusWord, statusIout);
 
             faultFound = true;
         }
@@ -444,16 +751,15 @@ void PowerSupply::checkOutputOvervoltageFault(const uint16_t statusWord)
             nv.add("STATUS_WORD", statusWord);
             captureCmd(nv, STATUS_INPUT, Type::Debug);
             auto status0Vout = pmbusIntf.insertPageNum(STATUS_VOUT, 0);
-            captureCmd(nv, status0Vout, Type::Debug);
+            auto statusVout = captureCmd(nv, status0Vout, Type::Debug);
             captureCmd(nv, STATUS_IOUT, Type::Debug);
             captureCmd(nv, STATUS_MFR, Type::Debug);
 
             using metadata = org::open_power::Witherspoon::Fault::
                 PowerSupplyOutputOvervoltage;
 
-            report<PowerSupplyOutputOvervoltage>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyOutputOvervoltage, metadata>(
+                nv.get(), statusWord, statusVout);
 
             faultFound = true;
         }
@@ -485,14 +791,13 @@ void PowerSupply::checkFanFault(const uint16_t statusWord)
             nv.add("STATUS_WORD", statusWord);
             captureCmd(nv, STATUS_MFR, Type::Debug);
             captureCmd(nv, STATUS_TEMPERATURE, Type::Debug);
-            captureCmd(nv, STATUS_FANS_1_2, Type::Debug);
+            auto statusFans = captureCmd(nv, STATUS_FANS_1_2, Type::Debug);
 
             using metadata =
                 org::open_power::Witherspoon::Fault::PowerSupplyFanFault;
 
-            report<PowerSupplyFanFault>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyFanFault, metadata>(nv.get(), statusWord,
+                                                       statusFans);
 
             faultFound = true;
         }
@@ -510,6 +815,8 @@ void PowerSupply::checkTemperatureFault(const uint16_t statusWord)
     // logging the over-temperature condition.
     std::uint8_t statusTemperature = 0;
     statusTemperature = pmbusIntf.read(STATUS_TEMPERATURE, Type::Debug);
+    flightRecorder.record(FlightRecorder::Type::reg, statusTemperatureName,
+                          statusTemperature);
     if (temperatureFault < FAULT_COUNT)
     {
         if ((statusWord & status_word::TEMPERATURE_FAULT_WARN) ||
@@ -545,15 +852,98 @@ void PowerSupply::checkTemperatureFault(const uint16_t statusWord)
             using metadata = org::open_power::Witherspoon::Fault::
                 PowerSupplyTemperatureFault;
 
-            report<PowerSupplyTemperatureFault>(
-                metadata::RAW_STATUS(nv.get().c_str()),
-                metadata::CALLOUT_INVENTORY_PATH(inventoryPath.c_str()));
+            reportFault<PowerSupplyTemperatureFault, metadata>(
+                nv.get(), statusWord, statusTemperature);
 
             faultFound = true;
         }
     }
 }
 
+void PowerSupply::checkCapture(const uint16_t statusWord)
+{
+    auto bits = CAPTURE_INPUT_BITS | (powerOn ? CAPTURE_OUTPUT_BITS : 0);
+
+    if (!(statusWord & bits))
+    {
+        // Ready for the next fault once the bits are off.  A capture
+        // that no error was logged for is thrown away, so it can't
+        // go with a later, unrelated one.
+        if (!captureArmed && !captureTimer.isEnabled())
+        {
+            captureArmed = true;
+            capture.clear();
+        }
+        return;
+    }
+
+    if (!captureArmed)
+    {
+        return;
+    }
+
+    log<level::INFO>("Capturing power supply fault",
+                     entry("STATUS_WORD=0x%04X", statusWord),
+                     entry("POWERSUPPLY=%s", inventoryPath.c_str()));
+
+    captureArmed = false;
+    captureSamples = 0;
+    capture.clear();
+    captureFault.clear();
+
+    readCapture();
+    captureTimer.restart(CAPTURE_INTERVAL);
+}
+
+void PowerSupply::readCapture()
+{
+    using namespace witherspoon::pmbus;
+
+    try
+    {
+        capture.record(FlightRecorder::Type::reg, STATUS_WORD,
+                       pmbusIntf.read(STATUS_WORD, Type::Debug));
+        capture.record(FlightRecorder::Type::reg, STATUS_INPUT,
+                       pmbusIntf.read(STATUS_INPUT, Type::Debug));
+
+        captureSamples++;
+    }
+    catch (std::exception& e)
+    {
+        // The power supply may be gone, so don't keep trying
+        captureSamples = CAPTURE_SAMPLES;
+    }
+
+    if (captureSamples >= CAPTURE_SAMPLES)
+    {
+        captureTimer.setEnabled(false);
+
+        if (!captureFault.empty())
+        {
+            capture.fault(captureFault);
+            capture.clear();
+            captureFault.clear();
+        }
+    }
+}
+
+void PowerSupply::dumpFaultData(const std::string& errName)
+{
+    flightRecorder.fault(errName);
+
+    if (captureTimer.isEnabled())
+    {
+        // Dumped when it's done
+        captureFault = errName;
+    }
+    else if (capture.getCount() != 0)
+    {
+        // Only goes with the first error of the fault
+        capture.fault(errName);
+        capture.clear();
+    }
+}
+
 void PowerSupply::clearFaults()
 {
     readFail = 0;
@@ -565,12 +955,23 @@ void PowerSupply::clearFaults()
     fanFault = 0;
     temperatureFault = 0;
     faultFound = false;
+    captureArmed = true;
 
     return;
 }
 
 void PowerSupply::resolveError(const std::string& callout,
                                const std::string& message)
+{
+    // A new occurrence shouldn't be coalesced into a resolved log
+    reporter.resolve(message, callout);
+
+    housekeeping.add(
+        [this, callout, message]() { resolveLogs(callout, message); });
+}
+
+void PowerSupply::resolveLogs(const std::string& callout,
+                              const std::string& message)
 {
     using EndpointList = std::vector<std::string>;
 
@@ -624,10 +1025,9 @@ void PowerSupply::resolveError(const std::string& callout,
     }
 }
 
-void PowerSupply::updateInventory()
+VPD PowerSupply::readVPD()
 {
     using namespace witherspoon::pmbus;
-    using namespace sdbusplus::message;
 
     // If any of these accesses fail, the fields will just be
     // blank in the inventory.  Leave logging ReadFailure errors
@@ -635,47 +1035,90 @@ void PowerSupply::updateInventory()
     // likely hit and threshold them first anyway.  The
     // readString() function will do the tracing of the failing
     // path so this code doesn't need to.
-    std::string pn;
-    std::string sn;
-    std::string ccin;
-    std::string version;
+    VPD vpd;
+    bool complete = true;
 
-    if (present)
+    try
     {
-        try
-        {
-            sn = pmbusIntf.readString(SERIAL_NUMBER, Type::HwmonDeviceDebug);
-        }
-        catch (ReadFailure& e)
-        {
-        }
+        vpd.serialNumber =
+            pmbusIntf.readString(SERIAL_NUMBER, Type::HwmonDeviceDebug);
+    }
+    catch (ReadFailure& e)
+    {
+        complete = false;
+    }
+
+    // A power supply seen before doesn't need the rest of its
+    // VPD read, except for the firmware version, which can change.
+    std::optional<VPD> cached;
+    if (!vpd.serialNumber.empty())
+    {
+        cached = vpdCache.find(vpd.serialNumber);
+    }
 
+    if (cached)
+    {
+        vpd = *cached;
+    }
+    else
+    {
         try
         {
-            pn = pmbusIntf.readString(PART_NUMBER, Type::HwmonDeviceDebug);
+            vpd.partNumber =
+                pmbusIntf.readString(PART_NUMBER, Type::HwmonDeviceDebug);
         }
         catch (ReadFailure& e)
         {
+            complete = false;
         }
 
         try
         {
-            ccin = pmbusIntf.readString(CCIN, Type::HwmonDeviceDebug);
+            vpd.ccin = pmbusIntf.readString(CCIN, Type::HwmonDeviceDebug);
         }
         catch (ReadFailure& e)
         {
+            complete = false;
         }
 
-        try
-        {
-            version = pmbusIntf.readString(FW_VERSION, Type::HwmonDeviceDebug);
-        }
-        catch (ReadFailure& e)
+        // Don't remember blanks from failed reads
+        if (complete)
         {
+            vpdCache.add(vpd);
         }
     }
 
-    // Build the object map and send it to the inventory
+    try
+    {
+        vpd.version = pmbusIntf.readString(FW_VERSION, Type::HwmonDeviceDebug);
+    }
+    catch (ReadFailure& e)
+    {
+        // Left blank like the others
+    }
+
+    return vpd;
+}
+
+void PowerSupply::queueInventoryUpdate()
+{
+    // So a poll can run between the I2C reads and the D-Bus call
+    housekeeping.add([this]() { queuedVPD = present ? readVPD() : VPD{}; });
+    housekeeping.add([this]() { updateInventory(queuedVPD); });
+}
+
+void PowerSupply::updateInventory(const VPD& vpd)
+{
+    using namespace sdbusplus::message;
+
+    if (publishedVPD && (*publishedVPD == vpd))
+    {
+        // The inventory already has it
+        return;
+    }
+
+    // Build the object map and send it to the inventory, with
+    // just the properties that changed since the last time.
     using Properties = std::map<std::string, variant<std::string>>;
     using Interfaces = std::map<std::string, Properties>;
     using Object = std::map<object_path, Interfaces>;
@@ -684,13 +1127,34 @@ void PowerSupply::updateInventory()
     Interfaces interfaces;
     Object object;
 
-    assetProps.emplace(SN_PROP, sn);
-    assetProps.emplace(PN_PROP, pn);
-    assetProps.emplace(MODEL_PROP, ccin);
-    interfaces.emplace(ASSET_IFACE, std::move(assetProps));
+    // Everything goes the first time
+    auto all = !publishedVPD;
+
+    if (all || (publishedVPD->serialNumber != vpd.serialNumber))
+    {
+        assetProps.emplace(SN_PROP, vpd.serialNumber);
+    }
+
+    if (all || (publishedVPD->partNumber != vpd.partNumber))
+    {
+        assetProps.emplace(PN_PROP, vpd.partNumber);
+    }
+
+    if (all || (publishedVPD->ccin != vpd.ccin))
+    {
+        assetProps.emplace(MODEL_PROP, vpd.ccin);
+    }
+
+    if (!assetProps.empty())
+    {
+        interfaces.emplace(ASSET_IFACE, std::move(assetProps));
+    }
 
-    versionProps.emplace(VERSION_PROP, version);
-    interfaces.emplace(VERSION_IFACE, std::move(versionProps));
+    if (all || (publishedVPD->version != vpd.version))
+    {
+        versionProps.emplace(VERSION_PROP, vpd.version);
+        interfaces.emplace(VERSION_IFACE, std::move(versionProps));
+    }
 
     // For Notify(), just send the relative path of the inventory
     // object so remove the INVENTORY_OBJ_PATH prefix
@@ -719,12 +1183,17 @@ void PowerSupply::updateInventory()
         // TODO: openbmc/openbmc#2756
         // Calling Notify() with an enumerated property crashes inventory
         // manager, so let it default to Unknown and now set it to the
-        // right value.
-        auto purpose =
-            version::convertForMessage(version::Version::VersionPurpose::Other);
+        // right value.  It never changes, so only do it the first time.
+        if (all)
+        {
+            auto purpose = version::convertForMessage(
+                version::Version::VersionPurpose::Other);
+
+            util::setProperty(VERSION_IFACE, VERSION_PURPOSE_PROP,
+                              inventoryPath, service, bus, purpose);
+        }
 
-        util::setProperty(VERSION_IFACE, VERSION_PURPOSE_PROP, inventoryPath,
-                          service, bus, purpose);
+        publishedVPD = vpd;
     }
     catch (std::exception& e)
     {
@@ -764,11 +1233,13 @@ void PowerSupply::syncHistory()
 void PowerSupply::enableHistory(const std::string& objectPath,
                                 size_t numRecords,
                                 const std::string& syncGPIOPath,
-                                size_t syncGPIONum)
+                                size_t syncGPIONum, size_t fullInterval,
+                                const std::string& historyFile)
 {
     historyObjectPath = objectPath;
     syncGPIODevPath = syncGPIOPath;
     syncGPIONumber = syncGPIONum;
+    fullHistoryInterval = fullInterval;
 
     recordManager = std::make_unique<history::RecordManager>(numRecords);
 
@@ -778,28 +1249,442 @@ void PowerSupply::enableHistory(const std::string& objectPath,
     average = std::make_unique<history::Average>(bus, avgPath);
 
     maximum = std::make_unique<history::Maximum>(bus, maxPath);
+
+    incremental = std::make_unique<history::Incremental>(
+        bus, historyObjectPath, *recordManager);
+
+    // The rollup levels go next to the per_30s one, like
+    // <root>/per_5m/ps0_input_power/average
+    std::filesystem::path path{historyObjectPath};
+    auto root = path.parent_path().parent_path();
+
+    for (const auto& level : recordManager->getRollups())
+    {
+        auto levelPath = root / level.getName() / path.filename();
+
+        RollupObjects objects;
+        objects.average = std::make_unique<history::Average>(
+            bus, levelPath / history::Average::name);
+        objects.maximum = std::make_unique<history::Maximum>(
+            bus, levelPath / history::Maximum::name);
+        objects.minimum = std::make_unique<history::Minimum>(
+            bus, levelPath / history::Minimum::name);
+        objects.percentile = std::make_unique<history::Percentile>(
+            bus, levelPath / history::Percentile::name);
+
+        rollupObjects.push_back(std::move(objects));
+    }
+
+    if (!historyFile.empty())
+    {
+        try
+        {
+            recordManager->persist(historyFile);
+        }
+        catch (sdbusplus::xyz::openbmc_project::Common::Error::
+                   InternalFailure& e)
+        {
+            // Still works, but starts over on every restart
+            log<level::ERR>("Input power history will not be persisted",
+                            entry("FILE=%s", historyFile.c_str()));
+        }
+
+        // Publish anything that was restored right away
+        incremental->emitRecordsAdded();
+        updateFullHistory();
+    }
+
+    historyTimer.restartOnce(HISTORY_POLL_INTERVAL);
 }
 
-void PowerSupply::updateHistory()
+void PowerSupply::enableArchive(const std::string& dir)
 {
     if (!recordManager)
     {
-        // Not enabled
         return;
     }
 
+    archive = std::make_unique<history::SegmentStore>(dir);
+    incremental->setArchive(archive.get());
+
+    // It only takes newer records, even if the time was set back
+    recordManager->setNewestTimestamp(archive->getLastTimestamp());
+
+    // Anything restored from the history file that it doesn't have yet
+    archiveRecords();
+}
+
+void PowerSupply::enableEnergy(const std::string& objectPath,
+                               const std::string& file)
+{
+    energy = std::make_unique<history::EnergyAccumulator>(file);
+    energyObject = std::make_unique<history::Energy>(bus, objectPath);
+    energyObject->update(*energy);
+
+    energyTimer.restart(ENERGY_INTERVAL);
+}
+
+void PowerSupply::enableSampling(const sdeventplus::Event& e,
+                                 std::chrono::milliseconds interval,
+                                 size_t windowSize)
+{
+    // The sensors are named like ps0_vin
+    auto prefix = "ps" + std::to_string(getInstance());
+    sampler = std::make_unique<Sampler>(bus, e, pmbusIntf, prefix, interval,
+                                        windowSize);
+
+    sampler->setInputPowerCallback([this](uint64_t, double watts) {
+        telemetryPower = std::llround(watts * 1000000);
+
+        if (energy && !einActive && (!recordManager || energyHistoryAdded))
+        {
+            energy->addSample(getEnergyTime(), watts);
+        }
+    });
+
+    if (present)
+    {
+        sampler->start();
+    }
+}
+
+void PowerSupply::enableVPDCache(const std::string& path)
+{
+    vpdCache = VPDCache{path};
+}
+
+void PowerSupply::enableTelemetry(size_t numSlots)
+{
+    using namespace sdbusplus::xyz::openbmc_project::Common::Error;
+
+    auto name = "ps" + std::to_string(getInstance()) + "_telemetry";
+
+    try
+    {
+        telemetryRing = std::make_unique<TelemetryRing>(name, numSlots);
+    }
+    catch (InternalFailure& e)
+    {
+        log<level::ERR>("Telemetry ring will not be available");
+        return;
+    }
+
+    // Consumers can map it through procfs
+    auto path = "/proc/" + std::to_string(getpid()) + "/fd/" +
+                std::to_string(telemetryRing->getFd());
+    log<level::INFO>("Telemetry ring created", entry("PATH=%s", path.c_str()),
+                     entry("SLOTS=%zu", telemetryRing->getNumSlots()));
+}
+
+void PowerSupply::addTelemetry(const uint16_t statusWord)
+{
+    using namespace std::chrono;
+
+    uint16_t flags = TelemetryRing::FLAG_STATUS_WORD;
+    int64_t inputPower = 0;
+
+    // The newest input power read, so the fault checks after
+    // this don't wait on reading it.
+    if (telemetryPower)
+    {
+        inputPower = *telemetryPower;
+        flags |= TelemetryRing::FLAG_INPUT_POWER;
+    }
+
+    auto now = steady_clock::now().time_since_epoch();
+    telemetryRing->add(duration_cast<nanoseconds>(now).count(), statusWord,
+                       inputPower, flags);
+
+    // The sampler provides it when sampling
+    if (!sampler && !telemetryPowerQueued &&
+        (!telemetryPowerExists || *telemetryPowerExists))
+    {
+        telemetryPowerQueued = true;
+        housekeeping.add([this]() { readTelemetryPower(); });
+    }
+}
+
+void PowerSupply::readTelemetryPower()
+{
+    using namespace witherspoon::pmbus;
+
+    telemetryPowerQueued = false;
+
+    if (!telemetryPowerExists)
+    {
+        telemetryPowerExists = pmbusIntf.exists(INPUT_POWER, Type::Hwmon);
+    }
+
+    if (!*telemetryPowerExists)
+    {
+        return;
+    }
+
+    try
+    {
+        auto power = pmbusIntf.readString(INPUT_POWER, Type::Hwmon);
+        telemetryPower = std::stoll(power);
+    }
+    catch (std::exception& e)
+    {
+        // Still provide the STATUS_WORD
+        telemetryPower.reset();
+    }
+}
+
+bool PowerSupply::updateHistory()
+{
+    if (!recordManager)
+    {
+        // Not enabled
+        return false;
+    }
+
+    auto epoch = recordManager->getEpoch();
+    auto sequence = recordManager->getSequence();
+
     // Read just the most recent average/max record
     auto data =
         pmbusIntf.readBinary(INPUT_HISTORY, pmbus::Type::HwmonDeviceDebug,
                              history::RecordManager::RAW_RECORD_SIZE);
 
+    bool changed = false;
+
+    if (recordManager->needsBackfill(data))
+    {
+        // Either just started up or records were missed, so get
+        // everything the PS still has and merge it in.
+        data = pmbusIntf.readBinary(
+            INPUT_HISTORY, pmbus::Type::HwmonDeviceDebug,
+            history::RecordManager::RAW_RECORD_SIZE *
+                history::RecordManager::MAX_RAW_RECORDS);
+
+        changed = recordManager->merge(data);
+    }
+    else
+    {
+        changed = recordManager->add(data);
+    }
+
     // Update D-Bus only if something changed (a new record ID, or cleared out)
-    auto changed = recordManager->add(data);
     if (changed)
     {
-        average->values(std::move(recordManager->getAverageRecords()));
-        maximum->values(std::move(recordManager->getMaximumRecords()));
+        incremental->emitRecordsAdded();
+        historyQueue.add([this]() { updateFullHistory(); });
+        updateRollups();
+
+        if (archive)
+        {
+            historyQueue.add([this]() { archiveRecords(); });
+        }
+
+        if (energy)
+        {
+            addRecordEnergy();
+        }
+    }
+
+    return (recordManager->getSequence() != 0) &&
+           ((recordManager->getSequence() != sequence) ||
+            (recordManager->getEpoch() != epoch));
+}
+
+void PowerSupply::archiveRecords()
+{
+    // The records are newest first, so find where the new ones start
+    auto last = static_cast<int64_t>(archive->getLastTimestamp());
+    size_t count = 0;
+    while ((count < recordManager->getNumRecords()) &&
+           (recordManager->at(count).timestamp() > last))
+    {
+        count++;
+    }
+
+    for (size_t i = count; i > 0; i--)
+    {
+        auto record = recordManager->at(i - 1);
+        archive->append({static_cast<uint64_t>(record.timestamp()),
+                         record.average(), record.maximum(),
+                         static_cast<uint8_t>(record.id())});
+    }
+}
+
+void PowerSupply::addRecordEnergy()
+{
+    using namespace std::chrono;
+
+    energyHistoryAdded = true;
+    if (einActive)
+    {
+        return;
+    }
+
+    // Each record is the average over the interval before it
+    auto interval =
+        duration_cast<milliseconds>(history::RecordManager::RECORD_INTERVAL)
+            .count();
+
+    auto end = static_cast<int64_t>(energy->getEnd());
+    size_t count = 0;
+    while ((count < recordManager->getNumRecords()) &&
+           (recordManager->at(count).timestamp() > end))
+    {
+        count++;
+    }
+
+    for (size_t i = count; i > 0; i--)
+    {
+        auto record = recordManager->at(i - 1);
+        energy->add(record.timestamp() - interval, record.timestamp(),
+                    record.average(),
+                    history::EnergyAccumulator::Source::InputHistory);
+    }
+}
+
+uint64_t PowerSupply::getEnergyTime() const
+{
+    using namespace std::chrono;
+
+    if (recordManager)
+    {
+        return recordManager->getCurrentRecordTime();
+    }
+
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+void PowerSupply::updateEnergy()
+{
+    using namespace witherspoon::pmbus;
+
+    einActive = false;
+
+    if (!present)
+    {
+        // Don't integrate across the time it was missing
+        energy->reset();
+    }
+    else if (pmbusIntf.exists(READ_EIN, Type::HwmonDeviceDebug))
+    {
+        try
+        {
+            auto data = pmbusIntf.readBinary(
+                READ_EIN, Type::HwmonDeviceDebug,
+                history::EnergyAccumulator::EIN_SIZE);
+
+            if (data.size() == history::EnergyAccumulator::EIN_SIZE)
+            {
+                energy->addEIN(getEnergyTime(), data);
+                einActive = true;
+            }
+        }
+        catch (ReadFailure& e)
+        {
+            // The samples and history records cover it
+        }
+    }
+
+    energyObject->update(*energy);
+
+    if (++energyTicks >= ENERGY_SAVE_TICKS)
+    {
+        energyTicks = 0;
+        housekeeping.add([this]() { energy->save(); });
+    }
+}
+
+void PowerSupply::readHistory()
+{
+    using namespace std::chrono;
+
+    bool newRecord = false;
+
+    if (present)
+    {
+        auto start = PhaseStats::Clock::now();
+
+        try
+        {
+            newRecord = updateHistory();
+        }
+        catch (ReadFailure& e)
+        {
+            // analyze() takes care of read failures
+        }
+
+        historyPhase.addSince(start);
+    }
+
+    auto next = recordManager->getNextRecordTime();
+    milliseconds delay = HISTORY_POLL_INTERVAL;
+
+    if (newRecord && next)
+    {
+        auto now = history::SequenceClock::getMonotonicTime();
+        delay = std::max(milliseconds{*next - now} + HISTORY_READ_DELAY,
+                         milliseconds{0});
+        historyConfirmRead = false;
+    }
+    else if (!newRecord && next && !historyConfirmRead)
+    {
+        delay = HISTORY_CONFIRM_DELAY;
+        historyConfirmRead = true;
+    }
+
+    historyTimer.restartOnce(delay);
+}
+
+void PowerSupply::updateFullHistory()
+{
+    if (fullHistoryInterval == 0)
+    {
+        // Only provided incrementally
+        return;
+    }
+
+    auto epoch = recordManager->getEpoch();
+    auto sequence = recordManager->getSequence();
+
+    // Always update right away after the records were cleared or
+    // the first ones show up, so the arrays are never stale.
+    if ((epoch == fullHistoryEpoch) && (fullHistorySequence != 0) &&
+        (sequence - fullHistorySequence < fullHistoryInterval))
+    {
+        return;
+    }
+
+    average->values(std::move(recordManager->getAverageRecords()));
+    maximum->values(std::move(recordManager->getMaximumRecords()));
+
+    fullHistoryEpoch = epoch;
+    fullHistorySequence = sequence;
+}
+
+void PowerSupply::updateRollups()
+{
+    for (size_t i = 0; i < rollupObjects.size(); i++)
+    {
+        historyQueue.add([this, i]() { updateRollup(i); });
+    }
+}
+
+void PowerSupply::updateRollup(size_t level)
+{
+    const auto& rollup = recordManager->getRollups()[level];
+    auto& objects = rollupObjects[level];
+
+    if (rollup.getSequence() == objects.sequence)
+    {
+        return;
     }
+
+    objects.average->values(rollup.getAverageRecords());
+    objects.maximum->values(rollup.getMaximumRecords());
+    objects.minimum->values(rollup.getMinimumRecords());
+    objects.percentile->values(rollup.getPercentileRecords());
+
+    objects.sequence = rollup.getSequence();
 }
 
 } // namespace psu
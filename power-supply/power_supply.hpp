@@ -1,10 +1,24 @@
 #pragma once
 #include "average.hpp"
 #include "device.hpp"
+#include "energy.hpp"
+#include "energy_accumulator.hpp"
+#include "error_reporter.hpp"
+#include "flight_recorder.hpp"
+#include "incremental.hpp"
+#include "log_limiter.hpp"
 #include "maximum.hpp"
+#include "minimum.hpp"
 #include "names_values.hpp"
+#include "percentile.hpp"
 #include "pmbus.hpp"
 #include "record_manager.hpp"
+#include "sampler.hpp"
+#include "segment_store.hpp"
+#include "telemetry_ring.hpp"
+#include "utility.hpp"
+#include "vpd_cache.hpp"
+#include "work_queue.hpp"
 
 #include <sdbusplus/bus/match.hpp>
 #include <sdeventplus/clock.hpp>
@@ -74,9 +88,18 @@ class PowerSupply : public Device
      */
     void clearFaults() override;
 
+    /**
+     * Returns the times taken reading STATUS_WORD, checking it for
+     * faults, and reading the input power history.
+     */
+    std::vector<std::pair<std::string, PhaseStats>>
+        getPhaseStats() const override;
+
     /**
      * Mark error for specified callout and message as resolved.
      *
+     * The error logs are updated later as housekeeping work.
+     *
      * @param[in] callout - The callout to be resolved (inventory path)
      * @parma[in] message - The message for the fault to be resolved
      */
@@ -90,9 +113,63 @@ class PowerSupply : public Device
      * @param[in] syncGPIOPath - The gpiochip device path to use for
      *                           sending the sync command
      * @paramp[in] syncGPIONum - the GPIO number for the sync command
+     * @param[in] fullInterval - the number of new records between
+     *                           updates of the full average and maximum
+     *                           arrays, or 0 to only provide them
+     *                           incrementally
+     * @param[in] historyFile - the file to keep the records in across
+     *                          restarts, or empty to not keep them
      */
     void enableHistory(const std::string& objectPath, size_t numRecords,
-                       const std::string& syncGPIOPath, size_t syncGPIONum);
+                       const std::string& syncGPIOPath, size_t syncGPIONum,
+                       size_t fullInterval, const std::string& historyFile);
+
+    /**
+     * Enables keeping the input power history records on flash for
+     * longer than the D-Bus history holds them, read back with the
+     * GetArchivedRecords method.  History must be enabled first.
+     *
+     * @param[in] dir - the directory of the archive
+     */
+    void enableArchive(const std::string& dir);
+
+    /**
+     * Enables accumulating the input energy and providing it on D-Bus.
+     *
+     * It comes from READ_EIN when the power supply provides it, and
+     * otherwise from the input power samples and history records.
+     *
+     * @param[in] objectPath - the D-Bus object path to use
+     * @param[in] file - the file to keep the energy in across
+     *                   restarts, or empty to not keep it
+     */
+    void enableEnergy(const std::string& objectPath, const std::string& file);
+
+    /**
+     * Enables sampling the hwmon sensors and providing them on D-Bus
+     *
+     * @param[in] e - event object
+     * @param[in] interval - the time between samples
+     * @param[in] windowSize - the number of samples in each window of
+     *                         statistics
+     */
+    void enableSampling(const sdeventplus::Event& e,
+                        std::chrono::milliseconds interval, size_t windowSize);
+
+    /**
+     * Enables writing the STATUS_WORD and input power from every
+     * poll into a shared memory ring for local consumers.
+     *
+     * @param[in] numSlots - the number of samples the ring holds
+     */
+    void enableTelemetry(size_t numSlots);
+
+    /**
+     * Keeps the VPD cache in a file so it survives restarts.
+     *
+     * @param[in] path - the file path
+     */
+    void enableVPDCache(const std::string& path);
 
   private:
     /**
@@ -117,12 +194,48 @@ class PowerSupply : public Device
     /** @brief Connection for sdbusplus bus */
     sdbusplus::bus::bus& bus;
 
+    /**
+     * @brief Records the recent register reads and state changes,
+     *        to dump when a fault is found.
+     */
+    FlightRecorder flightRecorder;
+
+    /**
+     * @brief The flight recorder name indexes of the values recorded
+     *        on every poll, so their names aren't looked up each time
+     */
+    uint16_t statusWordName;
+    uint16_t statusTemperatureName;
+    uint16_t readFailName;
+
+    /**
+     * @brief The times of the STATUS_WORD reads in analyze()
+     */
+    PhaseStats statusWordPhase;
+
+    /**
+     * @brief The times of the fault checks in analyze()
+     */
+    PhaseStats faultCheckPhase;
+
+    /**
+     * @brief The times of the input power history reads
+     */
+    PhaseStats historyPhase;
+
     /** @brief True if the power supply is present. */
     bool present = false;
 
     /** @brief Used to subscribe to D-Bus property changes for Present */
     std::unique_ptr<sdbusplus::bus::match_t> presentMatch;
 
+    /** @brief The startup read of the Present property */
+    std::unique_ptr<util::AsyncCall> presenceCall;
+
+    /** @brief When this object was created, for the startup metrics */
+    std::chrono::steady_clock::time_point startTime =
+        std::chrono::steady_clock::now();
+
     /**
      * @brief Interval for setting present to true.
      *
@@ -140,6 +253,16 @@ class PowerSupply : public Device
      */
     sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> presentTimer;
 
+    /**
+     * @brief Timer used to retry the startup read of the Present
+     *        property, if it failed.
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>
+        presenceRetryTimer;
+
+    /** @brief How long to wait before the next presence retry */
+    std::chrono::seconds presenceRetryDelay;
+
     /** @brief True if a fault has already been found and not cleared */
     bool faultFound = false;
 
@@ -152,6 +275,9 @@ class PowerSupply : public Device
      */
     size_t powerOnFault = 0;
 
+    /** @brief Limits the PGOOD and UNIT_IS_OFF journal messages */
+    LogLimiter powerOnFaultLog;
+
     /**
      * @brief Interval to setting powerOn to true.
      *
@@ -172,6 +298,22 @@ class PowerSupply : public Device
     /** @brief Used to subscribe to D-Bus power on state changes */
     std::unique_ptr<sdbusplus::bus::match_t> powerOnMatch;
 
+    /** @brief The startup mapper lookup of the power state service */
+    std::unique_ptr<util::AsyncCall> powerServiceCall;
+
+    /** @brief The startup read of the power state */
+    std::unique_ptr<util::AsyncCall> powerStateCall;
+
+    /**
+     * @brief Timer used to retry the startup read of the
+     *        power state, if it failed.
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>
+        powerStateRetryTimer;
+
+    /** @brief How long to wait before the next power state retry */
+    std::chrono::seconds powerStateRetryDelay;
+
     /** @brief Indicates that a read failure has occurred.
      *
      * @details This will be incremented each time a read failure is
@@ -193,6 +335,9 @@ class PowerSupply : public Device
      */
     size_t inputFault = 0;
 
+    /** @brief Limits the input fault journal messages */
+    LogLimiter inputFaultLog;
+
     /**
      * @brief Indicates output over current fault if equal to FAULT_COUNT
      *
@@ -234,6 +379,11 @@ class PowerSupply : public Device
      */
     std::unique_ptr<history::RecordManager> recordManager;
 
+    /**
+     * @brief The long term archive of the history records on flash
+     */
+    std::unique_ptr<history::SegmentStore> archive;
+
     /**
      * @brief The D-Bus object for the average input power history
      */
@@ -244,12 +394,200 @@ class PowerSupply : public Device
      */
     std::unique_ptr<history::Maximum> maximum;
 
+    /**
+     * @brief The D-Bus object for the incremental input power history
+     */
+    std::unique_ptr<history::Incremental> incremental;
+
+    /**
+     * @brief The D-Bus objects for a rollup level of the input
+     *        power history.
+     */
+    struct RollupObjects
+    {
+        std::unique_ptr<history::Average> average;
+        std::unique_ptr<history::Maximum> maximum;
+        std::unique_ptr<history::Minimum> minimum;
+        std::unique_ptr<history::Percentile> percentile;
+
+        /**
+         * @brief The rollup sequence number when they were last updated
+         */
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief The D-Bus objects for each rollup level, in the same
+     *        order as RecordManager::getRollups().
+     */
+    std::vector<RollupObjects> rollupObjects;
+
+    /**
+     * @brief The number of new records between updates of the
+     *        full average and maximum arrays.  0 means never.
+     */
+    size_t fullHistoryInterval = 1;
+
+    /**
+     * @brief The history epoch when the full arrays were last updated
+     */
+    uint64_t fullHistoryEpoch = 0;
+
+    /**
+     * @brief The history sequence number when the full arrays were
+     *        last updated
+     */
+    uint64_t fullHistorySequence = 0;
+
     /**
      * @brief The base D-Bus object path to use for the average
      *        and maximum objects.
      */
     std::string historyObjectPath;
 
+    /**
+     * @brief Timer used to read the input history.
+     *
+     * Rather than on every analyze(), the history is read just after
+     * the power supply is expected to make its next record, based on
+     * the cadence learned from the previous ones.  The read is queued
+     * on historyQueue so it doesn't delay a fault poll.
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>
+        historyTimer;
+
+    /**
+     * @brief If the last history read was the one confirming that a
+     *        new record wasn't there yet when expected.
+     */
+    bool historyConfirmRead = false;
+
+    /**
+     * @brief Timer used to take the samples of a fault capture
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>
+        captureTimer;
+
+    /**
+     * @brief The samples of the most recent fault capture
+     */
+    FlightRecorder capture;
+
+    /**
+     * @brief The number of samples taken in the current capture
+     */
+    size_t captureSamples = 0;
+
+    /**
+     * @brief If a fault bit turning on will start a capture.  Only
+     *        the first one does, until the bits are off again or
+     *        the faults are cleared.
+     */
+    bool captureArmed = true;
+
+    /**
+     * @brief The error logged while a capture was still running,
+     *        to dump the capture for once it's done.
+     */
+    std::string captureFault;
+
+    /**
+     * @brief The VPD of the power supplies seen in this slot
+     */
+    VPDCache vpdCache;
+
+    /**
+     * @brief The VPD last written to the inventory, if it has been
+     */
+    std::optional<VPD> publishedVPD;
+
+    /**
+     * @brief Coalesces repeated faults and creates the error
+     *        logs from the event loop
+     */
+    ErrorReporter reporter;
+
+    /**
+     * @brief Publishes the input power history to D-Bus after the
+     *        fault polling
+     */
+    WorkQueue historyQueue;
+
+    /**
+     * @brief Does the inventory updates and error resolution after
+     *        everything else
+     */
+    WorkQueue housekeeping;
+
+    /**
+     * @brief The VPD read by a queued inventory update, for the
+     *        piece of work after it to publish
+     */
+    VPD queuedVPD;
+
+    /**
+     * @brief Samples the hwmon sensors, if enabled
+     */
+    std::unique_ptr<Sampler> sampler;
+
+    /**
+     * @brief Accumulates the input energy, if enabled
+     */
+    std::unique_ptr<history::EnergyAccumulator> energy;
+
+    /**
+     * @brief The D-Bus object for the input energy
+     */
+    std::unique_ptr<history::Energy> energyObject;
+
+    /**
+     * @brief Timer used to read READ_EIN and publish the energy
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic>
+        energyTimer;
+
+    /**
+     * @brief The number of energy timer expirations since the
+     *        energy was last saved
+     */
+    size_t energyTicks = 0;
+
+    /**
+     * @brief If the energy is coming from READ_EIN, so the samples
+     *        and history records are left out.
+     */
+    bool einActive = false;
+
+    /**
+     * @brief If the history records have been added to the energy
+     *        since startup.  Samples wait for it, so the records
+     *        read from the power supply can fill in the time the
+     *        monitor wasn't running first.
+     */
+    bool energyHistoryAdded = false;
+
+    /**
+     * @brief The shared memory telemetry ring, if enabled
+     */
+    std::unique_ptr<TelemetryRing> telemetryRing;
+
+    /**
+     * @brief The newest input power for the telemetry ring,
+     *        in microwatts, if any.
+     */
+    std::optional<int64_t> telemetryPower;
+
+    /**
+     * @brief If the input power sensor exists, once checked
+     */
+    std::optional<bool> telemetryPowerExists;
+
+    /**
+     * @brief If reading the input power for the telemetry
+     *        ring is already queued.
+     */
+    bool telemetryPowerQueued = false;
+
     /**
      * @brief The GPIO device path to use for sending the 'sync'
      *        command to the PS.
@@ -278,17 +616,51 @@ class PowerSupply : public Device
      * The D-Bus inventory properties for this power supply will be read to
      * determine if the power supply is present or not and update this
      * objects present member variable to reflect current status.
+     *
+     * This doesn't wait for the reply.  When it comes, startup is
+     * finished with finishStartup().  If the read fails, it's retried
+     * with a growing delay until it works or the Present property
+     * changes.
      */
     void updatePresence();
 
+    /**
+     * @brief Does the first analysis and updates the inventory, once
+     *        the presence is known, and logs how long it took.
+     */
+    void finishStartup();
+
+    /**
+     * @brief Logs that the presence read failed, and retries
+     *        it after a delay.
+     */
+    void retryPresence();
+
     /**
      * @brief Updates the poweredOn status by querying D-Bus
      *
      * The D-Bus property for the system power state will be read to
      * determine if the system is powered on or not.
+     *
+     * This doesn't wait for the replies, so it runs at the same
+     * time as updatePresence(), and is retried the same way.
      */
     void updatePowerState();
 
+    /**
+     * @brief Updates the poweredOn status from the reply to
+     *        the power state property read.
+     *
+     * @param[in] reply - the reply
+     */
+    void readPowerState(sdbusplus::message::message& reply);
+
+    /**
+     * @brief Treats the power as off after the power state read
+     *        failed, and retries it after a delay.
+     */
+    void retryPowerState();
+
     /**
      * @brief Callback for power state property changes
      *
@@ -304,9 +676,12 @@ class PowerSupply : public Device
      * @param[out] nv - NamesValues instance to store cmd string and value
      * @param[in] cmd - String for the command to read data from.
      * @param[in] type - The type of file to read the command from.
+     *
+     * @return optional<uint64_t> - the value, if it could be read
      */
-    void captureCmd(util::NamesValues& nv, const std::string& cmd,
-                    witherspoon::pmbus::Type type);
+    std::optional<uint64_t> captureCmd(util::NamesValues& nv,
+                                       const std::string& cmd,
+                                       witherspoon::pmbus::Type type);
 
     /**
      * @brief Checks for input voltage faults and logs error if needed.
@@ -364,22 +739,109 @@ class PowerSupply : public Device
      */
     void checkTemperatureFault(const uint16_t statusWord);
 
+    /**
+     * @brief Starts a capture if a fault bit just turned on
+     *
+     * For the first fault bit after they were all off, STATUS_WORD
+     * and STATUS_INPUT are read every CAPTURE_INTERVAL for
+     * CAPTURE_DURATION, to show what happened in more detail than
+     * the normal polling can.
+     *
+     * @param[in] statusWord - 2 byte STATUS_WORD value read from sysfs
+     */
+    void checkCapture(const uint16_t statusWord);
+
+    /**
+     * @brief Callback for the capture timer.  Takes a capture sample.
+     */
+    void readCapture();
+
+    /**
+     * @brief Reports a fault through the ErrorReporter, and dumps the
+     *        fault data if it isn't a repeat.
+     *
+     * A repeat is the same error with the same STATUS_WORD and
+     * fault specific status register, whatever the other captured
+     * registers are.
+     *
+     * @tparam Error - the error to log
+     * @tparam Metadata - the metadata of the error
+     * @param[in] rawStatus - the register values, for RAW_STATUS
+     * @param[in] statusWord - the STATUS_WORD value
+     * @param[in] faultStatus - the value of the status register
+     *                          specific to the fault, if any
+     */
+    template <typename Error, typename Metadata>
+    void reportFault(const std::string& rawStatus, uint16_t statusWord,
+                     std::optional<uint64_t> faultStatus = std::nullopt);
+
+    /**
+     * @brief Dumps the flight recorder, and the capture too once it
+     *        is done, after an error was logged.
+     *
+     * @param[in] errName - the name of the error
+     */
+    void dumpFaultData(const std::string& errName);
+
+    /**
+     * @brief Writes a sample to the telemetry ring, along with the
+     *        newest input power read, if any.
+     *
+     * When not sampling, this queues reading the input power again
+     * as housekeeping, so it doesn't delay the fault checks.
+     *
+     * @param[in] statusWord - 2 byte STATUS_WORD value read from sysfs
+     */
+    void addTelemetry(const uint16_t statusWord);
+
+    /**
+     * @brief Reads the input power for the telemetry ring, after
+     *        checking once that the power supply has the sensor.
+     */
+    void readTelemetryPower();
+
+    /**
+     * @brief Reads the VPD from the device, or from the VPD cache
+     *        if the serial number is there.
+     *
+     * @return VPD - the VPD, with blanks for any failed reads
+     */
+    VPD readVPD();
+
     /**
      * @brief Adds properties to the inventory.
      *
-     * Reads the values from the device and writes them to the
-     * associated power supply D-Bus inventory object.
+     * Writes the VPD values read from the device to the associated
+     * power supply D-Bus inventory object.
      *
      * This needs to be done on startup, and each time the presence
-     * state changes.
+     * state changes.  Only the properties that changed since the
+     * last time are written.
      *
      * Properties added:
      * - Serial Number
      * - Part Number
      * - CCIN (Customer Card Identification Number) - added as the Model
      * - Firmware version
+     *
+     * @param[in] vpd - the VPD
      */
-    void updateInventory();
+    void updateInventory(const VPD& vpd);
+
+    /**
+     * @brief Queues an inventory update as housekeeping work, with
+     *        the VPD reads and the D-Bus update as separate pieces.
+     */
+    void queueInventoryUpdate();
+
+    /**
+     * @brief Sets the error logs of a callout and message to
+     *        resolved.  Takes several D-Bus calls.
+     *
+     * @param[in] callout - the callout (inventory path)
+     * @param[in] message - the error message
+     */
+    void resolveLogs(const std::string& callout, const std::string& message);
 
     /**
      * @brief Toggles the GPIO to sync power supply input history readings
@@ -400,15 +862,81 @@ class PowerSupply : public Device
      *        supply and updates the average and maximum properties in
      *        D-Bus if there is a new reading available.
      *
-     * This will still run every time analyze() is called so code can
-     * post new data as soon as possible and the timestamp will more
-     * accurately reflect the correct time.
-     *
      * D-Bus is only updated if there is a change and the oldest record
      * will be pruned if the property already contains the max number of
      * records.
+     *
+     * If there aren't any records yet or some were missed, the whole
+     * history buffer is read from the power supply instead so the
+     * D-Bus history isn't lost across restarts.
+     *
+     * The new records are always sent in the RecordsAdded signal,
+     * while the full arrays are updated based on fullHistoryInterval.
+     *
+     * @return bool - if there was a new record
+     */
+    bool updateHistory();
+
+    /**
+     * @brief Adds the history records newer than the newest one in
+     *        the archive to it.
+     */
+    void archiveRecords();
+
+    /**
+     * @brief Adds the history records that cover time after what
+     *        the energy already does to it.
+     */
+    void addRecordEnergy();
+
+    /**
+     * @brief Returns the current time for the energy, in
+     *        milliseconds since the epoch.  With history, it's on the
+     *        records' clock, so the samples and READ_EIN responses
+     *        line up with the records even if the system time was
+     *        changed.
+     */
+    uint64_t getEnergyTime() const;
+
+    /**
+     * @brief Callback for the energy timer.  Reads READ_EIN if the
+     *        power supply has it, publishes the energy, and saves it
+     *        now and then.
+     */
+    void updateEnergy();
+
+    /**
+     * @brief Run from historyQueue when the history timer expires.
+     *        Updates the history and schedules the next read.
+     *
+     * Once the record cadence is known, the next read is just after
+     * the next record is expected.  If it isn't there yet one confirm
+     * read is done shortly after, and if it still isn't there the
+     * history is polled until it shows up.
+     */
+    void readHistory();
+
+    /**
+     * @brief Updates the full average and maximum arrays in D-Bus
+     *        if fullHistoryInterval new records have been added
+     *        since the last time, or the history was cleared.
+     */
+    void updateFullHistory();
+
+    /**
+     * @brief Queues updating the average, maximum, minimum, and
+     *        percentile arrays in D-Bus for the rollup levels that
+     *        completed a period since the last time, a level at a time.
+     */
+    void updateRollups();
+
+    /**
+     * @brief Updates the arrays of a rollup level in D-Bus if it
+     *        completed a period since the last time.
+     *
+     * @param[in] level - the rollup level index
      */
-    void updateHistory();
+    void updateRollup(size_t level);
 };
 
 } // namespace psu
@@ -0,0 +1,122 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "record_export.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/log.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace phosphor::logging;
+
+using InternalFailure =
+    sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+RecordExport::RecordExport(const RecordManager& manager, uint64_t start,
+                           uint64_t end) :
+    epoch(manager.getEpoch()),
+    sequence(manager.getSequence()), start(start), end(end)
+{
+    auto range = manager.findRange(start, end);
+    count = range.second - range.first;
+
+    fd.set(memfd_create("input_history", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to create history export memfd",
+                        entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    auto size = sizeof(Header) + count * sizeof(Record);
+    if (ftruncate(fd(), size) == -1)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to size history export memfd",
+                        entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    // Filled in place, rather than written, so the records are only
+    // copied once and the file offset stays at the start.  The memfd
+    // starts out zeroed, which covers the reserved fields.
+    auto mapping =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd(), 0);
+    if (mapping == MAP_FAILED)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to map history export memfd",
+                        entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    auto header = static_cast<Header*>(mapping);
+    header->magic = EXPORT_MAGIC;
+    header->version = EXPORT_VERSION;
+    header->recordSize = sizeof(Record);
+    header->epoch = epoch;
+    header->sequence = sequence;
+    header->count = count;
+    header->recordOffset = sizeof(Header);
+
+    auto records = reinterpret_cast<Record*>(static_cast<uint8_t*>(mapping) +
+                                             sizeof(Header));
+    for (size_t i = 0; i < count; i++)
+    {
+        auto r = manager.at(range.first + i);
+        records[i].timestamp = r.timestamp();
+        records[i].average = r.average();
+        records[i].maximum = r.maximum();
+        records[i].id = r.id();
+    }
+
+    // Can't be sealed against writes while mapped writable
+    munmap(mapping, size);
+
+    // Consumers map it, so it must never change under them
+    if (fcntl(fd(), F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to seal history export memfd",
+                        entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+}
+
+bool RecordExport::isCurrent(const RecordManager& manager, uint64_t start,
+                             uint64_t end) const
+{
+    return (manager.getEpoch() == epoch) &&
+           (manager.getSequence() == sequence) && (start == this->start) &&
+           (end == this->end);
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "file.hpp"
+#include "record_manager.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class RecordExport
+ *
+ * A copy of the input power history records within a time range,
+ * packed into a sealed memfd that is handed to D-Bus consumers, so
+ * large histories don't have to be marshalled into D-Bus messages.
+ *
+ * The consumer maps the file read only and reads the records in place.
+ * It is sealed, so it never changes after it is handed out.  Consumers
+ * that don't map it should use pread(), since every copy of the
+ * descriptor shares one file offset.
+ *
+ * The layout, all little endian and naturally aligned:
+ *
+ *   Header, 48 bytes at offset 0:
+ *     0   uint32  magic, EXPORT_MAGIC
+ *     4   uint16  version, EXPORT_VERSION
+ *     6   uint16  record size in bytes
+ *     8   uint64  epoch
+ *     16  uint64  sequence number of the newest record in the history
+ *     24  uint64  number of records in the file
+ *     32  uint64  offset of the first record in bytes
+ *     40  -       reserved
+ *
+ *   Records, newest first:
+ *     0   uint64  timestamp in milliseconds since the epoch
+ *     8   int64   average power
+ *     16  int64   maximum power
+ *     24  uint8   power supply sequence ID
+ *     25  -       reserved
+ */
+class RecordExport
+{
+  public:
+    static constexpr uint32_t EXPORT_MAGIC = 0x58454850; // 'PHEX'
+    static constexpr uint16_t EXPORT_VERSION = 1;
+
+    /**
+     * @brief The file header
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t recordSize;
+        uint64_t epoch;
+        uint64_t sequence;
+        uint64_t count;
+        uint64_t recordOffset;
+        uint64_t reserved;
+    };
+
+    /**
+     * @brief A record
+     */
+    struct Record
+    {
+        uint64_t timestamp;
+        int64_t average;
+        int64_t maximum;
+        uint8_t id;
+        uint8_t reserved[7];
+    };
+
+    static_assert(sizeof(Header) == 48, "Export header layout");
+    static_assert(sizeof(Record) == 32, "Export record layout");
+
+    RecordExport() = delete;
+    ~RecordExport() = default;
+    RecordExport(const RecordExport&) = delete;
+    RecordExport& operator=(const RecordExport&) = delete;
+    RecordExport(RecordExport&&) = delete;
+    RecordExport& operator=(RecordExport&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Creates, fills, and seals the memfd.  Throws InternalFailure
+     * if that fails.
+     *
+     * @param[in] manager - the manager of the history records
+     * @param[in] start - the oldest timestamp to include, in
+     *                    milliseconds since the epoch
+     * @param[in] end - the newest timestamp to include, or 0 for
+     *                  no limit
+     */
+    RecordExport(const RecordManager& manager, uint64_t start, uint64_t end);
+
+    /**
+     * @brief Says if this has the same contents an export of the
+     *        records as they are now would have.
+     *
+     * @param[in] manager - the manager of the history records
+     * @param[in] start - the oldest timestamp
+     * @param[in] end - the newest timestamp, or 0 for no limit
+     */
+    bool isCurrent(const RecordManager& manager, uint64_t start,
+                   uint64_t end) const;
+
+    /**
+     * @brief Returns the memfd
+     */
+    inline int getFD()
+    {
+        return fd();
+    }
+
+    /**
+     * @brief Returns the number of records in the file
+     */
+    inline uint64_t getCount() const
+    {
+        return count;
+    }
+
+  private:
+    /**
+     * @brief The memfd
+     */
+    util::FileDescriptor fd;
+
+    /**
+     * @brief The epoch and sequence number of the history
+     *        when the file was made
+     */
+    uint64_t epoch;
+    uint64_t sequence;
+
+    /**
+     * @brief The time range
+     */
+    uint64_t start;
+    uint64_t end;
+
+    /**
+     * @brief The number of records in the file
+     */
+    uint64_t count = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
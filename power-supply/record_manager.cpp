@@ -15,10 +15,15 @@
  */
 #include "record_manager.hpp"
 
+#include "history_file.hpp"
+
 #include <math.h>
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <phosphor-logging/log.hpp>
+#include <random>
 
 namespace witherspoon
 {
@@ -29,13 +34,76 @@ namespace history
 
 using namespace phosphor::logging;
 
+RecordManager::RecordManager(size_t maxRec, size_t lastSequenceID) :
+    maxRecords(maxRec), lastSequenceID(lastSequenceID), storage(maxRec),
+    ring(storage.data()), rollups(createRollups()),
+    clock(std::chrono::duration_cast<std::chrono::milliseconds>(
+        RECORD_INTERVAL))
+{
+    // Unless a history file restores it, start in an epoch that a
+    // consumer of a previous instance can't still be in, so it gets
+    // everything instead of waiting for a sequence number that was
+    // already used.
+    epoch = static_cast<uint64_t>(std::random_device{}()) << 32;
+}
+
+RecordManager::~RecordManager() = default;
+RecordManager::RecordManager(RecordManager&&) = default;
+
+void RecordManager::persist(const std::string& path)
+{
+    auto historyFile = std::make_unique<HistoryFile>(path, maxRecords);
+    auto saved = historyFile->getSavedState();
+
+    if (!saved)
+    {
+        // A new file, so start it off with the current records
+        std::copy_n(ring, maxRecords, historyFile->records());
+    }
+
+    file = std::move(historyFile);
+    ring = file->records();
+
+    storage.clear();
+    storage.shrink_to_fit();
+
+    if (saved)
+    {
+        head = saved->head;
+        count = saved->count;
+        baseTime = saved->baseTime;
+        epoch = saved->epoch;
+        sequence = saved->sequence;
+
+        checkRestoredRecords();
+    }
+
+    commit();
+}
+
+void RecordManager::clear()
+{
+    if (sequence != 0)
+    {
+        epoch++;
+    }
+
+    count = 0;
+    sequence = 0;
+
+    // The PS sequence is starting over
+    clock.reset();
+
+    commit();
+}
+
 bool RecordManager::add(const std::vector<uint8_t>& rawRecord)
 {
     if (rawRecord.size() == 0)
     {
         // The PS has no data - either the power supply just started up,
         // or it just got a SYNC.  Clear the history.
-        records.clear();
+        clear();
         return true;
     }
 
@@ -44,9 +112,9 @@ bool RecordManager::add(const std::vector<uint8_t>& rawRecord)
         // Peek at the ID to see if more processing is needed.
         auto id = getRawRecordID(rawRecord);
 
-        if (!records.empty())
+        if (count != 0)
         {
-            auto previousID = std::get<recIDPos>(records.front());
+            auto previousID = at(0).id();
 
             // Already have this record.  Done.
             if (previousID == id)
@@ -74,46 +142,246 @@ bool RecordManager::add(const std::vector<uint8_t>& rawRecord)
                             entry("OLD_ID=%ld", previousID),
                             entry("NEW_ID=%ld", id));
                     }
-                    records.clear();
+                    clear();
                 }
             }
         }
 
-        records.push_front(std::move(createRecord(rawRecord)));
+        // If no more should be stored, this replaces the oldest
+        tick(1);
+        addRecord(rawRecord, 0, clock.getTimestamp(0));
+    }
+    catch (InvalidRecordException& e)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordManager::needsBackfill(const std::vector<uint8_t>& rawRecord) const
+{
+    // Leave bad data for add() to deal with
+    if (rawRecord.size() != RAW_RECORD_SIZE)
+    {
+        return false;
+    }
 
-        // If no more should be stored, prune the oldest
-        if (records.size() > maxRecords)
+    if (count == 0)
+    {
+        return true;
+    }
+
+    auto id = rawRecord[RAW_RECORD_ID_OFFSET];
+    auto previousID = at(0).id();
+
+    return (id != previousID) && (getPreviousID(id) != previousID);
+}
+
+bool RecordManager::merge(const std::vector<uint8_t>& rawRecords)
+{
+    if (rawRecords.size() == 0)
+    {
+        // Same as add(), the PS has no data so clear the history.
+        clear();
+        return true;
+    }
+
+    if (rawRecords.size() < RAW_RECORD_SIZE)
+    {
+        log<level::ERR>("Invalid INPUT_HISTORY size",
+                        entry("SIZE=%d", rawRecords.size()));
+        return false;
+    }
+
+    // Find the contiguous run of records at the start of the
+    // buffer, newest first.
+    size_t runLength = 1;
+    size_t id = rawRecords[RAW_RECORD_ID_OFFSET];
+
+    while ((runLength < maxRecords) &&
+           ((runLength + 1) * RAW_RECORD_SIZE <= rawRecords.size()))
+    {
+        size_t nextID =
+            rawRecords[runLength * RAW_RECORD_SIZE + RAW_RECORD_ID_OFFSET];
+
+        if (getPreviousID(id) != nextID)
         {
-            records.pop_back();
+            break;
         }
+
+        id = nextID;
+        runLength++;
     }
-    catch (InvalidRecordException& e)
+
+    // Find where the records already known line up with the run.
+    auto newRecords = runLength;
+    if (count != 0)
+    {
+        auto previousID = at(0).id();
+
+        for (newRecords = 0; newRecords < runLength; newRecords++)
+        {
+            if (rawRecords[newRecords * RAW_RECORD_SIZE +
+                           RAW_RECORD_ID_OFFSET] == previousID)
+            {
+                break;
+            }
+        }
+
+        if (newRecords == runLength)
+        {
+            log<level::INFO>(
+                "INPUT_HISTORY sequence ID not in PS history "
+                "buffer. Replacing old entries",
+                entry("OLD_ID=%ld", previousID),
+                entry("NEW_ID=%ld", rawRecords[RAW_RECORD_ID_OFFSET]));
+            clear();
+        }
+    }
+
+    if (newRecords == 0)
     {
         return false;
     }
 
+    // The newest one was just created, and each one before it was
+    // created an interval earlier.  Add them oldest first so the
+    // newest ends up in front.
+    tick(newRecords);
+
+    for (auto i = newRecords; i > 0; i--)
+    {
+        addRecord(rawRecords, (i - 1) * RAW_RECORD_SIZE,
+                  clock.getTimestamp(i - 1));
+    }
+
     return true;
 }
 
-auto RecordManager::getAverageRecords() -> DBusRecordList
+auto RecordManager::getAverageRecords() const -> DBusRecordList
 {
     DBusRecordList list;
+    list.reserve(count);
 
-    for (const auto& r : records)
+    for (const auto& r : *this)
     {
-        list.emplace_back(std::get<recTimePos>(r), std::get<recAvgPos>(r));
+        list.emplace_back(r.timestamp(), r.average());
     }
 
     return list;
 }
 
-auto RecordManager::getMaximumRecords() -> DBusRecordList
+auto RecordManager::getMaximumRecords() const -> DBusRecordList
 {
     DBusRecordList list;
+    list.reserve(count);
+
+    for (const auto& r : *this)
+    {
+        list.emplace_back(r.timestamp(), r.maximum());
+    }
+
+    return list;
+}
+
+auto RecordManager::getRecordsSince(uint64_t sinceSequence) const
+    -> DBusCombinedRecordList
+{
+    DBusCombinedRecordList list;
+
+    if (sinceSequence >= sequence)
+    {
+        return list;
+    }
+
+    auto num = std::min<uint64_t>(sequence - sinceSequence, count);
+    list.reserve(num);
+
+    for (size_t i = 0; i < num; i++)
+    {
+        auto r = at(i);
+        list.emplace_back(r.timestamp(), r.average(), r.maximum(), r.id());
+    }
+
+    return list;
+}
+
+std::pair<size_t, size_t> RecordManager::findRange(uint64_t start,
+                                                   uint64_t end) const
+{
+    // Returns the first index where the predicate is false, given that
+    // it's true for all of the newer records and false for the older.
+    auto partition = [this](auto newerThan) {
+        size_t low = 0;
+        size_t high = count;
+
+        while (low < high)
+        {
+            auto mid = low + (high - low) / 2;
+            if (newerThan(static_cast<uint64_t>(at(mid).timestamp())))
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+
+        return low;
+    };
+
+    auto first = (end == 0) ? 0 : partition([end](auto t) { return t > end; });
+    auto last = partition([start](auto t) { return t >= start; });
+
+    return {first, std::max(first, last)};
+}
+
+auto RecordManager::getRecordsInRange(uint64_t start, uint64_t end,
+                                      uint64_t resolution) const
+    -> DBusCombinedRecordList
+{
+    DBusCombinedRecordList list;
+    auto range = findRange(start, end);
 
-    for (const auto& r : records)
+    if (resolution == 0)
     {
-        list.emplace_back(std::get<recTimePos>(r), std::get<recMaxPos>(r));
+        list.reserve(range.second - range.first);
+
+        for (auto i = range.first; i < range.second; i++)
+        {
+            auto r = at(i);
+            list.emplace_back(r.timestamp(), r.average(), r.maximum(), r.id());
+        }
+
+        return list;
+    }
+
+    auto i = range.first;
+    while (i < range.second)
+    {
+        auto newest = at(i);
+        auto bucket = static_cast<uint64_t>(newest.timestamp()) / resolution;
+        int64_t total = 0;
+        int64_t maximum = std::numeric_limits<int64_t>::min();
+        int64_t num = 0;
+
+        for (; i < range.second; i++)
+        {
+            auto r = at(i);
+            if (static_cast<uint64_t>(r.timestamp()) / resolution != bucket)
+            {
+                break;
+            }
+
+            total += r.average();
+            maximum = std::max(maximum, r.maximum());
+            num++;
+        }
+
+        list.emplace_back(bucket * resolution, total / num, maximum,
+                          newest.id());
     }
 
     return list;
@@ -131,7 +399,8 @@ size_t RecordManager::getRawRecordID(const std::vector<uint8_t>& data) const
     return data[RAW_RECORD_ID_OFFSET];
 }
 
-Record RecordManager::createRecord(const std::vector<uint8_t>& data)
+void RecordManager::addRecord(const std::vector<uint8_t>& data,
+                              size_t offset, int64_t time)
 {
     // The raw record format is:
     //  0xAABBCCDDEE
@@ -140,19 +409,204 @@ Record RecordManager::createRecord(const std::vector<uint8_t>& data)
     //    0xAA = sequence ID
     //    0xBBCC = average power in linear format (0xCC = MSB)
     //    0xDDEE = maximum power in linear format (0xEE = MSB)
-    auto id = getRawRecordID(data);
+    //
+    //  Multiple records in a history buffer are just back to back.
+    if (maxRecords == 0)
+    {
+        return;
+    }
+
+    PackedRecord record;
+    record.id = data[offset + RAW_RECORD_ID_OFFSET];
+    record.average =
+        static_cast<uint16_t>(data[offset + 2]) << 8 | data[offset + 1];
+    record.maximum =
+        static_cast<uint16_t>(data[offset + 4]) << 8 | data[offset + 3];
+    record.timeOffset = getTimeOffset(time);
+
+    // If full, the oldest record is about to be overwritten.  Drop
+    // it from the saved state first so the file never refers to a
+    // record while it is being written.
+    if (file && (count == maxRecords))
+    {
+        count--;
+        commit();
+    }
+
+    head = (head + 1) % maxRecords;
+    ring[head] = record;
+
+    if (count < maxRecords)
+    {
+        count++;
+    }
+
+    sequence++;
 
-    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now().time_since_epoch())
-                    .count();
+    commit();
+
+    rollup(time, linearToInteger(record.average),
+           linearToInteger(record.maximum));
+}
 
-    auto val = static_cast<uint16_t>(data[2]) << 8 | data[1];
-    auto averagePower = linearToInteger(val);
+uint32_t RecordManager::getTimeOffset(int64_t time)
+{
+    if (count == 0)
+    {
+        baseTime = time;
+    }
 
-    val = static_cast<uint16_t>(data[4]) << 8 | data[3];
-    auto maxPower = linearToInteger(val);
+    auto offset = time - baseTime;
+    if ((offset < 0) || (offset > std::numeric_limits<uint32_t>::max()))
+    {
+        rebase(time);
+        offset = std::clamp<int64_t>(time - baseTime, 0,
+                                     std::numeric_limits<uint32_t>::max());
+    }
 
-    return Record{id, time, averagePower, maxPower};
+    return offset;
+}
+
+void RecordManager::rebase(int64_t time)
+{
+    constexpr int64_t maxOffset = std::numeric_limits<uint32_t>::max();
+    auto oldest = time;
+    auto newest = time;
+
+    for (const auto& r : *this)
+    {
+        oldest = std::min(oldest, r.timestamp());
+        newest = std::max(newest, r.timestamp());
+    }
+
+    // Keep the newest part of the timeline if it doesn't all fit
+    auto newBase = std::max(oldest, newest - maxOffset);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& r = ring[(head + maxRecords - i) % maxRecords];
+        auto offset = baseTime + r.timeOffset - newBase;
+        r.timeOffset = std::clamp<int64_t>(offset, 0, maxOffset);
+    }
+
+    baseTime = newBase;
+
+    commit();
+}
+
+void RecordManager::commit()
+{
+    if (file)
+    {
+        file->commit({head, count, baseTime, epoch, sequence});
+    }
+}
+
+void RecordManager::tick(size_t numRecords)
+{
+    auto now = SequenceClock::getMonotonicTime();
+    clock.tick(now, numRecords);
+
+    if (clock.takeTimeStepBack())
+    {
+        log<level::INFO>("System time was set back past the newest record, "
+                         "starting the history over");
+        clear();
+        clock.tick(now, numRecords);
+    }
+}
+
+void RecordManager::checkRestoredRecords()
+{
+    // Newer records are always the next sequence ID and not older
+    size_t valid = std::min<size_t>(count, 1);
+    for (; valid < count; valid++)
+    {
+        auto newer = at(valid - 1);
+        auto older = at(valid);
+
+        if ((older.id() != getPreviousID(newer.id())) ||
+            (older.timestamp() > newer.timestamp()))
+        {
+            break;
+        }
+    }
+
+    if (valid != count)
+    {
+        log<level::INFO>("Dropping out of order records from history file",
+                         entry("NUM_RECORDS=%d", count - valid));
+        count = valid;
+    }
+
+    // If the newest record is older than the PS history buffer goes
+    // back, there is no telling if the IDs will line up.
+    auto oldest =
+        getCurrentTime() -
+        std::chrono::duration_cast<std::chrono::milliseconds>(RECORD_INTERVAL)
+                .count() *
+            MAX_RAW_RECORDS;
+
+    if ((count != 0) && (at(0).timestamp() < oldest))
+    {
+        log<level::INFO>("Records in history file are too old to use");
+        clear();
+    }
+
+    // New records must still come after these if the time was set back
+    if (count != 0)
+    {
+        clock.setNewestTimestamp(at(0).timestamp());
+    }
+}
+
+void RecordManager::rollup(int64_t time, int64_t average, int64_t maximum)
+{
+    if (time <= lastRollupTime)
+    {
+        return;
+    }
+
+    lastRollupTime = time;
+
+    // Each level passes up at most one completed period
+    std::optional<Rollup::Summary> summary{
+        Rollup::Summary{time, average, 1, maximum, average, 0, 0, 0}};
+
+    const PercentileSketch* sketch = nullptr;
+
+    for (auto& level : rollups)
+    {
+        summary = level.add(*summary, sketch);
+        if (!summary)
+        {
+            break;
+        }
+
+        sketch = &level.getCompletedSketch();
+    }
+}
+
+std::vector<Rollup> RecordManager::createRollups()
+{
+    using namespace std::chrono;
+
+    // A day of 5 minute periods, a week of hours, and a year of days
+    return {Rollup{"per_5m", minutes{5}, 288},
+            Rollup{"per_1h", hours{1}, 168},
+            Rollup{"per_1d", hours{24}, 365}};
+}
+
+size_t RecordManager::getPreviousID(size_t id) const
+{
+    return (id == FIRST_SEQUENCE_ID) ? lastSequenceID : id - 1;
+}
+
+int64_t RecordManager::getCurrentTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
 }
 
 int64_t RecordManager::linearToInteger(uint16_t data)
@@ -181,6 +635,16 @@ int64_t RecordManager::linearToInteger(uint16_t data)
     return value;
 }
 
+int64_t RecordView::average() const
+{
+    return RecordManager::linearToInteger(record->average);
+}
+
+int64_t RecordView::maximum() const
+{
+    return RecordManager::linearToInteger(record->maximum);
+}
+
 } // namespace history
 } // namespace power
 } // namespace witherspoon
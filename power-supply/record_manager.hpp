@@ -1,7 +1,17 @@
 #pragma once
 
-#include <deque>
+#include "rollup.hpp"
+#include "sequence_clock.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace witherspoon
@@ -11,11 +21,97 @@ namespace power
 namespace history
 {
 
-static constexpr auto recIDPos = 0;
-static constexpr auto recTimePos = 1;
-static constexpr auto recAvgPos = 2;
-static constexpr auto recMaxPos = 3;
-using Record = std::tuple<size_t, int64_t, int64_t, int64_t>;
+/**
+ * @brief A history record as it is stored
+ *
+ * The power values are kept in the linear format the PS
+ * returns them in and are only converted when read, and the
+ * timestamp is an offset from a base time.  This keeps a
+ * record down to 9 bytes.
+ */
+struct PackedRecord
+{
+    /** @brief Milliseconds since the base time */
+    uint32_t timeOffset;
+
+    /** @brief The average power in linear format */
+    uint16_t average;
+
+    /** @brief The maximum power in linear format */
+    uint16_t maximum;
+
+    /** @brief The sequence ID from the PS */
+    uint8_t id;
+} __attribute__((packed));
+
+static_assert(sizeof(PackedRecord) == 9, "PackedRecord must be packed");
+
+/**
+ * @class RecordView
+ *
+ * A read only view of a stored history record, which converts
+ * the fields into usable values when they are accessed.
+ */
+class RecordView
+{
+  public:
+    RecordView() = delete;
+    ~RecordView() = default;
+    RecordView(const RecordView&) = default;
+    RecordView& operator=(const RecordView&) = default;
+    RecordView(RecordView&&) = default;
+    RecordView& operator=(RecordView&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] record - the stored record
+     * @param[in] baseTime - the time the record's offset is from
+     */
+    RecordView(const PackedRecord& record, int64_t baseTime) :
+        record(&record), baseTime(baseTime)
+    {
+    }
+
+    /**
+     * @brief Returns the sequence ID
+     */
+    inline size_t id() const
+    {
+        return record->id;
+    }
+
+    /**
+     * @brief Returns the timestamp, in milliseconds since the epoch
+     */
+    inline int64_t timestamp() const
+    {
+        return baseTime + record->timeOffset;
+    }
+
+    /**
+     * @brief Returns the average power
+     */
+    int64_t average() const;
+
+    /**
+     * @brief Returns the maximum power
+     */
+    int64_t maximum() const;
+
+  private:
+    /**
+     * @brief The stored record
+     */
+    const PackedRecord* record;
+
+    /**
+     * @brief The time the record's time offset is from
+     */
+    int64_t baseTime;
+};
+
+class HistoryFile;
 
 /**
  * @class InvalidRecordException
@@ -44,6 +140,11 @@ class InvalidRecordException : public std::runtime_error
  * sorted newest to oldest, and prunes out the oldest entries when
  * necessary.  If there is a problem with the ordering IDs coming
  * from the PS, it will clear out the old records and start over.
+ *
+ * The records are kept in a ring buffer that is allocated up front,
+ * so new records overwrite the oldest ones without any allocations.
+ * The ring buffer can optionally be kept in a memory mapped file so
+ * the records survive restarts.
  */
 class RecordManager
 {
@@ -53,15 +154,31 @@ class RecordManager
     static constexpr auto FIRST_SEQUENCE_ID = 0;
     static constexpr auto LAST_SEQUENCE_ID = 0xFF;
 
+    /**
+     * @brief The number of records the power supply keeps in its
+     *        input history buffer.
+     */
+    static constexpr auto MAX_RAW_RECORDS = 20;
+
+    /**
+     * @brief How often the power supply creates a new record.
+     */
+    static constexpr auto RECORD_INTERVAL = std::chrono::seconds{30};
+
     using DBusRecord = std::tuple<uint64_t, int64_t>;
     using DBusRecordList = std::vector<DBusRecord>;
 
+    // Timestamp, average, maximum, PS sequence ID
+    using DBusCombinedRecord =
+        std::tuple<uint64_t, int64_t, int64_t, uint8_t>;
+    using DBusCombinedRecordList = std::vector<DBusCombinedRecord>;
+
     RecordManager() = delete;
-    ~RecordManager() = default;
-    RecordManager(const RecordManager&) = default;
-    RecordManager& operator=(const RecordManager&) = default;
-    RecordManager(RecordManager&&) = default;
-    RecordManager& operator=(RecordManager&&) = default;
+    ~RecordManager();
+    RecordManager(const RecordManager&) = delete;
+    RecordManager& operator=(const RecordManager&) = delete;
+    RecordManager(RecordManager&&);
+    RecordManager& operator=(RecordManager&&) = delete;
 
     /**
      * @brief Constructor
@@ -81,10 +198,74 @@ class RecordManager
      * @param[in] lastSequenceID - the last sequence ID the power supply
      *                             will use before starting over
      */
-    RecordManager(size_t maxRec, size_t lastSequenceID) :
-        maxRecords(maxRec), lastSequenceID(lastSequenceID)
+    RecordManager(size_t maxRec, size_t lastSequenceID);
+
+    /**
+     * @brief Moves the records into a memory mapped file, so
+     *        they are kept across restarts.
+     *
+     * If the file already holds records from a previous run
+     * they replace the current ones, unless they are too old
+     * to line up with the PS history buffer anymore.  From
+     * then on, every change is committed to the file.
+     *
+     * Throws InternalFailure if the file can't be used.
+     *
+     * @param[in] path - the path of the file
+     */
+    void persist(const std::string& path);
+
+    /**
+     * @class const_iterator
+     *
+     * Iterates over views of the records, newest to oldest.
+     */
+    class const_iterator
     {
-    }
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RecordView;
+
+        const_iterator(const RecordManager& manager, size_t index) :
+            manager(&manager), index(index)
+        {
+        }
+
+        inline RecordView operator*() const
+        {
+            return manager->at(index);
+        }
+
+        inline const_iterator& operator++()
+        {
+            index++;
+            return *this;
+        }
+
+        inline const_iterator operator++(int)
+        {
+            auto it = *this;
+            index++;
+            return it;
+        }
+
+        inline bool operator==(const const_iterator& other) const
+        {
+            return (manager == other.manager) && (index == other.index);
+        }
+
+        inline bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+      private:
+        const RecordManager* manager;
+        size_t index;
+    };
 
     /**
      * @brief Adds a new entry to the history
@@ -102,6 +283,43 @@ class RecordManager
      */
     bool add(const std::vector<uint8_t>& rawRecord);
 
+    /**
+     * @brief Says if the record passed in can't just be added
+     *        with add() because records would be lost.
+     *
+     * This is the case when there aren't any records yet, such
+     * as right after startup, or when the sequence ID skipped
+     * ahead because some records were missed.  The power supply
+     * still has those in its history buffer, so they can be
+     * recovered with merge().
+     *
+     * @param[in] rawRecord - the most recent record straight
+     *                        from the power supply
+     *
+     * @return bool - true if merge() should be used instead
+     */
+    bool needsBackfill(const std::vector<uint8_t>& rawRecord) const;
+
+    /**
+     * @brief Merges the full history buffer from the power supply
+     *        into the records.
+     *
+     * The buffer holds up to MAX_RAW_RECORDS records, newest first.
+     * Records newer than the newest one already known are added,
+     * and if the known records can't be lined up with the buffer
+     * by sequence ID they are replaced by the buffer contents.
+     * As the power supply doesn't provide timestamps, they are
+     * reconstructed from RECORD_INTERVAL working back from now.
+     *
+     * @param[in] rawRecords - the history buffer straight from
+     *                         the power supply
+     *
+     * @return bool - If there has been a change to the
+     *                history records that needs to be
+     *                reflected in D-Bus.
+     */
+    bool merge(const std::vector<uint8_t>& rawRecords);
+
     /**
      * @brief Returns the history of average input power
      *        in a representation used by D-Bus.
@@ -109,7 +327,7 @@ class RecordManager
      * @return DBusRecordList - A list of averages with
      *         a timestamp for each entry.
      */
-    DBusRecordList getAverageRecords();
+    DBusRecordList getAverageRecords() const;
 
     /**
      * @brief Returns the history of maximum input power
@@ -118,7 +336,135 @@ class RecordManager
      * @return DBusRecordList - A list of maximums with
      *         a timestamp for each entry.
      */
-    DBusRecordList getMaximumRecords();
+    DBusRecordList getMaximumRecords() const;
+
+    /**
+     * @brief Returns the records added after the sequence
+     *        number passed in, in a representation used by D-Bus.
+     *
+     * If some of those records have already been pruned,
+     * all records are returned.
+     *
+     * @param[in] sinceSequence - the sequence number of the
+     *                            last record already known
+     *
+     * @return DBusCombinedRecordList - A list of timestamps
+     *         with the average and maximum, newest first.
+     */
+    DBusCombinedRecordList getRecordsSince(uint64_t sinceSequence) const;
+
+    /**
+     * @brief Finds the records with timestamps within a time range
+     *        with a binary search, since the timestamps never go
+     *        backwards from newest to oldest.
+     *
+     * @param[in] start - the oldest timestamp, in milliseconds
+     *                    since the epoch
+     * @param[in] end - the newest timestamp, or 0 for no limit
+     *
+     * @return pair<size_t, size_t> - the indices of the first record
+     *         in the range and of the one after the last, newest first
+     */
+    std::pair<size_t, size_t> findRange(uint64_t start, uint64_t end) const;
+
+    /**
+     * @brief Returns the records within a time range, in a
+     *        representation used by D-Bus, optionally downsampled.
+     *
+     * When downsampling, the records are put into buckets of the
+     * resolution aligned to multiples of it since the epoch.  Each
+     * bucket gives a record with the bucket start time, the mean of
+     * the averages, the largest maximum, and the sequence ID of the
+     * newest record in it.
+     *
+     * @param[in] start - the oldest timestamp, in milliseconds
+     *                    since the epoch
+     * @param[in] end - the newest timestamp, or 0 for no limit
+     * @param[in] resolution - the bucket size in milliseconds, or
+     *                         0 for every record
+     *
+     * @return DBusCombinedRecordList - A list of timestamps
+     *         with the average and maximum, newest first.
+     */
+    DBusCombinedRecordList getRecordsInRange(uint64_t start, uint64_t end,
+                                             uint64_t resolution) const;
+
+    /**
+     * @brief Returns the current time on the records' clock, which
+     *        can be apart from the system time if it was changed.
+     *
+     * @return int64_t - the time in milliseconds since the epoch
+     */
+    inline int64_t getCurrentRecordTime() const
+    {
+        return clock.getTimestampAt(SequenceClock::getMonotonicTime());
+    }
+
+    /**
+     * @brief Returns when the power supply should make its next
+     *        record, once that is known from the previous ones.
+     *
+     * @return optional<int64_t> - the monotonic time in milliseconds
+     */
+    inline std::optional<int64_t> getNextRecordTime() const
+    {
+        return clock.getNextRecordTime();
+    }
+
+    /**
+     * @brief Notes a timestamp that new records must come after,
+     *        such as the newest one already archived, in case the
+     *        time was set back.
+     *
+     * @param[in] timestamp - the timestamp, in milliseconds
+     *                        since the epoch
+     */
+    inline void setNewestTimestamp(int64_t timestamp)
+    {
+        clock.setNewestTimestamp(timestamp);
+    }
+
+    /**
+     * @brief Returns the rollup levels, from the shortest
+     *        period to the longest.
+     *
+     * Every new record is added to them, and they are not
+     * affected by the records being cleared.
+     */
+    inline const std::vector<Rollup>& getRollups() const
+    {
+        return rollups;
+    }
+
+    /**
+     * @brief Returns the rollup levels to use, which the system
+     *        history uses too.
+     */
+    static std::vector<Rollup> createRollups();
+
+    /**
+     * @brief Returns the epoch, which is incremented every
+     *        time the records are cleared.  A new instance starts
+     *        in a random one unless it restores it from a file.
+     *
+     * @return uint64_t - the epoch
+     */
+    inline uint64_t getEpoch() const
+    {
+        return epoch;
+    }
+
+    /**
+     * @brief Returns the sequence number of the newest record,
+     *        which counts the records added since the records
+     *        were last cleared.
+     *
+     * @return uint64_t - the sequence number
+     */
+    inline uint64_t getSequence() const
+    {
+        return sequence;
+    }
 
     /**
      * @brief Converts a Linear Format power number to an integer
@@ -141,17 +487,46 @@ class RecordManager
      */
     inline size_t getNumRecords() const
     {
-        return records.size();
+        return count;
     }
 
     /**
-     * @brief Deletes all records
+     * @brief Returns a view of a record
+     *
+     * @param[in] index - the record index, where 0 is the newest.
+     *                    Must be less than getNumRecords().
+     *
+     * @return RecordView - the view of the record
+     */
+    inline RecordView at(size_t index) const
+    {
+        return RecordView{ring[(head + maxRecords - index) % maxRecords],
+                          baseTime};
+    }
+
+    /**
+     * @brief Returns an iterator to the newest record
+     */
+    inline const_iterator begin() const
+    {
+        return const_iterator{*this, 0};
+    }
+
+    /**
+     * @brief Returns an iterator past the oldest record
      */
-    inline void clear()
+    inline const_iterator end() const
     {
-        records.clear();
+        return const_iterator{*this, count};
     }
 
+    /**
+     * @brief Deletes all records
+     *
+     * Starts a new epoch if there were any records.
+     */
+    void clear();
+
   private:
     /**
      * @brief returns the sequence ID from a raw history record
@@ -165,13 +540,90 @@ class RecordManager
     size_t getRawRecordID(const std::vector<uint8_t>& data) const;
 
     /**
-     * @brief Creates an instance of a Record from the raw PS data
+     * @brief Stores one of the records in a raw PS history buffer
+     *        as the newest record, replacing the oldest one if
+     *        the history is full.
      *
-     * @param[in] data - the raw record data as the PS returns it
+     * @param[in] data - the raw history buffer as the PS returns it
+     * @param[in] offset - the offset of the record in the buffer
+     * @param[in] time - the timestamp to use for the record
+     */
+    void addRecord(const std::vector<uint8_t>& data, size_t offset,
+                   int64_t time);
+
+    /**
+     * @brief Returns the offset from the base time to store for the
+     *        timestamp passed in, moving the base time if necessary.
      *
-     * @return Record - A filled in Record instance
+     * @param[in] time - the timestamp
+     *
+     * @return uint32_t - the offset to store
      */
-    Record createRecord(const std::vector<uint8_t>& data);
+    uint32_t getTimeOffset(int64_t time);
+
+    /**
+     * @brief Moves the base time so the timestamp passed in fits,
+     *        and adjusts the offsets of the stored records to match.
+     *
+     * If the timestamps span more than an offset can hold, such as
+     * after the system time was set, the oldest ones are clamped.
+     *
+     * @param[in] time - the timestamp that needs to fit
+     */
+    void rebase(int64_t time);
+
+    /**
+     * @brief Saves the ring buffer state in the history file,
+     *        if there is one.
+     */
+    void commit();
+
+    /**
+     * @brief Notes new records on the clock.  If the system time was
+     *        set back too far for them to come after the records
+     *        already there, the history is cleared so the new ones
+     *        start a new epoch.
+     *
+     * @param[in] numRecords - the number of new records
+     */
+    void tick(size_t numRecords);
+
+    /**
+     * @brief Drops records restored from the history file that
+     *        can't be used.
+     *
+     * These are any out of order ones, or all of them if they
+     * are too old.
+     */
+    void checkRestoredRecords();
+
+    /**
+     * @brief Returns the sequence ID the power supply used
+     *        right before the one passed in.
+     *
+     * @param[in] id - the sequence ID
+     *
+     * @return size_t - the previous ID, accounting for rollover
+     */
+    size_t getPreviousID(size_t id) const;
+
+    /**
+     * @brief Adds a new record to the rollups, passing any completed
+     *        periods up through the levels.
+     *
+     * Records that aren't newer than the last one added are ignored,
+     * as they were already added before the history was rebuilt.
+     *
+     * @param[in] time - the record timestamp
+     * @param[in] average - the record average, in watts
+     * @param[in] maximum - the record maximum, in watts
+     */
+    void rollup(int64_t time, int64_t average, int64_t maximum);
+
+    /**
+     * @brief Returns the current time in milliseconds since the epoch
+     */
+    static int64_t getCurrentTime();
 
     /**
      * @brief The maximum number of entries to keep in the history.
@@ -187,11 +639,66 @@ class RecordManager
     const size_t lastSequenceID;
 
     /**
-     * @brief The list of timestamp/average/maximum records.
-     *        Newer records are added to the front, and older ones
-     *        removed from the back.
+     * @brief The memory for the ring buffer when it isn't in
+     *        the history file.
+     */
+    std::vector<PackedRecord> storage;
+
+    /**
+     * @brief The ring buffer of records, sized to maxRecords.
+     *
+     * Points to either storage or the records in the history file.
+     */
+    PackedRecord* ring;
+
+    /**
+     * @brief The file the ring buffer is kept in, if any
+     */
+    std::unique_ptr<HistoryFile> file;
+
+    /**
+     * @brief The rollup levels, each fed by the one before it.
+     */
+    std::vector<Rollup> rollups;
+
+    /**
+     * @brief Provides the record timestamps from their place
+     *        in the sequence.
+     */
+    SequenceClock clock;
+
+    /**
+     * @brief The timestamp of the last record added to the rollups
+     */
+    int64_t lastRollupTime = 0;
+
+    /**
+     * @brief The index in storage of the newest record.
+     */
+    size_t head = 0;
+
+    /**
+     * @brief The number of valid records in storage.
+     */
+    size_t count = 0;
+
+    /**
+     * @brief The time the record time offsets are from, in
+     *        milliseconds since the epoch.
+     */
+    int64_t baseTime = 0;
+
+    /**
+     * @brief Incremented every time the records are cleared.  It
+     *        starts at a random value, or the restored one.
+     */
+    uint64_t epoch = 0;
+
+    /**
+     * @brief The number of records added since the records were
+     *        last cleared.
      */
-    std::deque<Record> records;
+    uint64_t sequence = 0;
 };
 
 } // namespace history
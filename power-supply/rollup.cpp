@@ -0,0 +1,157 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "rollup.hpp"
+
+#include <algorithm>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+auto Rollup::add(const Summary& summary, const PercentileSketch* sketch)
+    -> std::optional<Summary>
+{
+    auto start = summary.timestamp - (summary.timestamp % period);
+    std::optional<Summary> completed;
+
+    if (current.samples != 0)
+    {
+        if (start < current.timestamp)
+        {
+            return completed;
+        }
+
+        if (start != current.timestamp)
+        {
+            const auto& s = sketches[currentSketch];
+            current.p50 = s.getPercentile(50);
+            current.p95 = s.getPercentile(95);
+            current.p99 = s.getPercentile(99);
+
+            store(current);
+            completed = current;
+            current.samples = 0;
+
+            currentSketch ^= 1;
+            sketches[currentSketch].clear();
+        }
+    }
+
+    if (sketch)
+    {
+        sketches[currentSketch].merge(*sketch);
+    }
+    else
+    {
+        sketches[currentSketch].add(summary.average());
+    }
+
+    if (current.samples == 0)
+    {
+        current = summary;
+        current.timestamp = start;
+    }
+    else
+    {
+        current.sum += summary.sum;
+        current.samples += summary.samples;
+        current.maximum = std::max(current.maximum, summary.maximum);
+        current.minimum = std::min(current.minimum, summary.minimum);
+    }
+
+    return completed;
+}
+
+void Rollup::store(const Summary& summary)
+{
+    sequence++;
+
+    if (storage.empty())
+    {
+        return;
+    }
+
+    head = (head + 1) % storage.size();
+    storage[head] = summary;
+
+    if (count < storage.size())
+    {
+        count++;
+    }
+}
+
+auto Rollup::getAverageRecords() const -> DBusRecordList
+{
+    DBusRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& s = at(i);
+        list.emplace_back(s.timestamp, s.average());
+    }
+
+    return list;
+}
+
+auto Rollup::getMaximumRecords() const -> DBusRecordList
+{
+    DBusRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& s = at(i);
+        list.emplace_back(s.timestamp, s.maximum);
+    }
+
+    return list;
+}
+
+auto Rollup::getMinimumRecords() const -> DBusRecordList
+{
+    DBusRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& s = at(i);
+        list.emplace_back(s.timestamp, s.minimum);
+    }
+
+    return list;
+}
+
+auto Rollup::getPercentileRecords() const -> DBusPercentileRecordList
+{
+    DBusPercentileRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& s = at(i);
+        list.emplace_back(s.timestamp, s.p50, s.p95, s.p99, s.maximum);
+    }
+
+    return list;
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
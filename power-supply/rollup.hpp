@@ -0,0 +1,275 @@
+#pragma once
+
+#include "sketch.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class Rollup
+ *
+ * One level of the input power history rollups, which aggregates
+ * the records from the level below it into fixed, clock aligned
+ * periods, such as 5 minutes or 1 hour.
+ *
+ * The period in progress is kept as a running summary, so each new
+ * record costs O(1).  When a record for a later period shows up the
+ * running summary is stored as a completed one and passed up to the
+ * next level.  The completed ones are kept in a ring buffer that is
+ * allocated up front.
+ *
+ * Each level also keeps a PercentileSketch of the 30s averages in
+ * the period in progress, which is merged into the next level's
+ * when the period completes.  Only the resulting percentiles are
+ * stored with each completed period.
+ */
+class Rollup
+{
+  public:
+    /**
+     * @brief The aggregate of the records in a period
+     */
+    struct Summary
+    {
+        /**
+         * @brief The start of the period, in milliseconds
+         *        since the epoch
+         */
+        int64_t timestamp;
+
+        /**
+         * @brief The sum of the 30s averages in the period
+         */
+        int64_t sum;
+
+        /**
+         * @brief The number of 30s records in the period
+         */
+        uint64_t samples;
+
+        /**
+         * @brief The highest maximum in the period
+         */
+        int64_t maximum;
+
+        /**
+         * @brief The lowest 30s average in the period
+         */
+        int64_t minimum;
+
+        /**
+         * @brief The 50th, 95th, and 99th percentiles of the
+         *        30s averages in the period, once it completes.
+         */
+        int64_t p50;
+        int64_t p95;
+        int64_t p99;
+
+        /**
+         * @brief Returns the average power over the period
+         */
+        inline int64_t average() const
+        {
+            return (samples != 0) ? sum / static_cast<int64_t>(samples) : 0;
+        }
+    };
+
+    using DBusRecord = std::tuple<uint64_t, int64_t>;
+    using DBusRecordList = std::vector<DBusRecord>;
+
+    // Timestamp, p50, p95, p99, maximum
+    using DBusPercentileRecord =
+        std::tuple<uint64_t, int64_t, int64_t, int64_t, int64_t>;
+    using DBusPercentileRecordList = std::vector<DBusPercentileRecord>;
+
+    Rollup() = delete;
+    ~Rollup() = default;
+    Rollup(const Rollup&) = default;
+    Rollup& operator=(const Rollup&) = default;
+    Rollup(Rollup&&) = default;
+    Rollup& operator=(Rollup&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] name - the name of the level, like per_5m, used
+     *                   in its D-Bus path
+     * @param[in] period - the length of each period
+     * @param[in] maxRecords - the number of completed periods to keep
+     */
+    Rollup(const std::string& name, std::chrono::seconds period,
+           size_t maxRecords) :
+        name(name),
+        period(std::chrono::duration_cast<std::chrono::milliseconds>(period)
+                   .count()),
+        storage(maxRecords)
+    {
+    }
+
+    /**
+     * @brief Adds the summary of a record, or of a completed period
+     *        from the level below, to the period in progress.
+     *
+     * Summaries older than the period in progress are ignored.
+     *
+     * @param[in] summary - the summary to add
+     * @param[in] sketch - the distribution of the values in the
+     *                     summary, or nullptr if it is for a single
+     *                     record, in which case its average is used.
+     *
+     * @return optional<Summary> - the period that was completed by
+     *                             this one, if any, to pass up to the
+     *                             next level along with the sketch
+     *                             from getCompletedSketch().
+     */
+    std::optional<Summary> add(const Summary& summary,
+                               const PercentileSketch* sketch = nullptr);
+
+    /**
+     * @brief Returns the sketch of the period in progress
+     */
+    inline const PercentileSketch& getSketch() const
+    {
+        return sketches[currentSketch];
+    }
+
+    /**
+     * @brief Returns the sketch of the last completed period
+     */
+    inline const PercentileSketch& getCompletedSketch() const
+    {
+        return sketches[currentSketch ^ 1];
+    }
+
+    /**
+     * @brief Returns the name of the level
+     */
+    inline const std::string& getName() const
+    {
+        return name;
+    }
+
+    /**
+     * @brief Returns the number of periods completed so far, which
+     *        changes every time a new one is stored.
+     */
+    inline uint64_t getSequence() const
+    {
+        return sequence;
+    }
+
+    /**
+     * @brief Returns the number of completed periods stored
+     */
+    inline size_t getNumRecords() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Returns a completed period
+     *
+     * @param[in] index - 0 is the newest
+     */
+    inline const Summary& at(size_t index) const
+    {
+        return storage[(head + storage.size() - index) % storage.size()];
+    }
+
+    /**
+     * @brief Returns the completed averages, newest first, in
+     *        the format used by the D-Bus Average interface.
+     */
+    DBusRecordList getAverageRecords() const;
+
+    /**
+     * @brief Returns the completed maximums, newest first, in
+     *        the format used by the D-Bus Maximum interface.
+     */
+    DBusRecordList getMaximumRecords() const;
+
+    /**
+     * @brief Returns the completed minimums, newest first, in
+     *        the format used by the D-Bus Minimum interface.
+     */
+    DBusRecordList getMinimumRecords() const;
+
+    /**
+     * @brief Returns the completed percentiles and maximums, newest
+     *        first, in the format used by the D-Bus Percentile
+     *        interface.
+     */
+    DBusPercentileRecordList getPercentileRecords() const;
+
+  private:
+    /**
+     * @brief Stores a completed period in the ring buffer
+     *
+     * @param[in] summary - the completed period
+     */
+    void store(const Summary& summary);
+
+    /**
+     * @brief The name of the level
+     */
+    std::string name;
+
+    /**
+     * @brief The length of a period in milliseconds
+     */
+    int64_t period;
+
+    /**
+     * @brief The period in progress.  It has no samples
+     *        until the first record shows up.
+     */
+    Summary current{0, 0, 0, 0, 0, 0, 0, 0};
+
+    /**
+     * @brief The sketches of the period in progress and the
+     *        last completed one, which trade places when a
+     *        period completes.
+     */
+    std::array<PercentileSketch, 2> sketches;
+
+    /**
+     * @brief The index in sketches of the period in progress
+     */
+    size_t currentSketch = 0;
+
+    /**
+     * @brief The ring buffer of completed periods
+     */
+    std::vector<Summary> storage;
+
+    /**
+     * @brief The index in storage of the newest period
+     */
+    size_t head = 0;
+
+    /**
+     * @brief The number of valid periods in storage
+     */
+    size_t count = 0;
+
+    /**
+     * @brief The number of periods completed so far
+     */
+    uint64_t sequence = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,262 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sampler.hpp"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <phosphor-logging/log.hpp>
+#include <regex>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+/**
+ * @brief How to provide the hwmon files of a type
+ */
+struct SensorType
+{
+    /**
+     * @brief The hwmon file prefix, like 'in' for in1_input
+     */
+    const char* prefix;
+
+    /**
+     * @brief The sensor namespace under SENSOR_ROOT
+     */
+    const char* space;
+
+    /**
+     * @brief The unit of the values
+     */
+    ValueInterface::Unit unit;
+
+    /**
+     * @brief The scale of the hwmon values
+     */
+    int64_t scale;
+
+    /**
+     * @brief How far the values must move before they're published
+     */
+    int64_t deadband;
+};
+
+// hwmon power is in microwatts, voltage in millivolts, current in
+// milliamps, temperature in millidegrees, and fan speed in RPM.
+const std::array<SensorType, 5> sensorTypes{
+    {{"power", "power", ValueInterface::Unit::Watts, -6, 1000000},
+     {"in", "voltage", ValueInterface::Unit::Volts, -3, 50},
+     {"curr", "current", ValueInterface::Unit::Amperes, -3, 50},
+     {"temp", "temperature", ValueInterface::Unit::DegreesC, -3, 500},
+     {"fan", "fan_tach", ValueInterface::Unit::RPMS, 0, 100}}};
+
+Sampler::Sampler(sdbusplus::bus::bus& bus, const sdeventplus::Event& e,
+                 witherspoon::pmbus::PMBus& pmbus, const std::string& name,
+                 std::chrono::milliseconds interval, size_t windowSize) :
+    bus(bus),
+    pmbusIntf(pmbus), name(name),
+    interval(std::clamp(interval, std::chrono::milliseconds{MIN_INTERVAL},
+                        std::chrono::milliseconds{MAX_INTERVAL})),
+    windowSize(std::max<size_t>(windowSize, 1)),
+    timer(e, std::bind([this]() { this->sample(); }))
+{
+}
+
+void Sampler::start()
+{
+    scan();
+
+    if (!sensors.empty())
+    {
+        timer.restart(interval);
+    }
+}
+
+void Sampler::stop()
+{
+    timer.setEnabled(false);
+    sensors.clear();
+    samples = 0;
+}
+
+void Sampler::scan()
+{
+    sensors.clear();
+    samples = 0;
+
+    auto dir = pmbusIntf.getPath(witherspoon::pmbus::Type::Hwmon);
+    std::error_code ec;
+    fs::directory_iterator files{dir, ec};
+    if (ec)
+    {
+        log<level::INFO>("No hwmon files to sample",
+                         entry("PATH=%s", dir.c_str()));
+        return;
+    }
+
+    std::regex inputFile{"([a-z]+)([0-9]+)_input"};
+
+    for (const auto& file : files)
+    {
+        std::smatch match;
+        auto filename = file.path().filename().string();
+        if (!std::regex_match(filename, match, inputFile))
+        {
+            continue;
+        }
+
+        auto type = std::find_if(
+            sensorTypes.begin(), sensorTypes.end(),
+            [&match](const auto& type) { return match[1] == type.prefix; });
+        if (type == sensorTypes.end())
+        {
+            continue;
+        }
+
+        auto sensor = std::make_unique<Sensor>();
+        sensor->fd.set(open(file.path().c_str(), O_RDONLY | O_CLOEXEC));
+        if (!sensor->fd)
+        {
+            continue;
+        }
+
+        // Use the label the driver gives it, like 'vin', if there is one
+        std::string label = match[1].str() + match[2].str();
+        std::ifstream labelFile{dir / (label + "_label")};
+        std::string driverLabel;
+        if (labelFile && std::getline(labelFile, driverLabel) &&
+            !driverLabel.empty())
+        {
+            label = driverLabel;
+        }
+
+        auto objectPath = fs::path{SENSOR_ROOT} / type->space /
+                          (name + '_' + label);
+
+        sensor->deadband = type->deadband;
+        sensor->inputPower = (label == "pin");
+        sensor->object = std::make_unique<SensorObject>(
+            bus, objectPath.c_str());
+        sensor->object->unit(type->unit);
+        sensor->object->scale(type->scale);
+        sensor->object->interval(interval.count());
+
+        sensors.push_back(std::move(sensor));
+    }
+}
+
+void Sampler::sample()
+{
+    using namespace std::chrono;
+
+    for (auto& sensor : sensors)
+    {
+        // A missed sample just makes the window a little smaller
+        auto value = readValue(sensor->fd);
+        if (value)
+        {
+            sensor->stats.add(*value);
+
+            if (sensor->inputPower && inputPowerCallback)
+            {
+                auto now = duration_cast<milliseconds>(
+                    system_clock::now().time_since_epoch());
+                inputPowerCallback(now.count(), *value / 1000000.0);
+            }
+        }
+    }
+
+    if (++samples < windowSize)
+    {
+        return;
+    }
+
+    for (auto& sensor : sensors)
+    {
+        publish(*sensor);
+        sensor->stats.clear();
+    }
+
+    samples = 0;
+}
+
+void Sampler::publish(Sensor& sensor)
+{
+    const auto& stats = sensor.stats;
+    if (stats.getCount() == 0)
+    {
+        return;
+    }
+
+    auto& object = *sensor.object;
+    auto mean = std::llround(stats.getMean());
+    auto range = stats.getMaximum() - stats.getMinimum();
+    auto lastRange = object.maximum() - object.minimum();
+
+    // Publish when the level moves, or when the spread
+    // of the samples around it does.
+    if (sensor.published &&
+        (std::abs(mean - object.value()) < sensor.deadband) &&
+        (std::abs(range - lastRange) < sensor.deadband))
+    {
+        return;
+    }
+
+    object.value(mean);
+    object.minimum(stats.getMinimum());
+    object.maximum(stats.getMaximum());
+    object.mean(stats.getMean());
+    object.standardDeviation(stats.getStandardDeviation());
+    object.samples(stats.getCount());
+
+    sensor.published = true;
+}
+
+std::optional<int64_t> Sampler::readValue(util::FileDescriptor& fd)
+{
+    std::array<char, 32> buffer;
+
+    auto size = pread(fd(), buffer.data(), buffer.size() - 1, 0);
+    if (size <= 0)
+    {
+        return std::nullopt;
+    }
+    buffer[size] = '\0';
+
+    char* end = nullptr;
+    auto value = std::strtoll(buffer.data(), &end, 10);
+    if (end == buffer.data())
+    {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "file.hpp"
+#include "pmbus.hpp"
+#include "window_stats.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <org/open_power/Witherspoon/Sensor/WindowStatistics/server.hpp>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/object.hpp>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+#include <string>
+#include <vector>
+#include <xyz/openbmc_project/Sensor/Value/server.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using ValueInterface = sdbusplus::xyz::openbmc_project::Sensor::server::Value;
+
+using WindowStatisticsInterface = sdbusplus::org::open_power::Witherspoon::
+    Sensor::server::WindowStatistics;
+
+using SensorObject =
+    sdbusplus::server::object::object<ValueInterface,
+                                      WindowStatisticsInterface>;
+
+/**
+ * @class Sampler
+ *
+ * Samples the power, voltage, current, temperature, and fan speed
+ * hwmon files of a power supply at a configurable rate, and provides
+ * each one on D-Bus as a Sensor.Value along with the minimum, maximum,
+ * mean, and standard deviation of the samples over a window.
+ *
+ * The files are kept open and read with pread() so a sample is a
+ * single system call.  The D-Bus properties are only updated at the
+ * end of a window, and then only when they moved by more than the
+ * sensor type's deadband, so fast sampling doesn't flood D-Bus with
+ * PropertiesChanged signals for noise.
+ */
+class Sampler
+{
+  public:
+    /**
+     * @brief Called with every input power sample, with the time in
+     *        milliseconds since the epoch and the power in watts.
+     */
+    using InputPowerCallback = std::function<void(uint64_t, double)>;
+
+    /**
+     * @brief The shortest time allowed between samples
+     */
+    static constexpr auto MIN_INTERVAL = std::chrono::milliseconds{100};
+
+    /**
+     * @brief The longest time allowed between samples
+     */
+    static constexpr auto MAX_INTERVAL = std::chrono::milliseconds{10000};
+
+    /**
+     * @brief The D-Bus object path the sensors go under
+     */
+    static constexpr auto SENSOR_ROOT = "/xyz/openbmc_project/sensors";
+
+    Sampler() = delete;
+    ~Sampler() = default;
+    Sampler(const Sampler&) = delete;
+    Sampler& operator=(const Sampler&) = delete;
+    Sampler(Sampler&&) = delete;
+    Sampler& operator=(Sampler&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] e - event object
+     * @param[in] pmbus - the PMBus interface of the power supply
+     * @param[in] name - the sensor name prefix, like ps0
+     * @param[in] interval - the time between samples, between
+     *                       MIN_INTERVAL and MAX_INTERVAL
+     * @param[in] windowSize - the number of samples in a window
+     */
+    Sampler(sdbusplus::bus::bus& bus, const sdeventplus::Event& e,
+            witherspoon::pmbus::PMBus& pmbus, const std::string& name,
+            std::chrono::milliseconds interval, size_t windowSize);
+
+    /**
+     * @brief Finds the hwmon files, creates their sensors, and starts
+     *        sampling.
+     *
+     * Called whenever the power supply becomes present, since its
+     * hwmon directory may have changed.
+     */
+    void start();
+
+    /**
+     * @brief Stops sampling and removes the sensors
+     *
+     * Called when the power supply is removed, so stale values
+     * aren't left on D-Bus.
+     */
+    void stop();
+
+    /**
+     * @brief Sets the function to call with the input power samples
+     *
+     * @param[in] callback - the function
+     */
+    inline void setInputPowerCallback(InputPowerCallback&& callback)
+    {
+        inputPowerCallback = std::move(callback);
+    }
+
+  private:
+    /**
+     * @brief A sampled hwmon file and its D-Bus object
+     */
+    struct Sensor
+    {
+        /**
+         * @brief The open hwmon file
+         */
+        util::FileDescriptor fd;
+
+        /**
+         * @brief How far the values must move before they're published
+         */
+        int64_t deadband = 0;
+
+        /**
+         * @brief The statistics of the current window
+         */
+        WindowStats stats;
+
+        /**
+         * @brief If the object has been given values yet
+         */
+        bool published = false;
+
+        /**
+         * @brief If this is the input power
+         */
+        bool inputPower = false;
+
+        /**
+         * @brief The D-Bus object
+         */
+        std::unique_ptr<SensorObject> object;
+    };
+
+    /**
+     * @brief Opens the hwmon input files and creates a sensor for each
+     */
+    void scan();
+
+    /**
+     * @brief Timer callback.  Reads a sample from every sensor, and
+     *        publishes them at the end of a window.
+     */
+    void sample();
+
+    /**
+     * @brief Publishes the current window of a sensor if it moved by
+     *        more than the deadband since the last one.
+     *
+     * @param[in] sensor - the sensor
+     */
+    void publish(Sensor& sensor);
+
+    /**
+     * @brief Reads a decimal value from the start of an open file
+     *
+     * @param[in] fd - the file
+     *
+     * @return optional<int64_t> - the value, or empty if it
+     *                              couldn't be read
+     */
+    static std::optional<int64_t> readValue(util::FileDescriptor& fd);
+
+    /**
+     * @brief The D-Bus object
+     */
+    sdbusplus::bus::bus& bus;
+
+    /**
+     * @brief The PMBus interface, used to find the hwmon directory
+     */
+    witherspoon::pmbus::PMBus& pmbusIntf;
+
+    /**
+     * @brief The sensor name prefix
+     */
+    const std::string name;
+
+    /**
+     * @brief The time between samples
+     */
+    const std::chrono::milliseconds interval;
+
+    /**
+     * @brief The number of samples in a window
+     */
+    const size_t windowSize;
+
+    /**
+     * @brief The number of samples taken in the current window
+     */
+    size_t samples = 0;
+
+    /**
+     * @brief The sensors
+     */
+    std::vector<std::unique_ptr<Sensor>> sensors;
+
+    /**
+     * @brief Called with the input power samples
+     */
+    InputPowerCallback inputPowerCallback;
+
+    /**
+     * @brief The sampling timer
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+};
+
+} // namespace power
+} // namespace witherspoon
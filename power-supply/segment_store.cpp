@@ -0,0 +1,536 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "segment_store.hpp"
+
+#include "file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <phosphor-logging/log.hpp>
+#include <stdexcept>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr auto SEGMENT_PREFIX = "segment.";
+
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^
+           static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putVarint(std::vector<uint8_t>& data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+uint8_t getByte(const std::vector<uint8_t>& data, size_t& offset)
+{
+    if (offset >= data.size())
+    {
+        throw std::runtime_error("Truncated segment store block");
+    }
+    return data[offset++];
+}
+
+uint64_t getVarint(const std::vector<uint8_t>& data, size_t& offset)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        auto byte = getByte(data, offset);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("Invalid varint in segment store block");
+}
+
+/**
+ * @brief Reads exactly size bytes at an offset
+ *
+ * @return bool - false if it couldn't
+ */
+bool readAt(int fd, void* data, size_t size, off_t offset)
+{
+    auto p = static_cast<uint8_t*>(data);
+    while (size != 0)
+    {
+        auto rc = pread(fd, p, size, offset);
+        if (rc == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (rc <= 0)
+        {
+            return false;
+        }
+        p += rc;
+        size -= rc;
+        offset += rc;
+    }
+    return true;
+}
+
+} // namespace
+
+SegmentStore::SegmentStore(const std::string& dir, size_t maxSize,
+                           size_t segmentSize, size_t blockRecords) :
+    dir(dir),
+    maxSize(maxSize), segmentSize(segmentSize),
+    blockRecords(std::max<size_t>(blockRecords, 1))
+{
+    std::error_code ec;
+    fs::create_directories(this->dir, ec);
+    if (ec)
+    {
+        log<level::ERR>("Failed to create the segment store directory",
+                        entry("PATH=%s", dir.c_str()),
+                        entry("ERROR=%s", ec.message().c_str()));
+    }
+
+    load();
+    evict();
+}
+
+SegmentStore::~SegmentStore()
+{
+    flush();
+}
+
+fs::path SegmentStore::getPath(uint64_t number) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%s%010llu", SEGMENT_PREFIX,
+             static_cast<unsigned long long>(number));
+    return dir / name;
+}
+
+void SegmentStore::load()
+{
+    std::vector<uint64_t> numbers;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec))
+    {
+        auto name = entry.path().filename().string();
+        if ((name.compare(0, strlen(SEGMENT_PREFIX), SEGMENT_PREFIX) != 0) ||
+            (name.size() == strlen(SEGMENT_PREFIX)) ||
+            (name.find_first_not_of("0123456789", strlen(SEGMENT_PREFIX)) !=
+             std::string::npos))
+        {
+            continue;
+        }
+        numbers.push_back(std::stoull(name.substr(strlen(SEGMENT_PREFIX))));
+    }
+
+    std::sort(numbers.begin(), numbers.end());
+
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        Segment segment{numbers[i], 0};
+        loadSegment(segment, i == numbers.size() - 1);
+        segments.push_back(segment);
+        totalSize += segment.size;
+    }
+
+    if (!blocks.empty())
+    {
+        lastTimestamp = blocks.back().header.last;
+    }
+}
+
+void SegmentStore::loadSegment(Segment& segment, bool truncate)
+{
+    auto path = getPath(segment.number);
+    util::FileDescriptor fd{
+        open(path.c_str(), (truncate ? O_RDWR : O_RDONLY) | O_CLOEXEC)};
+    if (!fd)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to open a segment store file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        return;
+    }
+
+    auto fileSize = lseek(fd(), 0, SEEK_END);
+    size_t offset = 0;
+    std::vector<uint8_t> payload;
+
+    while (offset + sizeof(BlockHeader) <= static_cast<size_t>(fileSize))
+    {
+        BlockHeader header;
+        if (!readAt(fd(), &header, sizeof(header), offset) ||
+            (header.magic != BLOCK_MAGIC) || (header.count == 0) ||
+            (offset + sizeof(header) + header.size >
+             static_cast<size_t>(fileSize)))
+        {
+            break;
+        }
+
+        auto newest = blocks.empty() ? 0 : blocks.back().header.last;
+        if ((header.first <= newest) || (header.last < header.first))
+        {
+            break;
+        }
+
+        payload.resize(header.size);
+        if (!readAt(fd(), payload.data(), payload.size(),
+                    offset + sizeof(header)) ||
+            (crc32(payload.data(), payload.size()) != header.crc))
+        {
+            break;
+        }
+
+        blocks.push_back({segment.number, offset, header});
+        offset += sizeof(header) + header.size;
+    }
+
+    segment.size = offset;
+
+    if (offset != static_cast<size_t>(fileSize))
+    {
+        log<level::ERR>("Dropping an invalid segment store block",
+                        entry("PATH=%s", path.c_str()),
+                        entry("OFFSET=%zu", offset));
+
+        // Most likely a write cut off by a power loss.  Appends
+        // continue after the last good block.
+        if (truncate && (ftruncate(fd(), offset) == -1))
+        {
+            auto e = errno;
+            log<level::ERR>("Failed to truncate a segment store file",
+                            entry("PATH=%s", path.c_str()),
+                            entry("ERRNO=%d", e));
+        }
+    }
+}
+
+bool SegmentStore::append(const Record& record)
+{
+    if (record.timestamp <= lastTimestamp)
+    {
+        return false;
+    }
+
+    pending.push_back(record);
+    lastTimestamp = record.timestamp;
+
+    if (pending.size() >= blockRecords)
+    {
+        flush();
+    }
+
+    return true;
+}
+
+void SegmentStore::flush()
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    auto payload = encode(pending);
+
+    BlockHeader header{};
+    header.magic = BLOCK_MAGIC;
+    header.size = payload.size();
+    header.first = pending.front().timestamp;
+    header.last = pending.back().timestamp;
+    header.count = pending.size();
+    header.crc = crc32(payload.data(), payload.size());
+
+    // The batch is dropped even if the write fails, so a broken flash
+    // can't make it grow without bound.
+    pending.clear();
+
+    auto blockSize = sizeof(header) + payload.size();
+    if (segments.empty() ||
+        ((segments.back().size != 0) &&
+         (segments.back().size + blockSize > segmentSize)))
+    {
+        auto number = segments.empty() ? 0 : segments.back().number + 1;
+        segments.push_back({number, 0});
+    }
+
+    auto& segment = segments.back();
+    auto path = getPath(segment.number);
+
+    std::vector<uint8_t> data(blockSize);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), payload.data(), payload.size());
+
+    util::FileDescriptor fd{
+        open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644)};
+    if (!fd)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to open a segment store file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        return;
+    }
+
+    size_t written = 0;
+    while (written < data.size())
+    {
+        auto rc = pwrite(fd(), data.data() + written, data.size() - written,
+                         segment.size + written);
+        if (rc == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (rc <= 0)
+        {
+            auto e = errno;
+            log<level::ERR>("Failed to write a segment store block",
+                            entry("PATH=%s", path.c_str()),
+                            entry("ERRNO=%d", e));
+
+            // Leave the file ending at the last good block
+            if (ftruncate(fd(), segment.size) == -1)
+            {
+                log<level::ERR>("Failed to truncate a segment store file",
+                                entry("PATH=%s", path.c_str()));
+            }
+            return;
+        }
+        written += rc;
+    }
+
+    if (fdatasync(fd()) == -1)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to sync a segment store file",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+    }
+
+    blocks.push_back({segment.number, segment.size, header});
+    segment.size += blockSize;
+    totalSize += blockSize;
+
+    evict();
+}
+
+void SegmentStore::evict()
+{
+    // The newest segment is kept even if it's too big by itself
+    while ((totalSize > maxSize) && (segments.size() > 1))
+    {
+        auto& oldest = segments.front();
+
+        std::error_code ec;
+        fs::remove(getPath(oldest.number), ec);
+        if (ec)
+        {
+            log<level::ERR>("Failed to remove a segment store file",
+                            entry("PATH=%s",
+                                  getPath(oldest.number).c_str()),
+                            entry("ERROR=%s", ec.message().c_str()));
+        }
+
+        while (!blocks.empty() && (blocks.front().segment == oldest.number))
+        {
+            blocks.pop_front();
+        }
+
+        totalSize -= oldest.size;
+        segments.pop_front();
+    }
+}
+
+std::vector<SegmentStore::Record>
+    SegmentStore::getRecords(uint64_t start, uint64_t end,
+                             size_t maxRecords) const
+{
+    // Collected newest first, and reversed at the end
+    std::vector<Record> records;
+
+    auto collect = [&records, start, end, maxRecords](auto first,
+                                                      auto last) {
+        for (; (first != last) && (records.size() < maxRecords); ++first)
+        {
+            if ((first->timestamp >= start) &&
+                ((end == 0) || (first->timestamp <= end)))
+            {
+                records.push_back(*first);
+            }
+        }
+    };
+
+    // The batched records are newer than any block
+    collect(pending.rbegin(), pending.rend());
+
+    // Past the last block that isn't entirely newer than the range
+    auto last = blocks.end();
+    if (end != 0)
+    {
+        last = std::partition_point(
+            blocks.begin(), blocks.end(),
+            [end](const auto& b) { return b.header.first <= end; });
+    }
+
+    std::vector<Record> blockRecords;
+    for (auto block = std::make_reverse_iterator(last);
+         (block != blocks.rend()) && (records.size() < maxRecords); ++block)
+    {
+        if (block->header.last < start)
+        {
+            break;
+        }
+
+        blockRecords.clear();
+        readBlock(*block, blockRecords);
+        collect(blockRecords.rbegin(), blockRecords.rend());
+    }
+
+    std::reverse(records.begin(), records.end());
+
+    return records;
+}
+
+void SegmentStore::readBlock(const Block& block,
+                             std::vector<Record>& records) const
+{
+    auto path = getPath(block.segment);
+    util::FileDescriptor fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+    std::vector<uint8_t> payload(block.header.size);
+    if (!fd || !readAt(fd(), payload.data(), payload.size(),
+                       block.offset + sizeof(BlockHeader)))
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to read a segment store block",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+        return;
+    }
+
+    try
+    {
+        decode(payload, block.header.count, records);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to decode a segment store block",
+                        entry("PATH=%s", path.c_str()),
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+std::vector<uint8_t> SegmentStore::encode(const std::vector<Record>& records)
+{
+    std::vector<uint8_t> data;
+    data.reserve(records.size() * 8);
+
+    const Record* previous = nullptr;
+    int64_t previousDelta = 0;
+
+    for (const auto& record : records)
+    {
+        if (previous == nullptr)
+        {
+            putVarint(data, record.timestamp);
+            putVarint(data, zigzag(record.average));
+            putVarint(data, zigzag(record.maximum));
+        }
+        else
+        {
+            int64_t delta = record.timestamp - previous->timestamp;
+            putVarint(data, zigzag(delta - previousDelta));
+            putVarint(data, zigzag(record.average - previous->average));
+            putVarint(data, zigzag(record.maximum - previous->maximum));
+            previousDelta = delta;
+        }
+
+        data.push_back(record.id);
+        previous = &record;
+    }
+
+    return data;
+}
+
+void SegmentStore::decode(const std::vector<uint8_t>& data, size_t count,
+                          std::vector<Record>& records)
+{
+    size_t offset = 0;
+    Record record{};
+    int64_t delta = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i == 0)
+        {
+            record.timestamp = getVarint(data, offset);
+            record.average = unzigzag(getVarint(data, offset));
+            record.maximum = unzigzag(getVarint(data, offset));
+        }
+        else
+        {
+            delta += unzigzag(getVarint(data, offset));
+            record.timestamp += delta;
+            record.average += unzigzag(getVarint(data, offset));
+            record.maximum += unzigzag(getVarint(data, offset));
+        }
+
+        record.id = getByte(data, offset);
+        records.push_back(record);
+    }
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
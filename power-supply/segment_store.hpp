@@ -0,0 +1,317 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class SegmentStore
+ *
+ * A compressed, append only archive of input power history records on
+ * flash, to keep weeks of them without holding them in memory.
+ *
+ * Records are batched in memory and written as a block at a time, so
+ * the flash is written once per batch instead of once per record.
+ * Blocks are appended to segment files in a directory, and a new
+ * segment is started when the current one is full.  When the segments
+ * add up to more than the maximum size, the oldest one is deleted.
+ *
+ * Each block has a header with its time range, so an index of the
+ * blocks can be built at startup by reading just the headers, and a
+ * query only has to decode the blocks it overlaps.
+ *
+ * The block layout, little endian:
+ *
+ *   Header, 32 bytes:
+ *     0   uint32  magic, BLOCK_MAGIC
+ *     4   uint32  payload size in bytes
+ *     8   uint64  timestamp of the first record
+ *     16  uint64  timestamp of the last record
+ *     24  uint32  number of records
+ *     28  uint32  CRC-32 of the payload
+ *
+ *   Payload, the records oldest first:
+ *     First record:
+ *       varint          timestamp in milliseconds since the epoch
+ *       zigzag varint   average
+ *       zigzag varint   maximum
+ *       byte            power supply sequence ID
+ *     Each one after it:
+ *       zigzag varint   change in the time since the previous record
+ *       zigzag varint   change in the average
+ *       zigzag varint   change in the maximum
+ *       byte            power supply sequence ID
+ *
+ * Records come every 30 seconds, so the time usually takes one byte.
+ *
+ * A block that was only partly written when power was lost fails its
+ * CRC, and is cut off the end of the last segment at startup.
+ */
+class SegmentStore
+{
+  public:
+    /**
+     * @brief An archived record
+     */
+    struct Record
+    {
+        uint64_t timestamp;
+        int64_t average;
+        int64_t maximum;
+        uint8_t id;
+
+        bool operator==(const Record& other) const
+        {
+            return (timestamp == other.timestamp) &&
+                   (average == other.average) &&
+                   (maximum == other.maximum) && (id == other.id);
+        }
+    };
+
+    static constexpr uint32_t BLOCK_MAGIC = 0x42534850; // 'PHSB'
+
+    /**
+     * @brief The defaults: an hour of records per block, 64KB
+     *        segments, and 1MB in all, which is a few months of
+     *        records at the usual compression.
+     */
+    static constexpr size_t DEFAULT_BLOCK_RECORDS = 120;
+    static constexpr size_t DEFAULT_SEGMENT_SIZE = 64 * 1024;
+    static constexpr size_t DEFAULT_MAX_SIZE = 1024 * 1024;
+
+    SegmentStore() = delete;
+    ~SegmentStore();
+    SegmentStore(const SegmentStore&) = delete;
+    SegmentStore& operator=(const SegmentStore&) = delete;
+    SegmentStore(SegmentStore&&) = delete;
+    SegmentStore& operator=(SegmentStore&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Creates the directory if needed, and indexes the blocks
+     * already in it.
+     *
+     * @param[in] dir - the directory of the segment files
+     * @param[in] maxSize - the most bytes the segments can add up to
+     * @param[in] segmentSize - the size to start a new segment at
+     * @param[in] blockRecords - the number of records in a block
+     */
+    explicit SegmentStore(const std::string& dir,
+                          size_t maxSize = DEFAULT_MAX_SIZE,
+                          size_t segmentSize = DEFAULT_SEGMENT_SIZE,
+                          size_t blockRecords = DEFAULT_BLOCK_RECORDS);
+
+    /**
+     * @brief Adds a record, and writes a block if there are enough.
+     *
+     * @param[in] record - the record, which must be newer than the
+     *                     last one
+     *
+     * @return bool - false if it wasn't newer, so wasn't added
+     */
+    bool append(const Record& record);
+
+    /**
+     * @brief Writes the batched records as a block now
+     */
+    void flush();
+
+    /**
+     * @brief Returns the records within a time range, oldest first,
+     *        including the ones not written yet.
+     *
+     * The blocks are read newest first, and only until there are
+     * maxRecords, so a wide range doesn't decode the whole archive.
+     *
+     * @param[in] start - the oldest timestamp, in milliseconds
+     *                    since the epoch
+     * @param[in] end - the newest timestamp, or 0 for no limit
+     * @param[in] maxRecords - the most records to return, which
+     *                         are the newest ones in the range
+     */
+    std::vector<Record>
+        getRecords(uint64_t start, uint64_t end,
+                   size_t maxRecords = std::numeric_limits<size_t>::max())
+            const;
+
+    /**
+     * @brief Returns the timestamp of the newest record, or 0
+     */
+    inline uint64_t getLastTimestamp() const
+    {
+        return lastTimestamp;
+    }
+
+    /**
+     * @brief Returns the bytes used by the segments
+     */
+    inline size_t getSize() const
+    {
+        return totalSize;
+    }
+
+    /**
+     * @brief Returns the number of segments
+     */
+    inline size_t getNumSegments() const
+    {
+        return segments.size();
+    }
+
+    /**
+     * @brief Returns the number of blocks written
+     */
+    inline size_t getNumBlocks() const
+    {
+        return blocks.size();
+    }
+
+  private:
+    /**
+     * @brief The header of a block in a segment file
+     */
+    struct BlockHeader
+    {
+        uint32_t magic;
+        uint32_t size;
+        uint64_t first;
+        uint64_t last;
+        uint32_t count;
+        uint32_t crc;
+    };
+
+    static_assert(sizeof(BlockHeader) == 32, "Block header layout");
+
+    /**
+     * @brief A segment file
+     */
+    struct Segment
+    {
+        uint64_t number;
+        size_t size;
+    };
+
+    /**
+     * @brief The index entry of a block
+     */
+    struct Block
+    {
+        uint64_t segment;
+        size_t offset;
+        BlockHeader header;
+    };
+
+    /**
+     * @brief Finds the segment files and indexes their blocks
+     */
+    void load();
+
+    /**
+     * @brief Indexes the blocks of a segment file, and sets its size
+     *        to the end of the last good one.
+     *
+     * @param[in,out] segment - the segment
+     * @param[in] truncate - if the file should be cut off after the
+     *                       last good block
+     */
+    void loadSegment(Segment& segment, bool truncate);
+
+    /**
+     * @brief Deletes the oldest segments until the total size fits
+     */
+    void evict();
+
+    /**
+     * @brief Reads the records of a block
+     *
+     * @param[in] block - the block
+     * @param[out] records - the records are added to this
+     */
+    void readBlock(const Block& block, std::vector<Record>& records) const;
+
+    /**
+     * @brief Returns the path of a segment file
+     *
+     * @param[in] number - the segment number
+     */
+    std::filesystem::path getPath(uint64_t number) const;
+
+    /**
+     * @brief Encodes records into a block payload
+     *
+     * @param[in] records - the records, oldest first
+     */
+    static std::vector<uint8_t> encode(const std::vector<Record>& records);
+
+    /**
+     * @brief Decodes a block payload.  Throws std::runtime_error
+     *        if it's invalid.
+     *
+     * @param[in] data - the payload
+     * @param[in] count - the number of records in it
+     * @param[out] records - the records are added to this
+     */
+    static void decode(const std::vector<uint8_t>& data, size_t count,
+                       std::vector<Record>& records);
+
+    /**
+     * @brief The directory of the segment files
+     */
+    std::filesystem::path dir;
+
+    /**
+     * @brief The most bytes the segments can add up to
+     */
+    size_t maxSize;
+
+    /**
+     * @brief The size to start a new segment at
+     */
+    size_t segmentSize;
+
+    /**
+     * @brief The number of records in a block
+     */
+    size_t blockRecords;
+
+    /**
+     * @brief The segments, oldest first
+     */
+    std::deque<Segment> segments;
+
+    /**
+     * @brief The index of the blocks, oldest first
+     */
+    std::deque<Block> blocks;
+
+    /**
+     * @brief The records not written yet
+     */
+    std::vector<Record> pending;
+
+    /**
+     * @brief The bytes used by the segments
+     */
+    size_t totalSize = 0;
+
+    /**
+     * @brief The timestamp of the newest record
+     */
+    uint64_t lastTimestamp = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,163 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sequence_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace std::chrono;
+
+int64_t SequenceClock::tick(int64_t arrival, int64_t numRecords)
+{
+    if (!anchored)
+    {
+        anchor(arrival);
+        return noteNewestTimestamp();
+    }
+
+    periods += numRecords;
+
+    // Much later than expected, so the records can't be trusted
+    // to be a period apart anymore.
+    if (arrival - (offset + periods * period) > nominal)
+    {
+        anchor(arrival);
+        return noteNewestTimestamp();
+    }
+
+    head = (head + 1) % WINDOW_SIZE;
+    window[head] = {periods, arrival};
+    count = std::min(count + 1, WINDOW_SIZE);
+
+    // The period is the slope of the arrival times over the window
+    auto oldest = window[(head + WINDOW_SIZE - count + 1) % WINDOW_SIZE];
+    if (periods - oldest[0] >= MIN_PERIODS)
+    {
+        double meanPeriods = 0;
+        double meanArrival = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            meanPeriods += window[i][0] - periods;
+            meanArrival += window[i][1] - arrival;
+        }
+        meanPeriods /= count;
+        meanArrival /= count;
+
+        double sxx = 0;
+        double sxy = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            auto x = window[i][0] - periods - meanPeriods;
+            sxx += x * x;
+            sxy += x * (window[i][1] - arrival - meanArrival);
+        }
+
+        auto drift = static_cast<double>(nominal) * MAX_DRIFT_PPT / 1000;
+        period = std::clamp(sxy / sxx, nominal - drift, nominal + drift);
+    }
+
+    // A record can't be seen before it was made, so the earliest
+    // one relative to the others is the closest to when it was made.
+    offset = arrival - periods * period;
+    for (size_t i = 0; i < count; i++)
+    {
+        offset = std::min(offset, window[i][1] - window[i][0] * period);
+    }
+
+    return noteNewestTimestamp();
+}
+
+int64_t SequenceClock::noteNewestTimestamp()
+{
+    auto timestamp = getTimestamp(0);
+    newest = std::max(newest, timestamp);
+    return timestamp;
+}
+
+int64_t SequenceClock::getTimestamp(int64_t periodsBack) const
+{
+    return wallOffset + std::llround(offset + (periods - periodsBack) * period);
+}
+
+int64_t SequenceClock::getTimestampAt(int64_t monotonic) const
+{
+    return (anchored ? wallOffset : getWallOffset()) + monotonic;
+}
+
+std::optional<int64_t> SequenceClock::getNextRecordTime() const
+{
+    if (!anchored)
+    {
+        return std::nullopt;
+    }
+
+    return std::llround(offset + (periods + 1) * period);
+}
+
+void SequenceClock::anchor(int64_t arrival)
+{
+    anchored = true;
+    period = nominal;
+    periods = 0;
+    offset = arrival;
+
+    head = 0;
+    count = 1;
+    window[head] = {0, arrival};
+
+    wallOffset = getWallOffset();
+
+    // The system time was set back since the newest record
+    if ((newest != 0) && (arrival + wallOffset <= newest))
+    {
+        if (newest - (arrival + wallOffset) <= MAX_STEP_BACK_PERIODS * nominal)
+        {
+            wallOffset = newest + nominal - arrival;
+        }
+        else
+        {
+            // Too far to continue after it, so the newest one was
+            // likely from a wrong time and the new time is right.
+            newest = 0;
+            timeStepBack = true;
+        }
+    }
+}
+
+int64_t SequenceClock::getWallOffset()
+{
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+               .count() -
+           getMonotonicTime();
+}
+
+int64_t SequenceClock::getMonotonicTime()
+{
+    return duration_cast<milliseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class SequenceClock
+ *
+ * Provides the timestamps of the input power history records based
+ * on their place in the sequence, instead of when they happened to
+ * be read.
+ *
+ * The power supply makes a record every period, so the timestamp of
+ * the record N periods after the first one is the first one's time
+ * plus N periods.  That anchor is estimated from the monotonic times
+ * the records were seen at, using the earliest of the recent ones
+ * relative to where they should be, since a record can only be seen
+ * after it was made.  Once enough records have been seen the period
+ * itself is measured too, as the slope of the recent arrival times,
+ * to correct for the power supply clock drifting from the BMC's.
+ *
+ * The monotonic times are mapped to wall clock time once, when the
+ * clock is anchored, so setting the system time doesn't change the
+ * spacing or order of the records.  If the system time was set back
+ * since the newest record, a new anchor is mapped to a period after
+ * that record instead, so the timestamps never go backwards.  That is
+ * only done for a step back of up to MAX_STEP_BACK_PERIODS, like a
+ * small correction.  A bigger one, like the time having been wrong
+ * before NTP set it, would keep every later timestamp ahead of the
+ * real time, so the new anchor is mapped to the new time and the
+ * caller is told to start over with takeTimeStepBack().
+ */
+class SequenceClock
+{
+  public:
+    /**
+     * @brief The number of recent records used to find the anchor
+     */
+    static constexpr size_t WINDOW_SIZE = 20;
+
+    /**
+     * @brief The number of periods the recent records must span
+     *        before the period is measured instead of assumed.
+     */
+    static constexpr int64_t MIN_PERIODS = 4;
+
+    /**
+     * @brief How far, in parts per thousand, the measured period
+     *        may be from the nominal one.
+     */
+    static constexpr int64_t MAX_DRIFT_PPT = 10;
+
+    /**
+     * @brief How many periods the system time may be set back from
+     *        the newest record and still have new records continue
+     *        after it.
+     */
+    static constexpr int64_t MAX_STEP_BACK_PERIODS = 4;
+
+    SequenceClock() = delete;
+    ~SequenceClock() = default;
+    SequenceClock(const SequenceClock&) = default;
+    SequenceClock& operator=(const SequenceClock&) = default;
+    SequenceClock(SequenceClock&&) = default;
+    SequenceClock& operator=(SequenceClock&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] period - the nominal time between records
+     */
+    explicit SequenceClock(std::chrono::milliseconds period) :
+        nominal(period.count()), period(period.count())
+    {
+    }
+
+    /**
+     * @brief Notes that new records were seen, and returns the
+     *        timestamp of the newest one.
+     *
+     * The first call after a reset() anchors the clock.  If the
+     * records show up much later than they should, such as after
+     * the application was stopped for a while, the clock is
+     * anchored again.
+     *
+     * @param[in] arrival - the monotonic time they were seen, in
+     *                      milliseconds
+     * @param[in] numRecords - the number of new records, each one
+     *                         period after the one before it
+     *
+     * @return int64_t - the newest record's timestamp, in
+     *                   milliseconds since the epoch
+     */
+    int64_t tick(int64_t arrival, int64_t numRecords = 1);
+
+    /**
+     * @brief Returns the timestamp of a record
+     *
+     * @param[in] periodsBack - how many periods before the
+     *                          newest record it is
+     *
+     * @return int64_t - the timestamp, in milliseconds since the epoch
+     */
+    int64_t getTimestamp(int64_t periodsBack) const;
+
+    /**
+     * @brief Returns the timestamp a record seen at a monotonic time
+     *        would have, so other times can line up with the records.
+     *        Before the clock is anchored, it's the system time then.
+     *
+     * @param[in] monotonic - the monotonic time in milliseconds
+     *
+     * @return int64_t - the timestamp, in milliseconds since the epoch
+     */
+    int64_t getTimestampAt(int64_t monotonic) const;
+
+    /**
+     * @brief Returns when the power supply should make its next
+     *        record, if the clock is anchored.
+     *
+     * @return optional<int64_t> - the monotonic time in milliseconds
+     */
+    std::optional<int64_t> getNextRecordTime() const;
+
+    /**
+     * @brief Returns the current period, in milliseconds
+     */
+    inline double getPeriod() const
+    {
+        return period;
+    }
+
+    /**
+     * @brief Starts over, so the next tick() anchors the clock.
+     *
+     * Used when the power supply starts its sequence over,
+     * such as after a SYNC.
+     */
+    inline void reset()
+    {
+        anchored = false;
+    }
+
+    /**
+     * @brief Notes a timestamp that newer records must come after,
+     *        such as the newest one restored from a file.
+     *
+     * @param[in] timestamp - the timestamp, in milliseconds
+     *                        since the epoch
+     */
+    inline void setNewestTimestamp(int64_t timestamp)
+    {
+        newest = std::max(newest, timestamp);
+    }
+
+    /**
+     * @brief Returns if the clock was anchored on a system time set
+     *        back more than MAX_STEP_BACK_PERIODS since the newest
+     *        record, so the records from before then can't be kept
+     *        with the new ones, and clears it.
+     */
+    inline bool takeTimeStepBack()
+    {
+        return std::exchange(timeStepBack, false);
+    }
+
+    /**
+     * @brief Returns the current monotonic time in milliseconds
+     */
+    static int64_t getMonotonicTime();
+
+  private:
+    /**
+     * @brief Anchors the clock on a record
+     *
+     * @param[in] arrival - the monotonic time it was seen
+     */
+    void anchor(int64_t arrival);
+
+    /**
+     * @brief Returns the difference between the wall clock and the
+     *        monotonic clock now, in milliseconds.
+     */
+    static int64_t getWallOffset();
+
+    /**
+     * @brief Returns the newest record's timestamp, after noting it
+     *        as the newest one handed out.
+     */
+    int64_t noteNewestTimestamp();
+
+    /**
+     * @brief The nominal period in milliseconds
+     */
+    const int64_t nominal;
+
+    /**
+     * @brief The current period in milliseconds
+     */
+    double period;
+
+    /**
+     * @brief If the clock is anchored
+     */
+    bool anchored = false;
+
+    /**
+     * @brief The number of periods from the anchor record
+     *        to the newest one.
+     */
+    int64_t periods = 0;
+
+    /**
+     * @brief The estimated monotonic time the anchor record was made
+     */
+    double offset = 0;
+
+    /**
+     * @brief The difference between the wall clock and the
+     *        monotonic clock, from when the clock was anchored.
+     */
+    int64_t wallOffset = 0;
+
+    /**
+     * @brief The newest timestamp handed out or set
+     */
+    int64_t newest = 0;
+
+    /**
+     * @brief If the last anchor was on a time set back too far
+     */
+    bool timeStepBack = false;
+
+    /**
+     * @brief The period numbers and arrival times of the
+     *        most recent records, in a ring buffer.
+     */
+    std::array<std::array<int64_t, 2>, WINDOW_SIZE> window;
+
+    /**
+     * @brief The index in window of the newest sample
+     */
+    size_t head = 0;
+
+    /**
+     * @brief The number of valid samples in window
+     */
+    size_t count = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,130 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+// The ratio between the bounds of each bucket
+static const double gamma =
+    (1 + PercentileSketch::RELATIVE_ACCURACY) /
+    (1 - PercentileSketch::RELATIVE_ACCURACY);
+static const double logGamma = std::log(gamma);
+
+void PercentileSketch::add(int64_t value)
+{
+    if (value < 1)
+    {
+        zeroCount++;
+    }
+    else
+    {
+        buckets[getBucket(value)]++;
+    }
+
+    if ((count == 0) || (value > maximum))
+    {
+        maximum = value;
+    }
+
+    count++;
+}
+
+void PercentileSketch::merge(const PercentileSketch& sketch)
+{
+    if (sketch.count == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < NUM_BUCKETS; i++)
+    {
+        buckets[i] += sketch.buckets[i];
+    }
+
+    if ((count == 0) || (sketch.maximum > maximum))
+    {
+        maximum = sketch.maximum;
+    }
+
+    zeroCount += sketch.zeroCount;
+    count += sketch.count;
+}
+
+int64_t PercentileSketch::getPercentile(double percentile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // The number of values below the one to find
+    auto rank = static_cast<uint64_t>(
+        std::clamp(percentile, 0.0, 100.0) / 100.0 * (count - 1));
+
+    if (rank < zeroCount)
+    {
+        return 0;
+    }
+
+    if (rank == count - 1)
+    {
+        return maximum;
+    }
+
+    uint64_t seen = zeroCount;
+    for (size_t i = 0; i < NUM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+        {
+            return std::min(getBucketValue(i), maximum);
+        }
+    }
+
+    return maximum;
+}
+
+void PercentileSketch::clear()
+{
+    buckets.fill(0);
+    zeroCount = 0;
+    count = 0;
+    maximum = 0;
+}
+
+size_t PercentileSketch::getBucket(int64_t value)
+{
+    auto bucket = static_cast<size_t>(std::ceil(std::log(value) / logGamma));
+    return std::min(bucket, NUM_BUCKETS - 1);
+}
+
+int64_t PercentileSketch::getBucketValue(size_t bucket)
+{
+    // The middle of the bucket, in terms of relative error
+    return std::llround(2 * std::pow(gamma, bucket) / (gamma + 1));
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class PercentileSketch
+ *
+ * A fixed size sketch of the distribution of power values, used to
+ * find percentiles without keeping the values themselves.
+ *
+ * It works like DDSketch: values go into logarithmically sized
+ * buckets, so any percentile it returns is within RELATIVE_ACCURACY
+ * of the actual value.  Sketches can be merged by adding up their
+ * buckets, such as to combine periods or power supplies.
+ */
+class PercentileSketch
+{
+  public:
+    /**
+     * @brief The most a returned percentile can be off by,
+     *        as a fraction of the actual value.
+     */
+    static constexpr double RELATIVE_ACCURACY = 0.02;
+
+    /**
+     * @brief The number of buckets, enough for values up to
+     *        65535 watts at RELATIVE_ACCURACY.  Larger values
+     *        go in the last bucket.
+     */
+    static constexpr size_t NUM_BUCKETS = 280;
+
+    PercentileSketch() = default;
+    ~PercentileSketch() = default;
+    PercentileSketch(const PercentileSketch&) = default;
+    PercentileSketch& operator=(const PercentileSketch&) = default;
+    PercentileSketch(PercentileSketch&&) = default;
+    PercentileSketch& operator=(PercentileSketch&&) = default;
+
+    /**
+     * @brief Adds a value
+     *
+     * @param[in] value - the value, in watts.  Anything under
+     *                    1 counts as 0.
+     */
+    void add(int64_t value);
+
+    /**
+     * @brief Adds the values from another sketch into this one
+     *
+     * @param[in] sketch - the sketch to merge in
+     */
+    void merge(const PercentileSketch& sketch);
+
+    /**
+     * @brief Returns the value at a percentile
+     *
+     * @param[in] percentile - the percentile, from 0 to 100
+     *
+     * @return int64_t - the value, or 0 if the sketch is empty
+     */
+    int64_t getPercentile(double percentile) const;
+
+    /**
+     * @brief Returns the largest value added
+     */
+    inline int64_t getMaximum() const
+    {
+        return maximum;
+    }
+
+    /**
+     * @brief Returns the number of values added
+     */
+    inline uint64_t getCount() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Removes all values
+     */
+    void clear();
+
+  private:
+    /**
+     * @brief Returns the bucket for a value of at least 1
+     *
+     * @param[in] value - the value
+     *
+     * @return size_t - the bucket index
+     */
+    static size_t getBucket(int64_t value);
+
+    /**
+     * @brief Returns the value that represents a bucket
+     *
+     * @param[in] bucket - the bucket index
+     *
+     * @return int64_t - the value
+     */
+    static int64_t getBucketValue(size_t bucket);
+
+    /**
+     * @brief The number of values in each bucket
+     */
+    std::array<uint32_t, NUM_BUCKETS> buckets{};
+
+    /**
+     * @brief The number of values under 1
+     */
+    uint64_t zeroCount = 0;
+
+    /**
+     * @brief The total number of values
+     */
+    uint64_t count = 0;
+
+    /**
+     * @brief The largest value added
+     */
+    int64_t maximum = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,207 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "system_history.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace std::chrono;
+
+// Records with the same ID closer together than this are the same record
+static const int64_t window =
+    duration_cast<milliseconds>(RecordManager::RECORD_INTERVAL).count() / 2;
+
+SystemHistory::SystemHistory(size_t numPowerSupplies, size_t maxRecords) :
+    allPowerSupplies((numPowerSupplies >= MAX_POWER_SUPPLIES)
+                         ? UINT32_MAX
+                         : (1u << numPowerSupplies) - 1),
+    rollups(RecordManager::createRollups()), storage(maxRecords)
+{
+}
+
+bool SystemHistory::add(size_t powerSupply,
+                        const RecordManager::DBusCombinedRecordList& records)
+{
+    if ((powerSupply >= MAX_POWER_SUPPLIES) ||
+        !(allPowerSupplies & (1u << powerSupply)))
+    {
+        return false;
+    }
+
+    // Oldest first
+    for (auto r = records.rbegin(); r != records.rend(); ++r)
+    {
+        add(powerSupply, *r);
+    }
+
+    return completeRecords();
+}
+
+void SystemHistory::add(size_t powerSupply,
+                        const RecordManager::DBusCombinedRecord& record)
+{
+    auto timestamp = static_cast<int64_t>(std::get<0>(record));
+    auto id = std::get<3>(record);
+    auto bit = 1u << powerSupply;
+
+    // Either already in a completed system record, or too late for it
+    if ((completedTime != 0) && (timestamp < completedTime + window))
+    {
+        return;
+    }
+
+    newestTime = std::max(newestTime, timestamp);
+
+    auto p = std::find_if(
+        pending.begin(), pending.end(), [id, timestamp](const auto& p) {
+            return (p.id == id) &&
+                   (std::abs(p.record.timestamp - timestamp) < window);
+        });
+
+    if (p == pending.end())
+    {
+        auto pos = std::find_if(
+            pending.begin(), pending.end(), [timestamp](const auto& p) {
+                return p.record.timestamp > timestamp;
+            });
+
+        p = pending.insert(pos, Pending{id, Record{timestamp, 0, 0, 0}});
+    }
+
+    if (p->record.powerSupplies & bit)
+    {
+        return;
+    }
+
+    p->record.timestamp = std::min(p->record.timestamp, timestamp);
+    p->record.average += std::get<1>(record);
+    p->record.maximum += std::get<2>(record);
+    p->record.powerSupplies |= bit;
+}
+
+bool SystemHistory::completeRecords()
+{
+    auto expired = newestTime - duration_cast<milliseconds>(MAX_LAG).count();
+    size_t completed = 0;
+
+    for (const auto& p : pending)
+    {
+        if ((p.record.powerSupplies != allPowerSupplies) &&
+            (p.record.timestamp > expired))
+        {
+            break;
+        }
+
+        store(p.record);
+        completedTime = p.record.timestamp;
+        completed++;
+    }
+
+    pending.erase(pending.begin(), pending.begin() + completed);
+
+    return completed != 0;
+}
+
+void SystemHistory::store(const Record& record)
+{
+    rollup(record);
+
+    if (storage.empty())
+    {
+        return;
+    }
+
+    head = (head + 1) % storage.size();
+    storage[head] = record;
+
+    if (count < storage.size())
+    {
+        count++;
+    }
+}
+
+void SystemHistory::rollup(const Record& record)
+{
+    // Each level passes up at most one completed period
+    std::optional<Rollup::Summary> summary{
+        Rollup::Summary{record.timestamp, record.average, 1, record.maximum,
+                        record.average, 0, 0, 0}};
+
+    const PercentileSketch* sketch = nullptr;
+
+    for (auto& level : rollups)
+    {
+        summary = level.add(*summary, sketch);
+        if (!summary)
+        {
+            break;
+        }
+
+        sketch = &level.getCompletedSketch();
+    }
+}
+
+auto SystemHistory::getAverageRecords() const -> DBusRecordList
+{
+    DBusRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        list.emplace_back(at(i).timestamp, at(i).average);
+    }
+
+    return list;
+}
+
+auto SystemHistory::getMaximumRecords() const -> DBusRecordList
+{
+    DBusRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        list.emplace_back(at(i).timestamp, at(i).maximum);
+    }
+
+    return list;
+}
+
+auto SystemHistory::getTotalRecords() const -> DBusTotalRecordList
+{
+    DBusTotalRecordList list;
+    list.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto& r = at(i);
+        list.emplace_back(r.timestamp, r.average, r.maximum, r.powerSupplies);
+    }
+
+    return list;
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "record_manager.hpp"
+#include "rollup.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class SystemHistory
+ *
+ * Combines the input power history records of all of the power
+ * supplies into system total records.
+ *
+ * The power supplies start their sequence IDs over together on a
+ * SYNC, so records are lined up by sequence ID instead of by their
+ * timestamps, which depend on when each one was read.  The timestamps
+ * are only used to tell apart records with the same ID from before
+ * and after an ID rollover or SYNC.
+ *
+ * A system record is complete once every power supply has provided
+ * its record, or once MAX_LAG has passed since then, in which case
+ * it only includes the ones that did.  Each system record says which
+ * power supplies it includes.
+ *
+ * The completed system records are also added to the same rollup
+ * levels the power supplies have, so there are system percentiles.
+ */
+class SystemHistory
+{
+  public:
+    /**
+     * @brief The most power supplies supported
+     */
+    static constexpr size_t MAX_POWER_SUPPLIES = 32;
+
+    /**
+     * @brief How long to wait for a power supply's record
+     *        before completing a system record without it.
+     */
+    static constexpr auto MAX_LAG = std::chrono::seconds{60};
+
+    /**
+     * @brief A system total record
+     */
+    struct Record
+    {
+        /**
+         * @brief The earliest timestamp of the power supply records,
+         *        in milliseconds since the epoch
+         */
+        int64_t timestamp;
+
+        /**
+         * @brief The sum of the power supply averages
+         */
+        int64_t average;
+
+        /**
+         * @brief The sum of the power supply maximums, which is the
+         *        most the system could have drawn
+         */
+        int64_t maximum;
+
+        /**
+         * @brief A bit for each power supply included
+         */
+        uint32_t powerSupplies;
+    };
+
+    using DBusRecord = std::tuple<uint64_t, int64_t>;
+    using DBusRecordList = std::vector<DBusRecord>;
+
+    // Timestamp, average, maximum, power supplies included
+    using DBusTotalRecord = std::tuple<uint64_t, int64_t, int64_t, uint32_t>;
+    using DBusTotalRecordList = std::vector<DBusTotalRecord>;
+
+    SystemHistory() = delete;
+    ~SystemHistory() = default;
+    SystemHistory(const SystemHistory&) = default;
+    SystemHistory& operator=(const SystemHistory&) = default;
+    SystemHistory(SystemHistory&&) = default;
+    SystemHistory& operator=(SystemHistory&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] numPowerSupplies - the number of power supplies,
+     *                               up to MAX_POWER_SUPPLIES
+     * @param[in] maxRecords - the number of system records to keep
+     */
+    SystemHistory(size_t numPowerSupplies, size_t maxRecords);
+
+    /**
+     * @brief Adds the records from a power supply
+     *
+     * Records that are already in a system record are ignored, so
+     * the same records can be passed in again, such as after the
+     * power supply history was rebuilt.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] records - the records, newest first, as provided
+     *                      by the Incremental interface
+     *
+     * @return bool - if any system records were completed
+     */
+    bool add(size_t powerSupply,
+             const RecordManager::DBusCombinedRecordList& records);
+
+    /**
+     * @brief Returns the number of system records
+     */
+    inline size_t getNumRecords() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Returns a system record
+     *
+     * @param[in] index - 0 is the newest
+     */
+    inline const Record& at(size_t index) const
+    {
+        return storage[(head + storage.size() - index) % storage.size()];
+    }
+
+    /**
+     * @brief Returns the rollup levels, from the shortest
+     *        period to the longest.
+     */
+    inline const std::vector<Rollup>& getRollups() const
+    {
+        return rollups;
+    }
+
+    /**
+     * @brief Returns the system averages, newest first, in the
+     *        format used by the D-Bus Average interface.
+     */
+    DBusRecordList getAverageRecords() const;
+
+    /**
+     * @brief Returns the system maximums, newest first, in the
+     *        format used by the D-Bus Maximum interface.
+     */
+    DBusRecordList getMaximumRecords() const;
+
+    /**
+     * @brief Returns the system records, newest first, in the
+     *        format used by the D-Bus Total interface.
+     */
+    DBusTotalRecordList getTotalRecords() const;
+
+  private:
+    /**
+     * @brief A system record still waiting on power supplies
+     */
+    struct Pending
+    {
+        uint8_t id;
+        Record record;
+    };
+
+    /**
+     * @brief Adds one power supply record to its pending
+     *        system record, creating it if necessary.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] record - the power supply record
+     */
+    void add(size_t powerSupply,
+             const RecordManager::DBusCombinedRecord& record);
+
+    /**
+     * @brief Completes the oldest pending records that either have
+     *        all power supplies or have waited MAX_LAG.
+     *
+     * They are completed in timestamp order, so a complete record
+     * waits for any older ones.
+     *
+     * @return bool - if any were completed
+     */
+    bool completeRecords();
+
+    /**
+     * @brief Stores a completed system record, and adds it
+     *        to the rollups.
+     *
+     * @param[in] record - the record
+     */
+    void store(const Record& record);
+
+    /**
+     * @brief Adds a completed system record to the rollups, passing
+     *        any completed periods up through the levels.
+     *
+     * @param[in] record - the record
+     */
+    void rollup(const Record& record);
+
+    /**
+     * @brief The bits for all of the power supplies
+     */
+    const uint32_t allPowerSupplies;
+
+    /**
+     * @brief The system records waiting on power supplies,
+     *        oldest first.
+     */
+    std::vector<Pending> pending;
+
+    /**
+     * @brief The newest power supply record timestamp seen
+     */
+    int64_t newestTime = 0;
+
+    /**
+     * @brief The timestamp of the newest completed system record
+     */
+    int64_t completedTime = 0;
+
+    /**
+     * @brief The rollup levels, each fed by the one before it
+     */
+    std::vector<Rollup> rollups;
+
+    /**
+     * @brief The ring buffer of completed system records
+     */
+    std::vector<Record> storage;
+
+    /**
+     * @brief The index in storage of the newest record
+     */
+    size_t head = 0;
+
+    /**
+     * @brief The number of valid records in storage
+     */
+    size_t count = 0;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
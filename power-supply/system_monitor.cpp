@@ -0,0 +1,389 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "system_monitor.hpp"
+
+#include "incremental.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <phosphor-logging/log.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+using namespace phosphor::logging;
+
+SystemMonitor::SystemMonitor(sdbusplus::bus::bus& bus,
+                             const std::string& objectPath,
+                             const std::vector<std::string>& powerSupplyPaths,
+                             size_t maxRecords) :
+    bus(bus),
+    history(powerSupplyPaths.size(), maxRecords),
+    average(bus, objectPath + '/' + Average::name),
+    maximum(bus, objectPath + '/' + Maximum::name),
+    total(bus, objectPath + '/' + Total::name),
+    positions(powerSupplyPaths.size())
+{
+    using namespace sdbusplus::bus::match;
+
+    // The rollup levels go next to the per_30s one, like
+    // <root>/per_5m/system_input_power/percentile
+    std::filesystem::path path{objectPath};
+    auto root = path.parent_path().parent_path();
+
+    for (const auto& level : history.getRollups())
+    {
+        auto levelPath = root / level.getName() / path.filename();
+
+        RollupObjects objects;
+        objects.average =
+            std::make_unique<Average>(bus, levelPath / Average::name);
+        objects.maximum =
+            std::make_unique<Maximum>(bus, levelPath / Maximum::name);
+        objects.minimum =
+            std::make_unique<Minimum>(bus, levelPath / Minimum::name);
+        objects.percentile =
+            std::make_unique<Percentile>(bus, levelPath / Percentile::name);
+
+        rollupObjects.push_back(std::move(objects));
+    }
+
+    for (size_t i = 0; i < powerSupplyPaths.size(); i++)
+    {
+        positions[i].path = powerSupplyPaths[i];
+
+        matches.emplace_back(std::make_unique<match_t>(
+            bus,
+            rules::type::signal() + rules::member("RecordsAdded") +
+                rules::path(powerSupplyPaths[i]) +
+                rules::interface(Incremental::interface),
+            [this, i](auto& msg) { this->recordsAdded(i, msg); }));
+    }
+}
+
+void SystemMonitor::recordsAdded(size_t powerSupply,
+                                 sdbusplus::message::message& msg)
+{
+    uint64_t epoch = 0;
+    uint64_t sequence = 0;
+    RecordManager::DBusCombinedRecordList records;
+
+    try
+    {
+        msg.read(epoch, sequence, records);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to read RecordsAdded signal",
+                        entry("PS=%d", powerSupply),
+                        entry("ERROR=%s", e.what()));
+        return;
+    }
+
+    auto& position = positions[powerSupply];
+
+    // The reply will have these, and nothing from before them
+    // should be added after them.
+    if (position.fetching)
+    {
+        return;
+    }
+
+    // The records are the ones after this sequence number
+    auto first = sequence - std::min<uint64_t>(sequence, records.size());
+
+    auto continues = (position.known && (epoch == position.epoch))
+                         ? (first <= position.sequence)
+                         : (first == 0);
+
+    if (!continues)
+    {
+        fetchRecords(powerSupply, msg.get_sender());
+        return;
+    }
+
+    addRecords(powerSupply, epoch, sequence, records);
+}
+
+void SystemMonitor::fetchRecords(size_t powerSupply,
+                                 const std::string& service)
+{
+    auto& position = positions[powerSupply];
+
+    auto method =
+        bus.new_method_call(service.c_str(), position.path.c_str(),
+                            Incremental::interface, "GetRecordsSince");
+    method.append(position.epoch, position.sequence);
+
+    // Asynchronous, since the history may be in this same process
+    position.fetch = std::make_unique<util::AsyncCall>(
+        bus, method, [this, powerSupply](auto& reply) {
+            this->recordsFetched(powerSupply, reply);
+        });
+
+    position.fetching = true;
+}
+
+void SystemMonitor::recordsFetched(size_t powerSupply,
+                                   sdbusplus::message::message& reply)
+{
+    positions[powerSupply].fetching = false;
+
+    uint64_t epoch = 0;
+    uint64_t sequence = 0;
+    RecordManager::DBusCombinedRecordList records;
+
+    // The next signal will try again
+    if (reply.is_method_error())
+    {
+        log<level::ERR>("Failed to get the power supply history records",
+                        entry("PS=%d", powerSupply));
+        return;
+    }
+
+    try
+    {
+        reply.read(epoch, sequence, records);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to read GetRecordsSince reply",
+                        entry("PS=%d", powerSupply),
+                        entry("ERROR=%s", e.what()));
+        return;
+    }
+
+    addRecords(powerSupply, epoch, sequence, records);
+}
+
+void SystemMonitor::addRecords(
+    size_t powerSupply, uint64_t epoch, uint64_t sequence,
+    const RecordManager::DBusCombinedRecordList& records)
+{
+    auto& position = positions[powerSupply];
+    position.epoch = epoch;
+    position.sequence = sequence;
+    position.known = true;
+
+    if (history.add(powerSupply, records))
+    {
+        average.values(history.getAverageRecords());
+        maximum.values(history.getMaximumRecords());
+        total.values(history.getTotalRecords());
+        updateRollups();
+    }
+}
+
+void SystemMonitor::updateRollups()
+{
+    const auto& rollups = history.getRollups();
+
+    for (size_t i = 0; i < rollupObjects.size(); i++)
+    {
+        auto& objects = rollupObjects[i];
+        if (rollups[i].getSequence() == objects.sequence)
+        {
+            continue;
+        }
+
+        objects.average->values(rollups[i].getAverageRecords());
+        objects.maximum->values(rollups[i].getMaximumRecords());
+        objects.minimum->values(rollups[i].getMinimumRecords());
+        objects.percentile->values(rollups[i].getPercentileRecords());
+
+        objects.sequence = rollups[i].getSequence();
+    }
+}
+
+void SystemMonitor::enableEnergy(
+    const std::string& objectPath,
+    const std::vector<std::string>& powerSupplyPaths)
+{
+    using namespace sdbusplus::bus::match;
+
+    energies.resize(powerSupplyPaths.size());
+    energy = std::make_unique<Energy>(bus, objectPath);
+    energy->source(Energy::Source::Total);
+
+    for (size_t i = 0; i < powerSupplyPaths.size(); i++)
+    {
+        auto& ps = energies[i];
+        ps.path = powerSupplyPaths[i];
+
+        energyMatches.emplace_back(std::make_unique<match_t>(
+            bus, rules::propertiesChanged(ps.path, Energy::interface),
+            [this, i](auto& msg) { this->energyChanged(i, msg); }));
+
+        // The signals only have the properties that changed, so
+        // start from all of them.  Asynchronous, since the energy
+        // may be in this same process.
+        auto method = util::newGetServiceCall(ps.path, Energy::interface, bus);
+
+        ps.serviceCall = std::make_unique<util::AsyncCall>(
+            bus, method, [this, i](auto& reply) {
+                std::string service;
+                if (!reply.is_method_error())
+                {
+                    service = util::readGetServiceReply(reply);
+                }
+
+                // Otherwise it's read on its first signal
+                const auto& ps = energies[i];
+                if (!service.empty() && !ps.known && !ps.reading)
+                {
+                    this->readEnergy(i, service);
+                }
+            });
+    }
+}
+
+void SystemMonitor::energyChanged(size_t powerSupply,
+                                  sdbusplus::message::message& msg)
+{
+    std::string interface;
+    EnergyProperties properties;
+
+    try
+    {
+        msg.read(interface, properties);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to read energy PropertiesChanged signal",
+                        entry("PS=%d", powerSupply),
+                        entry("ERROR=%s", e.what()));
+        return;
+    }
+
+    setEnergy(powerSupply, properties);
+
+    auto& ps = energies[powerSupply];
+    if (!ps.known && !ps.reading)
+    {
+        readEnergy(powerSupply, msg.get_sender());
+    }
+}
+
+void SystemMonitor::readEnergy(size_t powerSupply, const std::string& service)
+{
+    auto& ps = energies[powerSupply];
+
+    auto method = bus.new_method_call(service.c_str(), ps.path.c_str(),
+                                      util::PROPERTY_INTF, "GetAll");
+    method.append(Energy::interface);
+
+    ps.read = std::make_unique<util::AsyncCall>(
+        bus, method, [this, powerSupply](auto& reply) {
+            this->energyRead(powerSupply, reply);
+        });
+
+    ps.reading = true;
+}
+
+void SystemMonitor::energyRead(size_t powerSupply,
+                               sdbusplus::message::message& reply)
+{
+    energies[powerSupply].reading = false;
+
+    // The next signal will try again
+    if (reply.is_method_error())
+    {
+        log<level::ERR>("Failed to get the power supply energy",
+                        entry("PS=%d", powerSupply));
+        return;
+    }
+
+    EnergyProperties properties;
+
+    try
+    {
+        reply.read(properties);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to read energy GetAll reply",
+                        entry("PS=%d", powerSupply),
+                        entry("ERROR=%s", e.what()));
+        return;
+    }
+
+    // Any signals before the reply are already included in it
+    setEnergy(powerSupply, properties);
+    energies[powerSupply].known = true;
+}
+
+void SystemMonitor::setEnergy(size_t powerSupply,
+                              const EnergyProperties& properties)
+{
+    using sdbusplus::message::variant_ns::get;
+
+    auto& ps = energies[powerSupply];
+
+    try
+    {
+        auto property = properties.find("Value");
+        if (property != properties.end())
+        {
+            ps.value = get<double>(property->second);
+        }
+
+        property = properties.find("Start");
+        if (property != properties.end())
+        {
+            ps.start = get<uint64_t>(property->second);
+        }
+
+        property = properties.find("Unmeasured");
+        if (property != properties.end())
+        {
+            ps.unmeasured = get<uint64_t>(property->second);
+        }
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to get the energy properties",
+                        entry("PS=%d", powerSupply),
+                        entry("ERROR=%s", e.what()));
+        return;
+    }
+
+    double value = 0;
+    uint64_t start = 0;
+    uint64_t unmeasured = 0;
+
+    for (const auto& e : energies)
+    {
+        value += e.value;
+        unmeasured += e.unmeasured;
+        if ((e.start != 0) && ((start == 0) || (e.start < start)))
+        {
+            start = e.start;
+        }
+    }
+
+    energy->value(value);
+    energy->start(start);
+    energy->unmeasured(unmeasured);
+}
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "average.hpp"
+#include "energy.hpp"
+#include "maximum.hpp"
+#include "minimum.hpp"
+#include "percentile.hpp"
+#include "system_history.hpp"
+#include "total.hpp"
+#include "utility.hpp"
+
+#include <map>
+#include <memory>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/bus/match.hpp>
+#include <string>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+/**
+ * @class SystemMonitor
+ *
+ * Provides the system total input power history on D-Bus, built from
+ * the RecordsAdded signals of every power supply's Incremental
+ * history object.
+ *
+ * The epoch and sequence number of the last records from each power
+ * supply are kept, and if a signal doesn't continue from them, such as
+ * after a missed signal, at startup, or when the epoch changes but the
+ * signal doesn't start the new epoch from the beginning, the missing
+ * records are fetched with GetRecordsSince instead.
+ *
+ * The totals are in average, maximum, and total objects under the
+ * object path, like the power supply histories, and the rollups of
+ * them, including their percentiles, go next to it in the rollup
+ * level paths.
+ */
+class SystemMonitor
+{
+  public:
+    static constexpr auto name = "system_input_power";
+
+    SystemMonitor() = delete;
+    ~SystemMonitor() = default;
+    SystemMonitor(const SystemMonitor&) = delete;
+    SystemMonitor& operator=(const SystemMonitor&) = delete;
+    SystemMonitor(SystemMonitor&&) = delete;
+    SystemMonitor& operator=(SystemMonitor&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path for the totals
+     * @param[in] powerSupplyPaths - the history object paths of the
+     *                               power supplies, in order
+     * @param[in] maxRecords - the number of total records to keep
+     */
+    SystemMonitor(sdbusplus::bus::bus& bus, const std::string& objectPath,
+                  const std::vector<std::string>& powerSupplyPaths,
+                  size_t maxRecords);
+
+    /**
+     * @brief Enables providing the system total input energy, the
+     *        sum of the power supply energies.
+     *
+     * Each power supply's properties are read when this is called,
+     * and kept up to date from its PropertiesChanged signals.  If
+     * it isn't on D-Bus yet, they are read on its first signal.
+     *
+     * @param[in] objectPath - the D-Bus object path for the total
+     * @param[in] powerSupplyPaths - the energy object paths of the
+     *                               power supplies, in order
+     */
+    void enableEnergy(const std::string& objectPath,
+                      const std::vector<std::string>& powerSupplyPaths);
+
+  private:
+    /**
+     * @brief The last energy properties of a power supply
+     */
+    struct PowerSupplyEnergy
+    {
+        double value = 0;
+        uint64_t start = 0;
+        uint64_t unmeasured = 0;
+
+        /**
+         * @brief The energy object path
+         */
+        std::string path;
+
+        /**
+         * @brief If the properties were read with GetAll
+         */
+        bool known = false;
+
+        /**
+         * @brief If a GetAll call is outstanding
+         */
+        bool reading = false;
+
+        /**
+         * @brief The mapper GetObject call for the service
+         */
+        std::unique_ptr<util::AsyncCall> serviceCall;
+
+        /**
+         * @brief The last GetAll call
+         */
+        std::unique_ptr<util::AsyncCall> read;
+    };
+
+    /**
+     * @brief The energy properties, by name
+     */
+    using EnergyValue =
+        sdbusplus::message::variant<double, uint64_t, std::string>;
+    using EnergyProperties = std::map<std::string, EnergyValue>;
+
+    /**
+     * @brief Where the system history is in a power supply's
+     *        incremental history.
+     */
+    struct PowerSupplyPosition
+    {
+        /**
+         * @brief The history object path
+         */
+        std::string path;
+
+        /**
+         * @brief The epoch of the last records added
+         */
+        uint64_t epoch = 0;
+
+        /**
+         * @brief The sequence number of the last records added
+         */
+        uint64_t sequence = 0;
+
+        /**
+         * @brief If any records were added yet
+         */
+        bool known = false;
+
+        /**
+         * @brief If a GetRecordsSince call is outstanding, in which
+         *        case its reply includes any signals until then.
+         */
+        bool fetching = false;
+
+        /**
+         * @brief The last GetRecordsSince call
+         */
+        std::unique_ptr<util::AsyncCall> fetch;
+    };
+
+    /**
+     * @brief Callback for a power supply's energy PropertiesChanged
+     *        signal
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] msg - the signal message
+     */
+    void energyChanged(size_t powerSupply, sdbusplus::message::message& msg);
+
+    /**
+     * @brief Reads all of a power supply's energy properties
+     *        asynchronously.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] service - the D-Bus service with the energy object
+     */
+    void readEnergy(size_t powerSupply, const std::string& service);
+
+    /**
+     * @brief Callback for the reply to readEnergy()'s GetAll call
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] reply - the reply
+     */
+    void energyRead(size_t powerSupply, sdbusplus::message::message& reply);
+
+    /**
+     * @brief Sets a power supply's energy properties, and updates
+     *        the total from them.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] properties - the properties that were read
+     */
+    void setEnergy(size_t powerSupply, const EnergyProperties& properties);
+
+    /**
+     * @brief Callback for a power supply's RecordsAdded signal
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] msg - the signal message
+     */
+    void recordsAdded(size_t powerSupply, sdbusplus::message::message& msg);
+
+    /**
+     * @brief Calls GetRecordsSince on a power supply's history, for
+     *        the records after the last ones added.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] service - the D-Bus service of the history
+     */
+    void fetchRecords(size_t powerSupply, const std::string& service);
+
+    /**
+     * @brief Callback for the reply to GetRecordsSince
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] reply - the reply message
+     */
+    void recordsFetched(size_t powerSupply,
+                        sdbusplus::message::message& reply);
+
+    /**
+     * @brief Adds the records of a power supply to the system history,
+     *        and updates the D-Bus objects if any system records were
+     *        completed.
+     *
+     * @param[in] powerSupply - the power supply index
+     * @param[in] epoch - the epoch of the records
+     * @param[in] sequence - the sequence number of the newest record
+     * @param[in] records - the records, newest first
+     */
+    void addRecords(size_t powerSupply, uint64_t epoch, uint64_t sequence,
+                    const RecordManager::DBusCombinedRecordList& records);
+
+    /**
+     * @brief The D-Bus objects for a rollup level of the totals
+     */
+    struct RollupObjects
+    {
+        std::unique_ptr<Average> average;
+        std::unique_ptr<Maximum> maximum;
+        std::unique_ptr<Minimum> minimum;
+        std::unique_ptr<Percentile> percentile;
+
+        /**
+         * @brief The rollup sequence number when they were last updated
+         */
+        uint64_t sequence = 0;
+    };
+
+    /**
+     * @brief Updates the arrays in D-Bus of the rollup levels that
+     *        completed a period since the last time.
+     */
+    void updateRollups();
+
+    /**
+     * @brief The D-Bus object
+     */
+    sdbusplus::bus::bus& bus;
+
+    /**
+     * @brief Combines the power supply records
+     */
+    SystemHistory history;
+
+    /**
+     * @brief The D-Bus object for the total average input power
+     */
+    Average average;
+
+    /**
+     * @brief The D-Bus object for the total maximum input power
+     */
+    Maximum maximum;
+
+    /**
+     * @brief The D-Bus object for the totals along with the
+     *        power supplies they include
+     */
+    Total total;
+
+    /**
+     * @brief The D-Bus objects for each rollup level, in the same
+     *        order as SystemHistory::getRollups().
+     */
+    std::vector<RollupObjects> rollupObjects;
+
+    /**
+     * @brief Where the system history is in each power
+     *        supply's history
+     */
+    std::vector<PowerSupplyPosition> positions;
+
+    /**
+     * @brief The matches for the RecordsAdded signals
+     */
+    std::vector<std::unique_ptr<sdbusplus::bus::match_t>> matches;
+
+    /**
+     * @brief The energy of each power supply
+     */
+    std::vector<PowerSupplyEnergy> energies;
+
+    /**
+     * @brief The D-Bus object for the total input energy, if enabled
+     */
+    std::unique_ptr<Energy> energy;
+
+    /**
+     * @brief The matches for the energy PropertiesChanged signals
+     */
+    std::vector<std::unique_ptr<sdbusplus::bus::match_t>> energyMatches;
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,159 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "telemetry_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <phosphor-logging/elog-errors.hpp>
+#include <phosphor-logging/elog.hpp>
+#include <phosphor-logging/log.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+
+using InternalFailure =
+    sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+TelemetryRing::TelemetryRing(const std::string& name, size_t numSlots)
+{
+    size_t slotCount = 1;
+    while (slotCount < numSlots)
+    {
+        slotCount <<= 1;
+    }
+
+    size = getFileSize(slotCount);
+
+    fd.set(memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to create telemetry memfd",
+                        entry("NAME=%s", name.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    // Consumers map it, so it must never shrink under them
+    if ((ftruncate(fd(), size) == -1) ||
+        (fcntl(fd(), F_ADD_SEALS,
+               F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1))
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to size telemetry memfd",
+                        entry("NAME=%s", name.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    auto mapping =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd(), 0);
+    if (mapping == MAP_FAILED)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed to map telemetry memfd",
+                        entry("NAME=%s", name.c_str()), entry("ERRNO=%d", e));
+        elog<InternalFailure>();
+    }
+
+    // The file starts out zeroed, so only the fixed fields need setting
+    header = static_cast<Header*>(mapping);
+    header->magic = TELEMETRY_MAGIC;
+    header->version = TELEMETRY_VERSION;
+    header->sampleSize = sizeof(Sample);
+    header->numSlots = slotCount;
+    header->slotOffset = sizeof(Header);
+
+    slots = reinterpret_cast<Sample*>(header + 1);
+}
+
+TelemetryRing::~TelemetryRing()
+{
+    if (header)
+    {
+        munmap(header, size);
+    }
+}
+
+size_t TelemetryRing::getFileSize(size_t numSlots)
+{
+    return sizeof(Header) + numSlots * sizeof(Sample);
+}
+
+void TelemetryRing::add(uint64_t timestamp, uint16_t statusWord,
+                        int64_t inputPower, uint16_t flags)
+{
+    // Only this writes it, so it can't change underneath
+    auto index = header->written.load(std::memory_order_relaxed);
+    auto& slot = slots[index & (header->numSlots - 1)];
+
+    // Mark the slot as being written before touching the data
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp = timestamp;
+    slot.inputPower = inputPower;
+    slot.statusWord = statusWord;
+    slot.flags = flags;
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+    header->written.store(index + 1, std::memory_order_release);
+}
+
+TelemetryRing::ReadResult
+    TelemetryRing::read(const Header* header, uint64_t index,
+                        uint64_t& timestamp, uint16_t& statusWord,
+                        int64_t& inputPower, uint16_t& flags)
+{
+    auto written = header->written.load(std::memory_order_acquire);
+    if (index >= written)
+    {
+        return ReadResult::notWritten;
+    }
+
+    if (written - index > header->numSlots)
+    {
+        return ReadResult::overrun;
+    }
+
+    auto slots = reinterpret_cast<const Sample*>(
+        reinterpret_cast<const uint8_t*>(header) + header->slotOffset);
+    const auto& slot = slots[index & (header->numSlots - 1)];
+
+    auto before = slot.sequence.load(std::memory_order_acquire);
+
+    timestamp = slot.timestamp;
+    inputPower = slot.inputPower;
+    statusWord = slot.statusWord;
+    flags = slot.flags;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto after = slot.sequence.load(std::memory_order_relaxed);
+
+    if ((before != index + 1) || (after != index + 1))
+    {
+        return ReadResult::overrun;
+    }
+
+    return ReadResult::success;
+}
+
+} // namespace power
+} // namespace witherspoon
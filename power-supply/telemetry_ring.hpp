@@ -0,0 +1,199 @@
+#pragma once
+
+#include "file.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class TelemetryRing
+ *
+ * A ring of power supply samples in a memfd, written by psu-monitor
+ * and read directly by any number of local consumers, so they don't
+ * have to go through D-Bus for every sample.
+ *
+ * A consumer maps the file read only, for example by opening
+ * /proc/<pid>/fd/<fd> as logged at startup, and reads the samples
+ * in place.  The file is sealed so it can't change size under them.
+ *
+ * The layout, all little endian and naturally aligned:
+ *
+ *   Header, 64 bytes at offset 0:
+ *     0   uint32  magic, TELEMETRY_MAGIC
+ *     4   uint16  version, TELEMETRY_VERSION
+ *     6   uint16  sample size in bytes
+ *     8   uint32  number of slots, a power of 2
+ *     12  uint32  offset of slot 0 in bytes
+ *     16  uint64  written - the number of samples ever written
+ *     24  -       reserved
+ *
+ *   Sample N is in slot N % number of slots:
+ *     0   uint64  sequence - N + 1 once sample N is complete, 0 while
+ *                 a sample is being written to the slot
+ *     8   uint64  monotonic timestamp in nanoseconds
+ *     16  int64   input power in microwatts, if FLAG_INPUT_POWER
+ *     24  uint16  STATUS_WORD, if FLAG_STATUS_WORD
+ *     26  uint16  flags
+ *     28  -       reserved
+ *
+ * There is one writer and no locks.  To read sample N a consumer
+ * loads written, and if N is older than written minus the number of
+ * slots it has been overrun.  Otherwise it loads the slot sequence
+ * with acquire ordering, copies the sample, and loads the sequence
+ * again after an acquire fence.  The copy is good if both loads were
+ * N + 1.  Anything else means the writer lapped the consumer while it
+ * was copying.  See read().
+ */
+class TelemetryRing
+{
+  public:
+    static constexpr uint32_t TELEMETRY_MAGIC = 0x52544350; // 'PCTR'
+    static constexpr uint16_t TELEMETRY_VERSION = 1;
+
+    /**
+     * @brief The sample flags
+     */
+    static constexpr uint16_t FLAG_STATUS_WORD = 0x0001;
+    static constexpr uint16_t FLAG_INPUT_POWER = 0x0002;
+
+    /**
+     * @brief The ring header, at the start of the file
+     */
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t sampleSize;
+        uint32_t numSlots;
+        uint32_t slotOffset;
+        std::atomic<uint64_t> written;
+        uint8_t reserved[40];
+    };
+
+    /**
+     * @brief A sample slot
+     */
+    struct Sample
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t timestamp;
+        int64_t inputPower;
+        uint16_t statusWord;
+        uint16_t flags;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 64, "Telemetry header layout");
+    static_assert(sizeof(Sample) == 32, "Telemetry sample layout");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "Shared memory atomics must be lock free");
+
+    /**
+     * @brief The result of reading a sample
+     */
+    enum class ReadResult
+    {
+        success,
+        notWritten,
+        overrun
+    };
+
+    TelemetryRing() = delete;
+    ~TelemetryRing();
+    TelemetryRing(const TelemetryRing&) = delete;
+    TelemetryRing& operator=(const TelemetryRing&) = delete;
+    TelemetryRing(TelemetryRing&&) = delete;
+    TelemetryRing& operator=(TelemetryRing&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Creates, sizes, seals, and maps the memfd.
+     *
+     * @param[in] name - the memfd name, for debugging
+     * @param[in] numSlots - the number of samples to hold, rounded
+     *                       up to a power of 2
+     */
+    TelemetryRing(const std::string& name, size_t numSlots);
+
+    /**
+     * @brief Writes a sample
+     *
+     * @param[in] timestamp - the monotonic time in nanoseconds
+     * @param[in] statusWord - the STATUS_WORD value
+     * @param[in] inputPower - the input power in microwatts
+     * @param[in] flags - which of the values are valid
+     */
+    void add(uint64_t timestamp, uint16_t statusWord, int64_t inputPower,
+             uint16_t flags);
+
+    /**
+     * @brief Returns the memfd
+     */
+    inline int getFd()
+    {
+        return fd();
+    }
+
+    /**
+     * @brief Returns the number of slots
+     */
+    inline size_t getNumSlots() const
+    {
+        return header->numSlots;
+    }
+
+    /**
+     * @brief Returns the size of the file in bytes
+     */
+    static size_t getFileSize(size_t numSlots);
+
+    /**
+     * @brief Reads a sample out of a mapped ring, the way a
+     *        consumer would.
+     *
+     * @param[in] header - the start of the mapping
+     * @param[in] index - the sample number
+     * @param[out] timestamp - the monotonic time in nanoseconds
+     * @param[out] statusWord - the STATUS_WORD value
+     * @param[out] inputPower - the input power in microwatts
+     * @param[out] flags - which of the values are valid
+     *
+     * @return ReadResult - if the sample was read, isn't written yet,
+     *                      or was overwritten
+     */
+    static ReadResult read(const Header* header, uint64_t index,
+                           uint64_t& timestamp, uint16_t& statusWord,
+                           int64_t& inputPower, uint16_t& flags);
+
+  private:
+    /**
+     * @brief The memfd
+     */
+    util::FileDescriptor fd;
+
+    /**
+     * @brief The size of the mapping
+     */
+    size_t size = 0;
+
+    /**
+     * @brief The mapping, starting with the header
+     */
+    Header* header = nullptr;
+
+    /**
+     * @brief The slots, right after the header
+     */
+    Sample* slots = nullptr;
+};
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,458 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Measures the cost of PowerSupply::analyze() cycles.
+ *
+ * Runs a number of PowerSupply objects against a generated fake sysfs
+ * and debugfs tree, and a private dbus-daemon that has a fake inventory
+ * manager on it saying they're all present.  Every cycle analyzes each
+ * power supply once, the way DeviceMonitor would, and the results are
+ * appended as a line of JSON to the output file so runs on different
+ * commits can be compared:
+ *
+ *   analyze_bench --power-supplies=8 --cycles=10000 \
+ *       --label=$(git describe --always) --output=bench.json
+ *
+ * The inputs are fixed and nothing sleeps, so the counts are the same
+ * from run to run and only the times depend on the machine.
+ */
+#include "../power_supply.hpp"
+#include "pmbus.hpp"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server.hpp>
+#include <sdeventplus/event.hpp>
+#include <sstream>
+#include <xyz/openbmc_project/Inventory/Item/server.hpp>
+
+namespace fs = std::filesystem;
+using namespace witherspoon::power;
+using namespace std::chrono;
+
+namespace
+{
+
+constexpr auto INVENTORY_BUSNAME = "xyz.openbmc_project.Inventory.Manager";
+constexpr auto INVENTORY_ROOT =
+    "/xyz/openbmc_project/inventory/system/chassis/motherboard/powersupply";
+constexpr auto DRIVER_NAME = "ibm-cffps";
+
+// Cycles run first and not measured, to get the startup out of the way
+constexpr size_t WARMUP_CYCLES = 100;
+
+std::atomic<size_t> allocations{0};
+
+/**
+ * The read and write syscall counts from /proc/self/io
+ */
+struct IOCounts
+{
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+};
+
+IOCounts readIOCounts(int fd)
+{
+    IOCounts counts;
+    char buffer[512];
+
+    auto size = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    if (size <= 0)
+    {
+        return counts;
+    }
+    buffer[size] = '\0';
+
+    std::istringstream stream{buffer};
+    std::string name;
+    uint64_t value = 0;
+    while (stream >> name >> value)
+    {
+        if (name == "syscr:")
+        {
+            counts.reads = value;
+        }
+        else if (name == "syscw:")
+        {
+            counts.writes = value;
+        }
+    }
+
+    return counts;
+}
+
+long readRSS()
+{
+    std::ifstream file{"/proc/self/status"};
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+        {
+            return std::stol(line.substr(6));
+        }
+    }
+
+    return 0;
+}
+
+void writeFile(const fs::path& path, const std::string& contents)
+{
+    fs::create_directories(path.parent_path());
+    std::ofstream file{path};
+
+    // Like sysfs, with a newline
+    file << contents << '\n';
+}
+
+/**
+ * Makes the sysfs and debugfs files of a power supply with no
+ * faults, and returns its sysfs device path.
+ */
+std::string makeDevice(const fs::path& root, size_t instance)
+{
+    auto hwmon = "hwmon" + std::to_string(instance);
+    auto device = root / "sys" / ("psu" + std::to_string(instance));
+    auto debug = root / "debug" / "pmbus" / hwmon;
+
+    writeFile(device / "name", DRIVER_NAME);
+    writeFile(device / "hwmon" / hwmon / "power1_input", "500000000");
+    writeFile(device / "hwmon" / hwmon / "in1_input", "220000");
+
+    writeFile(debug / "status0", "0000");
+    writeFile(debug / "status0_input", "00");
+    writeFile(debug / "status0_vout", "00");
+    writeFile(debug / "status0_iout", "00");
+    writeFile(debug / "status0_mfr", "00");
+    writeFile(debug / "status0_fan12", "00");
+    writeFile(debug / "status0_temp", "00");
+
+    auto vpd = debug / DRIVER_NAME;
+    writeFile(vpd / "serial_number", "YL10KY" + std::to_string(instance));
+    writeFile(vpd / "part_number", "01KL471");
+    writeFile(vpd / "ccin", "2B1D");
+    writeFile(vpd / "fw_version", "0000000000000001");
+
+    return device;
+}
+
+/**
+ * Starts a dbus-daemon for just this run, and returns its address
+ */
+std::string startDaemon(pid_t& pid)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw std::runtime_error("pipe failed");
+    }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        auto print = "--print-address=" + std::to_string(fds[1]);
+        execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork",
+               print.c_str(), nullptr);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    std::string address;
+    char c;
+    while ((read(fds[0], &c, 1) == 1) && (c != '\n'))
+    {
+        address += c;
+    }
+    close(fds[0]);
+
+    if ((pid < 0) || address.empty())
+    {
+        throw std::runtime_error("Could not start dbus-daemon");
+    }
+
+    return address;
+}
+
+sdbusplus::bus::bus connect(const std::string& address)
+{
+    sd_bus* bus = nullptr;
+
+    if ((sd_bus_new(&bus) < 0) ||
+        (sd_bus_set_address(bus, address.c_str()) < 0) ||
+        (sd_bus_set_bus_client(bus, 1) < 0) || (sd_bus_start(bus) < 0))
+    {
+        throw std::runtime_error("Could not connect to dbus-daemon");
+    }
+
+    // Takes over the reference
+    return sdbusplus::bus::bus{bus, std::false_type{}};
+}
+
+void usage(char** argv)
+{
+    std::cerr << "Usage: " << argv[0] << " [options]\n";
+    std::cerr << "Options:\n";
+    std::cerr << "    --power-supplies=<num>   Number of power supplies\n";
+    std::cerr << "    --cycles=<num>           Number of analysis cycles\n";
+    std::cerr << "    --label=<text>           Label for the results,"
+                 " like a commit ID\n";
+    std::cerr << "    --output=<file>          File to append the JSON"
+                 " results to, instead of stdout\n";
+    std::cerr << std::flush;
+}
+
+} // namespace
+
+// Counts every allocation made with new
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    auto p = std::malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc{};
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char** argv)
+{
+    size_t numPowerSupplies = 8;
+    size_t numCycles = 10000;
+    std::string label;
+    std::string output;
+
+    const option options[] = {
+        {"power-supplies", required_argument, NULL, 'n'},
+        {"cycles", required_argument, NULL, 'c'},
+        {"label", required_argument, NULL, 'l'},
+        {"output", required_argument, NULL, 'o'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    auto option = 0;
+    while (-1 != (option = getopt_long(argc, argv, "n:c:l:o:h", options,
+                                       NULL)))
+    {
+        switch (option)
+        {
+            case 'n':
+                numPowerSupplies = std::stoul(optarg);
+                break;
+            case 'c':
+                numCycles = std::stoul(optarg);
+                break;
+            case 'l':
+                label = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv);
+                return -1;
+        }
+    }
+
+    if ((numPowerSupplies == 0) || (numCycles == 0))
+    {
+        std::cerr << "Invalid number of power supplies or cycles\n";
+        return -1;
+    }
+
+    // tmpfs, so the file accesses don't depend on a disk
+    char dir[] = "/dev/shm/analyze_benchXXXXXX";
+    if (!mkdtemp(dir))
+    {
+        std::cerr << "Could not create the fake sysfs tree\n";
+        return -1;
+    }
+    fs::path root{dir};
+
+    pmbus::PMBus::setDebugRoot(root / "debug");
+
+    std::vector<std::string> devicePaths;
+    for (size_t i = 0; i < numPowerSupplies; i++)
+    {
+        devicePaths.push_back(makeDevice(root, i));
+    }
+
+    pid_t daemon = 0;
+    auto address = startDaemon(daemon);
+
+    auto event = sdeventplus::Event::get_default();
+
+    // The fake inventory manager is on its own connection, so the
+    // power supplies' calls to it go through the daemon.
+    auto inventoryBus = connect(address);
+    inventoryBus.attach_event(event.get(), SD_EVENT_PRIORITY_NORMAL);
+
+    using Item = sdbusplus::xyz::openbmc_project::Inventory::server::Item;
+    std::vector<std::unique_ptr<sdbusplus::server::object::object<Item>>>
+        items;
+    for (size_t i = 0; i < numPowerSupplies; i++)
+    {
+        auto path = INVENTORY_ROOT + std::to_string(i);
+        items.push_back(
+            std::make_unique<sdbusplus::server::object::object<Item>>(
+                inventoryBus, path.c_str()));
+        items.back()->present(true);
+    }
+    inventoryBus.request_name(INVENTORY_BUSNAME);
+
+    auto bus = connect(address);
+    bus.attach_event(event.get(), SD_EVENT_PRIORITY_NORMAL);
+
+    std::vector<std::unique_ptr<psu::PowerSupply>> powerSupplies;
+    for (size_t i = 0; i < numPowerSupplies; i++)
+    {
+        powerSupplies.push_back(std::make_unique<psu::PowerSupply>(
+            "power_supply" + std::to_string(i), i, devicePaths[i],
+            INVENTORY_ROOT + std::to_string(i), bus, event, seconds{5},
+            seconds{2}));
+    }
+
+    // Let the startup D-Bus calls finish
+    auto start = steady_clock::now();
+    while (steady_clock::now() - start < milliseconds{500})
+    {
+        event.run(milliseconds{10});
+    }
+
+    for (size_t c = 0; c < WARMUP_CYCLES; c++)
+    {
+        for (auto& ps : powerSupplies)
+        {
+            ps->analyze();
+        }
+    }
+
+    int io = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+
+    std::vector<double> latencies;
+    latencies.reserve(numCycles);
+    uint64_t totalAllocations = 0;
+    uint64_t totalReads = 0;
+    uint64_t totalWrites = 0;
+
+    for (size_t c = 0; c < numCycles; c++)
+    {
+        auto ioBefore = readIOCounts(io);
+        auto allocsBefore = allocations.load();
+        auto before = steady_clock::now();
+
+        for (auto& ps : powerSupplies)
+        {
+            ps->analyze();
+        }
+
+        auto after = steady_clock::now();
+        auto allocsAfter = allocations.load();
+        auto ioAfter = readIOCounts(io);
+
+        latencies.push_back(
+            duration_cast<duration<double, std::micro>>(after - before)
+                .count());
+        totalAllocations += allocsAfter - allocsBefore;
+
+        // The read of ioBefore itself is counted in ioAfter
+        totalReads += ioAfter.reads - ioBefore.reads - 1;
+        totalWrites += ioAfter.writes - ioBefore.writes;
+
+        // Anything the cycle queued, like error logs, runs here
+        event.run(microseconds{0});
+    }
+
+    close(io);
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        auto index = static_cast<size_t>(p * (latencies.size() - 1));
+        return latencies[index];
+    };
+    auto mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) /
+                latencies.size();
+
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::ostringstream json;
+    json << "{\"label\":\"" << label << "\",\"power_supplies\":"
+         << numPowerSupplies << ",\"cycles\":" << numCycles
+         << ",\"latency_us\":{\"mean\":" << mean
+         << ",\"p50\":" << percentile(0.50) << ",\"p90\":" << percentile(0.90)
+         << ",\"p99\":" << percentile(0.99)
+         << ",\"max\":" << latencies.back() << "}"
+         << ",\"allocations_per_cycle\":"
+         << static_cast<double>(totalAllocations) / numCycles
+         << ",\"read_syscalls_per_cycle\":"
+         << static_cast<double>(totalReads) / numCycles
+         << ",\"write_syscalls_per_cycle\":"
+         << static_cast<double>(totalWrites) / numCycles
+         << ",\"rss_kb\":" << readRSS()
+         << ",\"max_rss_kb\":" << usage.ru_maxrss << "}";
+
+    if (output.empty())
+    {
+        std::cout << json.str() << std::endl;
+    }
+    else
+    {
+        std::ofstream file{output, std::ios::app};
+        file << json.str() << '\n';
+    }
+
+    powerSupplies.clear();
+    items.clear();
+
+    kill(daemon, SIGTERM);
+    waitpid(daemon, nullptr, 0);
+
+    fs::remove_all(root);
+
+    return 0;
+}
@@ -13,9 +13,25 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "../energy_accumulator.hpp"
+#include "../history_file.hpp"
+#include "../record_export.hpp"
 #include "../record_manager.hpp"
+#include "../segment_store.hpp"
+#include "../sequence_clock.hpp"
+#include "../system_history.hpp"
+#include "../telemetry_ring.hpp"
+#include "../vpd_cache.hpp"
+#include "../window_stats.hpp"
 #include "names_values.hpp"
 
+#include <sys/mman.h>
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
 #include <gtest/gtest.h>
@@ -178,3 +194,1012 @@ TEST(ManagerTest, TestRecordAdds)
     mgr.add(std::vector<uint8_t>{});
     EXPECT_EQ(0, mgr.getNumRecords());
 }
+
+/**
+ * @brief Helper function to create a PS history buffer
+ *
+ * @param sequenceIDs - the IDs to use, newest first
+ *
+ * @return vector<uint8_t> the buffer, with the average
+ *         power of each record set to its position
+ */
+std::vector<uint8_t> makeRawHistory(const std::vector<uint8_t>& sequenceIDs)
+{
+    std::vector<uint8_t> history;
+    uint16_t avg = 0;
+
+    for (auto id : sequenceIDs)
+    {
+        auto record = makeRawRecord(id, avg++, 0);
+        history.insert(history.end(), record.begin(), record.end());
+    }
+
+    return history;
+}
+
+/**
+ * Test filling in records from the full PS history buffer
+ */
+TEST(ManagerTest, TestBackfill)
+{
+    // Hold 5 max records.  IDs roll over at 8.
+    RecordManager mgr{5, 8};
+
+    // Nothing yet, so the whole buffer is needed
+    EXPECT_TRUE(mgr.needsBackfill(makeRawRecord(2, 0, 0)));
+
+    // Bad or empty data is left for add()
+    EXPECT_FALSE(mgr.needsBackfill(std::vector<uint8_t>{}));
+    EXPECT_FALSE(mgr.needsBackfill(std::vector<uint8_t>(6, 0)));
+
+    // Stops at the discontinuity after 0
+    EXPECT_TRUE(mgr.merge(makeRawHistory({2, 1, 0, 5, 4})));
+    EXPECT_EQ(3, mgr.getNumRecords());
+
+    // Timestamps are 30s apart, newest first
+    auto avgRecords = mgr.getAverageRecords();
+    EXPECT_EQ(0, std::get<1>(avgRecords[0]));
+    EXPECT_EQ(2, std::get<1>(avgRecords[2]));
+    EXPECT_EQ(30000, std::get<0>(avgRecords[0]) - std::get<0>(avgRecords[1]));
+    EXPECT_EQ(30000, std::get<0>(avgRecords[1]) - std::get<0>(avgRecords[2]));
+
+    // The next record and the current one can just be added
+    EXPECT_FALSE(mgr.needsBackfill(makeRawRecord(2, 0, 0)));
+    EXPECT_FALSE(mgr.needsBackfill(makeRawRecord(3, 0, 0)));
+
+    // Missed 4 and 5
+    EXPECT_TRUE(mgr.needsBackfill(makeRawRecord(6, 0, 0)));
+
+    // Only the new ones get added, with rollover, and the oldest pruned
+    EXPECT_TRUE(mgr.merge(makeRawHistory({1, 0, 8, 7, 6, 5, 4, 3, 2})));
+    EXPECT_EQ(5, mgr.getNumRecords());
+
+    avgRecords = mgr.getAverageRecords();
+    auto avg = 0;
+    for (const auto& r : avgRecords)
+    {
+        EXPECT_EQ(avg, std::get<1>(r));
+        avg++;
+    }
+
+    // Nothing new
+    EXPECT_FALSE(mgr.merge(makeRawHistory({1, 0, 8})));
+    EXPECT_EQ(5, mgr.getNumRecords());
+
+    // Can't line up with the buffer, so start over with it
+    EXPECT_TRUE(mgr.merge(makeRawHistory({6, 5})));
+    EXPECT_EQ(2, mgr.getNumRecords());
+
+    // Garbage length
+    EXPECT_FALSE(mgr.merge(std::vector<uint8_t>(4, 0)));
+    EXPECT_EQ(2, mgr.getNumRecords());
+
+    // Empty buffer clears it
+    EXPECT_TRUE(mgr.merge(std::vector<uint8_t>{}));
+    EXPECT_EQ(0, mgr.getNumRecords());
+}
+
+/**
+ * Test reading the records through views as
+ * the ring buffer wraps around
+ */
+TEST(ManagerTest, TestRecordViews)
+{
+    // Hold 3 max records
+    RecordManager mgr{3};
+
+    EXPECT_EQ(mgr.begin(), mgr.end());
+
+    for (uint8_t id = 0; id < 5; id++)
+    {
+        // avg = id, max = 10 * 2**1
+        mgr.add(makeRawRecord(id, id, 0x080A));
+    }
+
+    EXPECT_EQ(3, mgr.getNumRecords());
+    EXPECT_EQ(4, mgr.at(0).id());
+    EXPECT_EQ(2, mgr.at(2).id());
+
+    size_t id = 4;
+    for (const auto& r : mgr)
+    {
+        EXPECT_EQ(id, r.id());
+        EXPECT_EQ(id, r.average());
+        EXPECT_EQ(20, r.maximum());
+        id--;
+    }
+    EXPECT_EQ(1, id);
+
+    // Timestamps never go backwards from newest to oldest
+    EXPECT_GE(mgr.at(0).timestamp(), mgr.at(1).timestamp());
+    EXPECT_GE(mgr.at(1).timestamp(), mgr.at(2).timestamp());
+
+    mgr.clear();
+    EXPECT_EQ(0, mgr.getNumRecords());
+    EXPECT_EQ(mgr.begin(), mgr.end());
+}
+
+/**
+ * Test getting just the records added since a
+ * sequence number, and the epoch changing when
+ * the records are cleared.
+ */
+TEST(ManagerTest, TestIncrementalRecords)
+{
+    // Hold 3 max records
+    RecordManager mgr{3};
+
+    // Each instance starts in its own epoch
+    auto epoch = mgr.getEpoch();
+    EXPECT_NE(epoch, RecordManager{3}.getEpoch());
+    EXPECT_EQ(0, mgr.getSequence());
+
+    // Clearing without any records doesn't start a new epoch
+    mgr.add(std::vector<uint8_t>{});
+    EXPECT_EQ(epoch, mgr.getEpoch());
+
+    mgr.add(makeRawRecord(0, 1, 11));
+    mgr.add(makeRawRecord(1, 2, 12));
+    EXPECT_EQ(2, mgr.getSequence());
+
+    auto records = mgr.getRecordsSince(1);
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(2, std::get<1>(records[0]));
+    EXPECT_EQ(12, std::get<2>(records[0]));
+
+    EXPECT_TRUE(mgr.getRecordsSince(2).empty());
+
+    // Duplicates don't change the sequence
+    mgr.add(makeRawRecord(1, 2, 12));
+    EXPECT_EQ(2, mgr.getSequence());
+
+    mgr.add(makeRawRecord(2, 3, 13));
+    mgr.add(makeRawRecord(3, 4, 14));
+    EXPECT_EQ(4, mgr.getSequence());
+
+    records = mgr.getRecordsSince(2);
+    ASSERT_EQ(2, records.size());
+    EXPECT_EQ(4, std::get<1>(records[0]));
+    EXPECT_EQ(3, std::get<1>(records[1]));
+
+    // Only what is still there
+    EXPECT_EQ(3, mgr.getRecordsSince(0).size());
+
+    // A sync clears them
+    mgr.add(makeRawRecord(0, 5, 15));
+    EXPECT_EQ(epoch + 1, mgr.getEpoch());
+    EXPECT_EQ(1, mgr.getSequence());
+    EXPECT_EQ(1, mgr.getRecordsSince(0).size());
+}
+
+/**
+ * Test finding the records in a time range, and downsampling them
+ */
+TEST(ManagerTest, TestTimeRange)
+{
+    RecordManager mgr{20};
+
+    // Timestamps 30s apart, with averages 0 to 7 newest first
+    mgr.merge(makeRawHistory({7, 6, 5, 4, 3, 2, 1, 0}));
+    ASSERT_EQ(8, mgr.getNumRecords());
+
+    uint64_t newest = mgr.at(0).timestamp();
+    uint64_t oldest = mgr.at(7).timestamp();
+
+    using Range = std::pair<size_t, size_t>;
+
+    EXPECT_EQ(Range(0, 8), mgr.findRange(0, 0));
+    EXPECT_EQ(Range(1, 4), mgr.findRange(newest - 90000, newest - 30000));
+    EXPECT_EQ(Range(1, 3), mgr.findRange(newest - 89999, newest - 1));
+
+    // Nothing in range
+    auto range = mgr.findRange(newest + 1, 0);
+    EXPECT_EQ(range.first, range.second);
+    range = mgr.findRange(0, oldest - 1);
+    EXPECT_EQ(range.first, range.second);
+
+    auto records = mgr.getRecordsInRange(newest - 60000, 0, 0);
+    ASSERT_EQ(3, records.size());
+    EXPECT_EQ(newest, std::get<0>(records[0]));
+    EXPECT_EQ(0, std::get<1>(records[0]));
+    EXPECT_EQ(2, std::get<1>(records[2]));
+
+    // Buckets as big as the spacing hold a record each
+    EXPECT_EQ(8, mgr.getRecordsInRange(0, 0, 30000).size());
+
+    // One bucket for everything
+    records = mgr.getRecordsInRange(0, 0, newest * 2);
+    ASSERT_EQ(1, records.size());
+    EXPECT_EQ(0, std::get<0>(records[0]));
+    EXPECT_EQ(3, std::get<1>(records[0]));
+    EXPECT_EQ(0, std::get<2>(records[0]));
+    EXPECT_EQ(7, std::get<3>(records[0]));
+}
+
+/**
+ * Test exporting the records in a time range into a memfd
+ */
+TEST(ManagerTest, TestRecordExport)
+{
+    RecordManager mgr{5};
+
+    // Timestamps 30s apart, with averages 0 to 3 newest first
+    mgr.merge(makeRawHistory({3, 2, 1, 0}));
+    ASSERT_EQ(4, mgr.getNumRecords());
+
+    uint64_t newest = mgr.at(0).timestamp();
+
+    // Leaves out the newest and oldest
+    RecordExport exported{mgr, newest - 60000, newest - 1};
+    EXPECT_EQ(2, exported.getCount());
+
+    auto size = sizeof(RecordExport::Header) + 2 * sizeof(RecordExport::Record);
+    auto mapping =
+        mmap(nullptr, size, PROT_READ, MAP_SHARED, exported.getFD(), 0);
+    ASSERT_NE(MAP_FAILED, mapping);
+
+    auto header = static_cast<const RecordExport::Header*>(mapping);
+    EXPECT_EQ(RecordExport::EXPORT_MAGIC, header->magic);
+    EXPECT_EQ(sizeof(RecordExport::Record), header->recordSize);
+    EXPECT_EQ(mgr.getEpoch(), header->epoch);
+    EXPECT_EQ(mgr.getSequence(), header->sequence);
+    EXPECT_EQ(2, header->count);
+
+    auto records = reinterpret_cast<const RecordExport::Record*>(
+        static_cast<const uint8_t*>(mapping) + header->recordOffset);
+    EXPECT_EQ(newest - 30000, records[0].timestamp);
+    EXPECT_EQ(1, records[0].average);
+    EXPECT_EQ(newest - 60000, records[1].timestamp);
+    EXPECT_EQ(2, records[1].average);
+
+    munmap(mapping, size);
+
+    // Sealed against changes
+    uint8_t byte = 0;
+    EXPECT_EQ(-1, pwrite(exported.getFD(), &byte, 1, 0));
+
+    // Nothing moved the file offset
+    EXPECT_EQ(0, lseek(exported.getFD(), 0, SEEK_CUR));
+    EXPECT_EQ(size, lseek(exported.getFD(), 0, SEEK_END));
+
+    EXPECT_TRUE(exported.isCurrent(mgr, newest - 60000, newest - 1));
+    EXPECT_FALSE(exported.isCurrent(mgr, 0, 0));
+
+    EXPECT_EQ(4, RecordExport(mgr, 0, 0).getCount());
+    EXPECT_EQ(0, RecordExport(mgr, newest + 1, 0).getCount());
+
+    mgr.add(makeRawRecord(4, 0, 0));
+    EXPECT_FALSE(exported.isCurrent(mgr, newest - 60000, newest - 1));
+}
+
+/**
+ * Test keeping the records in a history file, including
+ * falling back to the older header if the newest one
+ * is corrupted.
+ */
+TEST(ManagerTest, TestHistoryFile)
+{
+    namespace fs = std::filesystem;
+
+    char dir[] = "/tmp/historyfileXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    auto path = fs::path{dir} / "history";
+
+    {
+        RecordManager mgr{3};
+        mgr.add(makeRawRecord(0, 1, 11));
+
+        // Existing records go into a new file
+        mgr.persist(path);
+        EXPECT_EQ(1, mgr.getNumRecords());
+
+        mgr.add(makeRawRecord(1, 2, 12));
+        mgr.add(makeRawRecord(2, 3, 13));
+        mgr.add(makeRawRecord(3, 4, 14));
+        EXPECT_EQ(3, mgr.getNumRecords());
+    }
+
+    {
+        RecordManager mgr{3};
+        mgr.persist(path);
+
+        ASSERT_EQ(3, mgr.getNumRecords());
+        EXPECT_EQ(4, mgr.getSequence());
+        EXPECT_EQ(3, mgr.at(0).id());
+        EXPECT_EQ(4, mgr.at(0).average());
+        EXPECT_EQ(1, mgr.at(2).id());
+
+        mgr.add(makeRawRecord(4, 5, 15));
+    }
+
+    // Corrupt the header with the newest generation
+    {
+        using Slot = std::array<char, HistoryFile::HEADER_SLOT_SIZE>;
+        std::array<Slot, HistoryFile::HEADER_SLOTS> slots;
+        std::fstream f{path, std::ios::in | std::ios::out | std::ios::binary};
+        f.read(slots[0].data(), sizeof(slots));
+
+        uint64_t gen0, gen1;
+        std::memcpy(&gen0, slots[0].data() + 16, sizeof(gen0));
+        std::memcpy(&gen1, slots[1].data() + 16, sizeof(gen1));
+
+        f.seekp((gen0 > gen1) ? 0 : HistoryFile::HEADER_SLOT_SIZE);
+        f.write("bad", 3);
+    }
+
+    {
+        RecordManager mgr{3};
+        mgr.persist(path);
+
+        // The previous commit only dropped the oldest record
+        // before writing ID 4 over it.
+        ASSERT_EQ(2, mgr.getNumRecords());
+        EXPECT_EQ(4, mgr.getSequence());
+        EXPECT_EQ(3, mgr.at(0).id());
+        EXPECT_EQ(2, mgr.at(1).id());
+    }
+
+    {
+        RecordManager mgr{3};
+        mgr.persist(path);
+        mgr.add(makeRawRecord(4, 5, 15));
+        EXPECT_EQ(3, mgr.getNumRecords());
+    }
+
+    // The newest header made it to the file, but not its record
+    {
+        std::fstream f{path, std::ios::in | std::ios::out | std::ios::binary};
+        for (size_t i = 0; i < 3; i++)
+        {
+            auto offset =
+                HistoryFile::HEADER_SLOTS * HistoryFile::HEADER_SLOT_SIZE +
+                i * sizeof(PackedRecord);
+
+            PackedRecord record;
+            f.seekg(offset);
+            f.read(reinterpret_cast<char*>(&record), sizeof(record));
+            if (record.id == 4)
+            {
+                record.average = 0;
+                f.seekp(offset);
+                f.write(reinterpret_cast<char*>(&record), sizeof(record));
+            }
+        }
+    }
+
+    {
+        RecordManager mgr{3};
+        mgr.persist(path);
+
+        // The older header's records are still good
+        ASSERT_EQ(2, mgr.getNumRecords());
+        EXPECT_EQ(3, mgr.at(0).id());
+        EXPECT_EQ(2, mgr.at(1).id());
+    }
+
+    // A different size starts over
+    {
+        RecordManager mgr{5};
+        mgr.persist(path);
+        EXPECT_EQ(0, mgr.getNumRecords());
+        EXPECT_EQ(5 * sizeof(PackedRecord) +
+                      HistoryFile::HEADER_SLOTS * HistoryFile::HEADER_SLOT_SIZE,
+                  fs::file_size(path));
+    }
+
+    fs::remove_all(dir);
+}
+
+/**
+ * Test the flash archive batching records into blocks, finding
+ * them by time, evicting old segments, and recovering from a
+ * partly written block.
+ */
+TEST(SegmentStoreTest, TestArchive)
+{
+    namespace fs = std::filesystem;
+    using Record = SegmentStore::Record;
+
+    char dir[] = "/tmp/segmentstoreXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+
+    constexpr uint64_t base = 1600000000000;
+    auto makeRecord = [](size_t i) {
+        int64_t average = 500 + (i * 7) % 40;
+        return Record{base + i * 30000 + (i % 3), average, average + 20,
+                      static_cast<uint8_t>(i)};
+    };
+
+    {
+        SegmentStore store{dir, 2048, 512, 10};
+
+        for (size_t i = 0; i < 25; i++)
+        {
+            EXPECT_TRUE(store.append(makeRecord(i)));
+        }
+
+        // Not newer than the last one
+        EXPECT_FALSE(store.append(makeRecord(3)));
+
+        // Two blocks written and 5 records still batched
+        EXPECT_EQ(2, store.getNumBlocks());
+        EXPECT_EQ(1, store.getNumSegments());
+
+        auto records = store.getRecords(0, 0);
+        ASSERT_EQ(25, records.size());
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            EXPECT_EQ(makeRecord(i), records[i]);
+        }
+
+        records = store.getRecords(makeRecord(8).timestamp,
+                                   makeRecord(21).timestamp);
+        ASSERT_EQ(14, records.size());
+        EXPECT_EQ(makeRecord(8), records.front());
+        EXPECT_EQ(makeRecord(21), records.back());
+
+        // Just the newest ones in the range, across the blocks
+        records = store.getRecords(0, makeRecord(21).timestamp, 14);
+        ASSERT_EQ(14, records.size());
+        EXPECT_EQ(makeRecord(8), records.front());
+        EXPECT_EQ(makeRecord(21), records.back());
+
+        records = store.getRecords(0, 0, 7);
+        ASSERT_EQ(7, records.size());
+        EXPECT_EQ(makeRecord(18), records.front());
+        EXPECT_EQ(makeRecord(24), records.back());
+
+        // Well under the 32 bytes a record takes in an export
+        EXPECT_LT(store.getSize(), 20 * 10);
+    }
+
+    {
+        // The batch was written when the last one was destroyed
+        SegmentStore store{dir, 2048, 512, 10};
+        EXPECT_EQ(3, store.getNumBlocks());
+        EXPECT_EQ(makeRecord(24).timestamp, store.getLastTimestamp());
+
+        auto records = store.getRecords(makeRecord(24).timestamp, 0);
+        ASSERT_EQ(1, records.size());
+        EXPECT_EQ(makeRecord(24), records[0]);
+
+        // Fill enough segments for the oldest to be evicted
+        for (size_t i = 25; i < 1000; i++)
+        {
+            store.append(makeRecord(i));
+        }
+        store.flush();
+
+        EXPECT_LE(store.getSize(), 2048);
+        EXPECT_GT(store.getNumSegments(), 1);
+
+        records = store.getRecords(0, 0);
+        ASSERT_FALSE(records.empty());
+        EXPECT_GT(records.front().timestamp, makeRecord(24).timestamp);
+        EXPECT_EQ(makeRecord(999), records.back());
+    }
+
+    // Cut the last block short, like a power loss during the write
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(dir))
+    {
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    fs::resize_file(files.back(), fs::file_size(files.back()) - 3);
+
+    {
+        SegmentStore store{dir, 2048, 512, 10};
+        auto records = store.getRecords(0, 0);
+        ASSERT_FALSE(records.empty());
+        EXPECT_EQ(makeRecord(994), records.back());
+
+        // Appends continue after the last good block
+        EXPECT_TRUE(store.append(makeRecord(995)));
+        store.flush();
+    }
+
+    {
+        SegmentStore store{dir, 2048, 512, 10};
+        auto records = store.getRecords(0, 0);
+        ASSERT_FALSE(records.empty());
+        EXPECT_EQ(makeRecord(995), records.back());
+    }
+
+    fs::remove_all(dir);
+}
+
+/**
+ * Test accumulating energy from history records, samples, and
+ * READ_EIN, across overlaps and gaps, and keeping it in a file.
+ */
+TEST(EnergyTest, TestAccumulation)
+{
+    namespace fs = std::filesystem;
+    using Source = EnergyAccumulator::Source;
+
+    char dir[] = "/tmp/energyXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    auto path = (fs::path{dir} / "ps0_input_energy").string();
+
+    constexpr uint64_t t = 1600000000000;
+
+    {
+        EnergyAccumulator energy{path};
+        EXPECT_EQ(0, energy.getStart());
+
+        // 120W for 30s is 1Wh
+        energy.add(t, t + 30000, 120, Source::InputHistory);
+        energy.add(t + 30000, t + 60000, 240, Source::InputHistory);
+        EXPECT_DOUBLE_EQ(3, energy.getWattHours());
+        EXPECT_EQ(t, energy.getStart());
+
+        // Realigned by a SYNC, so only the last 20s are new
+        energy.add(t + 50000, t + 80000, 360, Source::InputHistory);
+        EXPECT_DOUBLE_EQ(5, energy.getWattHours());
+
+        // A missed record is filled in
+        energy.add(t + 110000, t + 140000, 120, Source::InputHistory);
+        EXPECT_DOUBLE_EQ(7, energy.getWattHours());
+        EXPECT_EQ(0, energy.getUnmeasured());
+
+        // A long gap isn't
+        energy.add(t + 740000, t + 770000, 120, Source::InputHistory);
+        EXPECT_DOUBLE_EQ(8, energy.getWattHours());
+        EXPECT_EQ(600000, energy.getUnmeasured());
+
+        // Samples averaging 100W over 36s, and then a record they
+        // already cover
+        energy.addSample(t + 770000, 120);
+        energy.addSample(t + 788000, 80);
+        energy.addSample(t + 806000, 120);
+        EXPECT_DOUBLE_EQ(9, energy.getWattHours());
+        EXPECT_EQ(Source::Samples, energy.getSource());
+
+        energy.add(t + 776000, t + 806000, 500, Source::InputHistory);
+        EXPECT_DOUBLE_EQ(9, energy.getWattHours());
+        EXPECT_EQ(Source::Samples, energy.getSource());
+
+        // An accumulator growth of 1000 over 10 samples is 100W, across
+        // a rollover of the accumulator and of the sample count.
+        energy.addEIN(t + 806000, {0x00, 0x7E, 0x01, 0xFA, 0xFF, 0xFF});
+        energy.addEIN(t + 842000, {0xE8, 0x01, 0x02, 0x04, 0x00, 0x00});
+        EXPECT_DOUBLE_EQ(10, energy.getWattHours());
+        EXPECT_EQ(Source::ReadEIN, energy.getSource());
+
+        // Nothing sampled yet
+        energy.addEIN(t + 852000, {0xE8, 0x01, 0x02, 0x04, 0x00, 0x00});
+        EXPECT_DOUBLE_EQ(10, energy.getWattHours());
+
+        energy.save();
+    }
+
+    EnergyAccumulator energy{path};
+    EXPECT_DOUBLE_EQ(10, energy.getWattHours());
+    EXPECT_EQ(t, energy.getStart());
+    EXPECT_EQ(t + 842000, energy.getEnd());
+    EXPECT_EQ(600000, energy.getUnmeasured());
+
+    fs::remove_all(dir);
+}
+
+/**
+ * Test a rollup level aggregating records into periods,
+ * and passing the completed ones up to the next level.
+ */
+TEST(RollupTest, TestLevels)
+{
+    // Keep 2 periods of 60s, fed with a record every 30s
+    Rollup minute{"per_1m", std::chrono::seconds{60}, 2};
+    Rollup hour{"per_1h", std::chrono::hours{1}, 2};
+
+    auto add = [&minute, &hour](int64_t time, int64_t avg, int64_t max) {
+        auto completed =
+            minute.add(Rollup::Summary{time, avg, 1, max, avg, 0, 0, 0});
+        if (completed)
+        {
+            hour.add(*completed, &minute.getCompletedSketch());
+        }
+        return completed.has_value();
+    };
+
+    EXPECT_FALSE(add(0, 10, 20));
+    EXPECT_FALSE(add(30000, 30, 40));
+    EXPECT_EQ(0, minute.getNumRecords());
+
+    // The next minute completes the first
+    EXPECT_TRUE(add(60000, 50, 60));
+    ASSERT_EQ(1, minute.getNumRecords());
+    EXPECT_EQ(1, minute.getSequence());
+    EXPECT_EQ(0, minute.at(0).timestamp);
+    EXPECT_EQ(20, minute.at(0).average());
+    EXPECT_EQ(40, minute.at(0).maximum);
+    EXPECT_EQ(10, minute.at(0).minimum);
+
+    // Older records are ignored
+    EXPECT_FALSE(add(30000, 1000, 1000));
+
+    EXPECT_FALSE(add(90000, 70, 80));
+    EXPECT_TRUE(add(150000, 100, 100));
+    EXPECT_TRUE(add(180000, 100, 100));
+
+    // Only the newest 2 are kept
+    ASSERT_EQ(2, minute.getNumRecords());
+    EXPECT_EQ(3, minute.getSequence());
+
+    auto averages = minute.getAverageRecords();
+    ASSERT_EQ(2, averages.size());
+    EXPECT_EQ(120000, std::get<0>(averages[0]));
+    EXPECT_EQ(100, std::get<1>(averages[0]));
+    EXPECT_EQ(60000, std::get<0>(averages[1]));
+    EXPECT_EQ(60, std::get<1>(averages[1]));
+
+    // A new hour completes the first one, with the
+    // average weighted by the number of records.
+    EXPECT_TRUE(add(3600000, 0, 0));
+    EXPECT_TRUE(add(3660000, 0, 0));
+    ASSERT_EQ(1, hour.getNumRecords());
+    EXPECT_EQ(0, hour.at(0).timestamp);
+    EXPECT_EQ(6, hour.at(0).samples);
+    EXPECT_EQ((10 + 30 + 50 + 70 + 100 + 100) / 6, hour.at(0).average());
+    EXPECT_EQ(100, hour.at(0).maximum);
+    EXPECT_EQ(10, hour.at(0).minimum);
+
+    // The percentiles come from the merged minute sketches,
+    // so are of the 30s values and not the minute averages.
+    EXPECT_TRUE((hour.at(0).p50 >= 49) && (hour.at(0).p50 <= 51));
+    EXPECT_EQ(100, hour.at(0).p99);
+    EXPECT_EQ(100, std::get<3>(hour.getPercentileRecords()[0]));
+}
+
+/**
+ * Test the percentiles from a sketch, and merging sketches.
+ */
+TEST(SketchTest, TestPercentiles)
+{
+    PercentileSketch sketch;
+    EXPECT_EQ(0, sketch.getPercentile(50));
+
+    for (int64_t i = 1; i <= 1000; i++)
+    {
+        sketch.add(i);
+    }
+
+    EXPECT_EQ(1000, sketch.getCount());
+    EXPECT_EQ(1000, sketch.getMaximum());
+    EXPECT_EQ(1000, sketch.getPercentile(100));
+
+    auto withinAccuracy = [](int64_t value, int64_t expected) {
+        return std::abs(value - expected) <=
+               expected * PercentileSketch::RELATIVE_ACCURACY + 1;
+    };
+
+    EXPECT_TRUE(withinAccuracy(sketch.getPercentile(50), 500));
+    EXPECT_TRUE(withinAccuracy(sketch.getPercentile(95), 950));
+    EXPECT_TRUE(withinAccuracy(sketch.getPercentile(99), 990));
+
+    // Half of the values at 0 moves the median down to them
+    PercentileSketch zeros;
+    for (int i = 0; i < 1001; i++)
+    {
+        zeros.add(0);
+    }
+
+    sketch.merge(zeros);
+    EXPECT_EQ(2001, sketch.getCount());
+    EXPECT_EQ(1000, sketch.getMaximum());
+    EXPECT_EQ(0, sketch.getPercentile(50));
+    EXPECT_TRUE(withinAccuracy(sketch.getPercentile(99), 980));
+
+    sketch.clear();
+    EXPECT_EQ(0, sketch.getCount());
+}
+
+/**
+ * Test combining the records from multiple power supplies,
+ * lined up by their sequence IDs.
+ */
+TEST(SystemHistoryTest, TestAlignment)
+{
+    using Records = RecordManager::DBusCombinedRecordList;
+
+    SystemHistory system{2, 10};
+
+    // PS 0 gets its records read a bit earlier than PS 1
+    EXPECT_FALSE(system.add(0, Records{{30500, 100, 150, 1},
+                                       {500, 100, 150, 0}}));
+    EXPECT_EQ(0, system.getNumRecords());
+
+    EXPECT_TRUE(system.add(1, Records{{1000, 200, 250, 0}}));
+    ASSERT_EQ(1, system.getNumRecords());
+    EXPECT_EQ(500, system.at(0).timestamp);
+    EXPECT_EQ(300, system.at(0).average);
+    EXPECT_EQ(400, system.at(0).maximum);
+    EXPECT_EQ(0x3, system.at(0).powerSupplies);
+
+    // Duplicates don't count again
+    EXPECT_FALSE(system.add(0, Records{{30500, 100, 150, 1}}));
+    EXPECT_FALSE(system.add(1, Records{{1000, 200, 250, 0}}));
+    EXPECT_EQ(1, system.getNumRecords());
+
+    EXPECT_TRUE(system.add(1, Records{{31000, 200, 250, 1}}));
+    ASSERT_EQ(2, system.getNumRecords());
+    EXPECT_EQ(300, system.at(0).average);
+
+    // PS 1 goes missing, so its records are left out after
+    // waiting long enough.
+    EXPECT_FALSE(system.add(0, Records{{60500, 110, 150, 2}}));
+    EXPECT_FALSE(system.add(0, Records{{90500, 120, 150, 3}}));
+    EXPECT_TRUE(system.add(0, Records{{120500, 130, 150, 4}}));
+    ASSERT_EQ(3, system.getNumRecords());
+    EXPECT_EQ(110, system.at(0).average);
+    EXPECT_EQ(0x1, system.at(0).powerSupplies);
+
+    // Too late now
+    EXPECT_FALSE(system.add(1, Records{{61000, 200, 250, 2}}));
+    EXPECT_EQ(3, system.getNumRecords());
+
+    // The same ID after a SYNC is a different record
+    EXPECT_TRUE(system.add(1, Records{{121000, 300, 350, 0},
+                                      {91000, 200, 250, 3}}));
+    ASSERT_EQ(4, system.getNumRecords());
+    EXPECT_EQ(320, system.at(0).average);
+    EXPECT_EQ(0x3, system.at(0).powerSupplies);
+
+    auto totals = system.getTotalRecords();
+    ASSERT_EQ(4, totals.size());
+    EXPECT_EQ(90500, std::get<0>(totals[0]));
+    EXPECT_EQ(1, std::get<3>(totals[1]));
+
+    // Unknown power supplies are ignored
+    EXPECT_FALSE(system.add(2, Records{{150000, 1, 1, 5}}));
+
+    // The system records go into the rollups too, and a record in
+    // the next 5 minutes completes the first period once PS 1's
+    // record for it is too late.
+    const auto& level = system.getRollups().front();
+    EXPECT_EQ(0, level.getNumRecords());
+
+    EXPECT_TRUE(system.add(0, Records{{300500, 100, 150, 5}}));
+    EXPECT_TRUE(system.add(0, Records{{400500, 100, 150, 6}}));
+    ASSERT_EQ(1, level.getNumRecords());
+    EXPECT_EQ(0, level.at(0).timestamp);
+    EXPECT_EQ(6, level.at(0).samples);
+    EXPECT_NEAR(300, level.at(0).p95, 300 * 0.02);
+    EXPECT_EQ(110, level.at(0).minimum);
+}
+
+/**
+ * Test the record timestamps coming from the sequence,
+ * instead of from when the records were seen.
+ */
+TEST(SequenceClockTest, TestTimestamps)
+{
+    using namespace std::chrono;
+
+    SequenceClock clock{milliseconds{30000}};
+
+    // Seen anywhere from 0 to 900ms after being made, with
+    // the PS clock 0.5% slow.
+    const int64_t jitter[] = {900, 100, 500, 0, 700};
+    auto arrival = [&jitter](int64_t n) {
+        return 1000000 + n * 30150 + jitter[n % 5];
+    };
+
+    auto first = clock.tick(arrival(0));
+    auto previous = first;
+
+    for (int64_t n = 1; n < 100; n++)
+    {
+        auto timestamp = clock.tick(arrival(n));
+
+        // Evenly spaced no matter when they were seen, once the
+        // earliest possible arrival was found.
+        auto spacing = timestamp - previous;
+        if (n >= 5)
+        {
+            EXPECT_GE(spacing, 29850);
+            EXPECT_LE(spacing, 30450);
+        }
+        previous = timestamp;
+    }
+
+    // The drift was measured
+    EXPECT_NEAR(30150, clock.getPeriod(), 15);
+
+    // The anchor is from the earliest arrival
+    EXPECT_NEAR(first - 900 + 99 * 30150, previous, 50);
+
+    // Earlier records are a period apart
+    EXPECT_NEAR(clock.getPeriod(),
+                clock.getTimestamp(0) - clock.getTimestamp(1), 1);
+
+    // Multiple records at once
+    auto timestamp = clock.tick(arrival(102), 3);
+    EXPECT_NEAR(3 * clock.getPeriod(), timestamp - previous, 100);
+
+    // The next record is expected when it will be made, which
+    // is the earliest it could be seen.
+    EXPECT_NEAR(1000000 + 103 * 30150, *clock.getNextRecordTime(), 50);
+
+    // Showing up way late starts over
+    clock.tick(arrival(102) + 120000);
+    EXPECT_EQ(30000, clock.getPeriod());
+
+    // So does a reset
+    clock.reset();
+    EXPECT_FALSE(clock.getNextRecordTime());
+    timestamp = clock.tick(arrival(103));
+    EXPECT_EQ(30000, clock.getPeriod());
+    EXPECT_EQ(timestamp - 30000, clock.getTimestamp(1));
+
+    // A new anchor after the system time was set back a little,
+    // which a newer timestamp stands in for, still comes after it.
+    SequenceClock setBack{milliseconds{30000}};
+    auto now = SequenceClock::getMonotonicTime();
+    auto start = setBack.tick(now);
+    auto newest = start + 60000;
+    setBack.setNewestTimestamp(newest);
+    setBack.reset();
+    EXPECT_EQ(newest + 30000, setBack.tick(now + 1000));
+    EXPECT_NEAR(newest + 60000, setBack.tick(now + 31000), 1000);
+    EXPECT_FALSE(setBack.takeTimeStepBack());
+
+    // Other times line up with the records, not the system time
+    EXPECT_NEAR(newest + 45000, setBack.getTimestampAt(now + 16000), 1000);
+
+    // Set back too far, it goes by the new time and says so
+    setBack.setNewestTimestamp(start + 3600000);
+    setBack.reset();
+    EXPECT_NEAR(start + 61000, setBack.tick(now + 61000), 100);
+    EXPECT_TRUE(setBack.takeTimeStepBack());
+    EXPECT_FALSE(setBack.takeTimeStepBack());
+}
+
+TEST(WindowStatsTest, TestStats)
+{
+    witherspoon::power::WindowStats stats;
+
+    EXPECT_EQ(0, stats.getCount());
+    EXPECT_EQ(0, stats.getStandardDeviation());
+
+    for (auto value : {2, 4, 4, 4, 5, 5, 7, 9})
+    {
+        stats.add(value * 1000000);
+    }
+
+    EXPECT_EQ(8, stats.getCount());
+    EXPECT_EQ(2000000, stats.getMinimum());
+    EXPECT_EQ(9000000, stats.getMaximum());
+    EXPECT_DOUBLE_EQ(5000000, stats.getMean());
+    EXPECT_NEAR(2000000, stats.getStandardDeviation(), 0.001);
+
+    // A new window starts over
+    stats.clear();
+    stats.add(-3);
+    EXPECT_EQ(1, stats.getCount());
+    EXPECT_EQ(-3, stats.getMinimum());
+    EXPECT_EQ(-3, stats.getMaximum());
+    EXPECT_EQ(0, stats.getStandardDeviation());
+}
+
+TEST(TelemetryRingTest, TestReadWrite)
+{
+    using witherspoon::power::TelemetryRing;
+    using Result = TelemetryRing::ReadResult;
+
+    // Rounded up to a power of 2
+    TelemetryRing ring{"test_telemetry", 6};
+    ASSERT_EQ(8, ring.getNumSlots());
+
+    // Mapped separately, the way a consumer would
+    auto size = TelemetryRing::getFileSize(ring.getNumSlots());
+    auto mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, ring.getFd(), 0);
+    ASSERT_NE(MAP_FAILED, mapping);
+    auto header = static_cast<const TelemetryRing::Header*>(mapping);
+
+    EXPECT_EQ(TelemetryRing::TELEMETRY_MAGIC, header->magic);
+    EXPECT_EQ(sizeof(TelemetryRing::Sample), header->sampleSize);
+
+    uint64_t timestamp = 0;
+    uint16_t statusWord = 0;
+    int64_t inputPower = 0;
+    uint16_t flags = 0;
+
+    EXPECT_EQ(Result::notWritten, TelemetryRing::read(header, 0, timestamp,
+                                                      statusWord, inputPower,
+                                                      flags));
+
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        ring.add(1000 + i, 0x0800, 500000000 + i,
+                 TelemetryRing::FLAG_STATUS_WORD |
+                     TelemetryRing::FLAG_INPUT_POWER);
+    }
+
+    // The first 2 were overwritten
+    EXPECT_EQ(Result::overrun, TelemetryRing::read(header, 1, timestamp,
+                                                   statusWord, inputPower,
+                                                   flags));
+
+    ASSERT_EQ(Result::success, TelemetryRing::read(header, 2, timestamp,
+                                                   statusWord, inputPower,
+                                                   flags));
+    EXPECT_EQ(1002, timestamp);
+    EXPECT_EQ(0x0800, statusWord);
+    EXPECT_EQ(500000002, inputPower);
+
+    ASSERT_EQ(Result::success, TelemetryRing::read(header, 9, timestamp,
+                                                   statusWord, inputPower,
+                                                   flags));
+    EXPECT_EQ(1009, timestamp);
+
+    EXPECT_EQ(Result::notWritten, TelemetryRing::read(header, 10, timestamp,
+                                                      statusWord, inputPower,
+                                                      flags));
+
+    munmap(mapping, size);
+}
+
+/**
+ * Test that the VPD cache finds power supplies by serial number,
+ * and survives a restart.
+ */
+TEST(VPDCacheTest, TestCache)
+{
+    namespace fs = std::filesystem;
+    using namespace witherspoon::power::psu;
+
+    char dir[] = "/tmp/vpdcacheXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    auto path = (fs::path{dir} / "ps0_vpd").string();
+
+    {
+        VPDCache cache{path};
+        EXPECT_EQ(0, cache.getCount());
+
+        cache.add({"SN1", "PN1", "2B1D", "0102"});
+        cache.add({"SN2", "PN2", "2B1E", "0103"});
+
+        // Not cacheable
+        cache.add({"", "PN3", "2B1F", "0104"});
+        cache.add({"SN4", "PN\t4", "2B1F", "0104"});
+
+        // Replaces the first one
+        cache.add({"SN1", "PN1", "2B1C", "0105"});
+
+        EXPECT_EQ(2, cache.getCount());
+        EXPECT_FALSE(cache.find("SN3"));
+    }
+
+    VPDCache cache{path};
+    ASSERT_EQ(2, cache.getCount());
+
+    // The firmware version isn't cached, since an update changes it
+    auto vpd = cache.find("SN1");
+    ASSERT_TRUE(vpd);
+    EXPECT_EQ("PN1", vpd->partNumber);
+    EXPECT_EQ("2B1C", vpd->ccin);
+    EXPECT_EQ("", vpd->version);
+
+    for (size_t i = 0; i < VPDCache::MAX_ENTRIES; i++)
+    {
+        cache.add({"SN" + std::to_string(i + 10), "PN", "2B1D", "0101"});
+    }
+
+    EXPECT_EQ(VPDCache::MAX_ENTRIES, cache.getCount());
+    EXPECT_FALSE(cache.find("SN2"));
+
+    // Files that still have the firmware version work
+    {
+        std::ofstream file{path, std::ios::trunc};
+        file << "SN5\tPN5\t2B1D\t0102\n";
+    }
+
+    VPDCache old{path};
+    ASSERT_EQ(1, old.getCount());
+    EXPECT_EQ("2B1D", old.find("SN5")->ccin);
+    EXPECT_EQ("", old.find("SN5")->version);
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <functional>
+#include <org/open_power/Witherspoon/Sensor/History/Total/server.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace history
+{
+
+template <typename T>
+using ServerObject = typename sdbusplus::server::object::object<T>;
+
+using TotalInterface =
+    sdbusplus::org::open_power::Witherspoon::Sensor::History::server::Total;
+
+/**
+ * @class Total
+ *
+ * Implements Witherspoon.Sensor.History.Total
+ *
+ * This includes a property that is an array of timestamp, average,
+ * maximum, and included power supply tuples and a property to specify
+ * the scale.
+ */
+class Total : public ServerObject<TotalInterface>
+{
+  public:
+    static constexpr auto name = "total";
+
+    Total() = delete;
+    Total(const Total&) = delete;
+    Total& operator=(const Total&) = delete;
+    Total(Total&&) = delete;
+    Total& operator=(Total&&) = delete;
+    ~Total() = default;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - the D-Bus object path
+     */
+    Total(sdbusplus::bus::bus& bus, const std::string& objectPath) :
+        ServerObject<TotalInterface>(bus, objectPath.c_str())
+    {
+        unit(Total::Unit::Watts);
+        scale(0);
+    }
+};
+
+} // namespace history
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,170 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "vpd_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <phosphor-logging/log.hpp>
+#include <sstream>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace psu
+{
+
+using namespace phosphor::logging;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+bool isCacheable(const VPD& vpd)
+{
+    for (const auto& value : {vpd.serialNumber, vpd.partNumber, vpd.ccin})
+    {
+        if (value.find_first_of("\t\n") != std::string::npos)
+        {
+            return false;
+        }
+    }
+
+    return !vpd.serialNumber.empty();
+}
+
+} // namespace
+
+VPDCache::VPDCache(const std::string& path) : path(path)
+{
+    std::ifstream file{path};
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields{line};
+        VPD vpd;
+
+        // Anything after the CCIN, like the firmware version that
+        // older files have, is ignored.
+        if (std::getline(fields, vpd.serialNumber, '\t') &&
+            std::getline(fields, vpd.partNumber, '\t') &&
+            std::getline(fields, vpd.ccin, '\t') && isCacheable(vpd))
+        {
+            entries.push_back(std::move(vpd));
+        }
+    }
+
+    if (entries.size() > MAX_ENTRIES)
+    {
+        entries.erase(entries.begin(), entries.end() - MAX_ENTRIES);
+    }
+}
+
+std::optional<VPD> VPDCache::find(const std::string& serialNumber) const
+{
+    auto vpd = std::find_if(entries.begin(), entries.end(),
+                            [&serialNumber](const auto& e) {
+                                return e.serialNumber == serialNumber;
+                            });
+
+    if (vpd == entries.end())
+    {
+        return std::nullopt;
+    }
+
+    return *vpd;
+}
+
+void VPDCache::add(const VPD& added)
+{
+    if (!isCacheable(added))
+    {
+        return;
+    }
+
+    auto vpd = added;
+    vpd.version.clear();
+
+    auto old = std::find_if(entries.begin(), entries.end(),
+                            [&vpd](const auto& e) {
+                                return e.serialNumber == vpd.serialNumber;
+                            });
+
+    if ((old != entries.end()) && (*old == vpd))
+    {
+        return;
+    }
+
+    if (old != entries.end())
+    {
+        entries.erase(old);
+    }
+
+    entries.push_back(vpd);
+
+    if (entries.size() > MAX_ENTRIES)
+    {
+        entries.erase(entries.begin());
+    }
+
+    save();
+}
+
+void VPDCache::save() const
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path{path}.parent_path(), ec);
+
+    // Written under a temporary name so a partial file is never seen
+    auto temp = path + ".tmp";
+
+    {
+        std::ofstream file{temp, std::ios::trunc};
+        for (const auto& vpd : entries)
+        {
+            file << vpd.serialNumber << '\t' << vpd.partNumber << '\t'
+                 << vpd.ccin << '\n';
+        }
+
+        file.flush();
+        if (!file)
+        {
+            log<level::ERR>("Failed writing the VPD cache",
+                            entry("PATH=%s", temp.c_str()));
+            return;
+        }
+    }
+
+    if (std::rename(temp.c_str(), path.c_str()) != 0)
+    {
+        auto e = errno;
+        log<level::ERR>("Failed renaming the VPD cache",
+                        entry("PATH=%s", path.c_str()), entry("ERRNO=%d", e));
+    }
+}
+
+} // namespace psu
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+namespace psu
+{
+
+/**
+ * @brief The power supply VPD that goes in the inventory
+ */
+struct VPD
+{
+    std::string serialNumber;
+    std::string partNumber;
+    std::string ccin;
+    std::string version;
+
+    bool operator==(const VPD& other) const
+    {
+        return (serialNumber == other.serialNumber) &&
+               (partNumber == other.partNumber) && (ccin == other.ccin) &&
+               (version == other.version);
+    }
+
+    bool operator!=(const VPD& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ * @class VPDCache
+ *
+ * Remembers the VPD of the power supplies that have been plugged into
+ * a slot, by serial number, so when one is plugged in again only its
+ * serial number and firmware version have to be read over I2C.  The
+ * firmware version isn't cached, since a firmware update changes it.
+ *
+ * The cache can be kept in a file so it survives restarts.  The file
+ * has a line for each power supply, newest last, with the serial
+ * number, part number, and CCIN separated by tabs.  Values with tabs
+ * or newlines in them aren't cached.
+ */
+class VPDCache
+{
+  public:
+    /**
+     * @brief How many power supplies to remember
+     */
+    static constexpr size_t MAX_ENTRIES = 16;
+
+    VPDCache() = default;
+    ~VPDCache() = default;
+    VPDCache(const VPDCache&) = delete;
+    VPDCache& operator=(const VPDCache&) = delete;
+    VPDCache(VPDCache&&) = default;
+    VPDCache& operator=(VPDCache&&) = default;
+
+    /**
+     * @brief Constructor
+     *
+     * Loads the cache file if there is one.  A bad file is ignored,
+     * and replaced on the next add().
+     *
+     * @param[in] path - the cache file path
+     */
+    explicit VPDCache(const std::string& path);
+
+    /**
+     * @brief Returns the VPD of a serial number, if it's cached,
+     *        without the firmware version.
+     *
+     * @param[in] serialNumber - the serial number
+     */
+    std::optional<VPD> find(const std::string& serialNumber) const;
+
+    /**
+     * @brief Adds or replaces the VPD of a serial number, and removes
+     *        the oldest entry if there are more than MAX_ENTRIES.
+     *
+     * The firmware version is left out.  Writes the cache file, if
+     * there is one.
+     *
+     * @param[in] vpd - the VPD
+     */
+    void add(const VPD& vpd);
+
+    /**
+     * @brief Returns the number of cached entries
+     */
+    inline size_t getCount() const
+    {
+        return entries.size();
+    }
+
+  private:
+    /**
+     * @brief Writes the entries to the file
+     */
+    void save() const;
+
+    /**
+     * @brief The cache file path, or empty if there isn't one
+     */
+    std::string path;
+
+    /**
+     * @brief The entries, newest last
+     */
+    std::vector<VPD> entries;
+};
+
+} // namespace psu
+} // namespace power
+} // namespace witherspoon
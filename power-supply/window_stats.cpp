@@ -0,0 +1,61 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "window_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace witherspoon
+{
+namespace power
+{
+
+void WindowStats::add(int64_t value)
+{
+    if (count == 0)
+    {
+        minimum = value;
+        maximum = value;
+    }
+    else
+    {
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+
+    count++;
+
+    auto delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+}
+
+void WindowStats::clear()
+{
+    count = 0;
+    minimum = 0;
+    maximum = 0;
+    mean = 0;
+    m2 = 0;
+}
+
+double WindowStats::getStandardDeviation() const
+{
+    return (count != 0) ? std::sqrt(m2 / count) : 0;
+}
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class WindowStats
+ *
+ * Keeps the minimum, maximum, mean, and standard deviation of the
+ * samples in a window as they come in, without keeping the samples.
+ *
+ * The mean and variance use Welford's method so they stay accurate
+ * over long windows.
+ */
+class WindowStats
+{
+  public:
+    WindowStats() = default;
+    ~WindowStats() = default;
+    WindowStats(const WindowStats&) = default;
+    WindowStats& operator=(const WindowStats&) = default;
+    WindowStats(WindowStats&&) = default;
+    WindowStats& operator=(WindowStats&&) = default;
+
+    /**
+     * @brief Adds a sample to the window
+     *
+     * @param[in] value - the sample
+     */
+    void add(int64_t value);
+
+    /**
+     * @brief Starts a new window
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of samples in the window
+     */
+    inline uint64_t getCount() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Returns the smallest sample, or 0 if there are none
+     */
+    inline int64_t getMinimum() const
+    {
+        return minimum;
+    }
+
+    /**
+     * @brief Returns the largest sample, or 0 if there are none
+     */
+    inline int64_t getMaximum() const
+    {
+        return maximum;
+    }
+
+    /**
+     * @brief Returns the mean of the samples, or 0 if there are none
+     */
+    inline double getMean() const
+    {
+        return mean;
+    }
+
+    /**
+     * @brief Returns the population standard deviation of the samples
+     */
+    double getStandardDeviation() const;
+
+  private:
+    /**
+     * @brief The number of samples
+     */
+    uint64_t count = 0;
+
+    /**
+     * @brief The smallest sample
+     */
+    int64_t minimum = 0;
+
+    /**
+     * @brief The largest sample
+     */
+    int64_t maximum = 0;
+
+    /**
+     * @brief The running mean
+     */
+    double mean = 0;
+
+    /**
+     * @brief The running sum of squared differences from the mean
+     */
+    double m2 = 0;
+};
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,237 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <phosphor-logging/log.hpp>
+#include <stdexcept>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+
+Scheduler::Scheduler(const sdeventplus::Event& event, Clock::duration slack) :
+    slack(slack), event(event),
+    timer(event, std::bind([this]() {
+              this->runDue(Clock::now());
+              this->arm();
+          }))
+{
+    if (slack < Clock::duration{0})
+    {
+        throw std::invalid_argument("Invalid poll slack");
+    }
+}
+
+size_t Scheduler::add(const std::string& name, Clock::duration interval,
+                      Callback&& callback)
+{
+    if ((interval <= Clock::duration{0}) || (interval <= slack))
+    {
+        throw std::invalid_argument("Invalid poll interval");
+    }
+
+    auto id = jobs.size();
+    jobs.emplace_back(name, interval, std::move(callback));
+
+    if (started)
+    {
+        push({Clock::now() + interval, id});
+        arm();
+    }
+
+    return id;
+}
+
+void Scheduler::setEnabled(size_t id, bool enabled)
+{
+    auto& job = jobs.at(id);
+    if (job.enabled == enabled)
+    {
+        return;
+    }
+
+    job.enabled = enabled;
+    if (!started)
+    {
+        return;
+    }
+
+    if (enabled)
+    {
+        push({Clock::now() + job.interval, id});
+    }
+    else if (job.scheduled)
+    {
+        deadlines.erase(std::remove_if(deadlines.begin(), deadlines.end(),
+                                       [id](const auto& deadline) {
+                                           return deadline.second == id;
+                                       }),
+                        deadlines.end());
+        std::make_heap(deadlines.begin(), deadlines.end(),
+                       std::greater<Deadline>());
+        job.scheduled = false;
+    }
+
+    arm();
+}
+
+size_t Scheduler::add(Device& device, Clock::duration interval)
+{
+    auto name = device.getName() + std::to_string(device.getInstance());
+    return add(name, interval, [&device]() { device.analyze(); });
+}
+
+void Scheduler::start()
+{
+    start(Clock::now());
+}
+
+void Scheduler::start(Clock::time_point now)
+{
+    if (started)
+    {
+        return;
+    }
+
+    started = true;
+
+    for (size_t id = 0; id < jobs.size(); id++)
+    {
+        if (jobs[id].enabled)
+        {
+            push({now + jobs[id].interval, id});
+        }
+    }
+
+    arm();
+}
+
+int Scheduler::run()
+{
+    start();
+    return event.loop();
+}
+
+Scheduler::Clock::time_point Scheduler::runDue(Clock::time_point now)
+{
+    while (!deadlines.empty() && (deadlines.front().first <= now))
+    {
+        std::pop_heap(deadlines.begin(), deadlines.end(),
+                      std::greater<Deadline>());
+        auto deadline = deadlines.back();
+        deadlines.pop_back();
+
+        // Still valid if the callback adds a poll
+        auto& job = jobs[deadline.second];
+        job.scheduled = false;
+
+        auto start = Clock::now();
+        job.callback();
+        job.stats.add(Clock::now() - start, now - deadline.first);
+
+        // Skip the deadlines that already went by, instead
+        // of running the poll again right away for each.
+        auto missed = (now - deadline.first) / job.interval;
+        if (missed > 0)
+        {
+            job.missed += missed;
+
+            if (job.missedLog.allow(now))
+            {
+                using namespace std::chrono;
+                auto late = duration_cast<milliseconds>(now - deadline.first);
+
+                log<level::WARNING>(
+                    "Missed poll deadlines", entry("NAME=%s", job.name.c_str()),
+                    entry("MISSED=%lld", static_cast<long long>(missed)),
+                    entry("LATE_MS=%lld", static_cast<long long>(late.count())),
+                    entry("SUPPRESSED=%zu", job.missedLog.takeSuppressed()));
+            }
+        }
+
+        // Unless the callback disabled it, or disabled and enabled
+        // it, which already scheduled it again.
+        if (job.enabled && !job.scheduled)
+        {
+            push({deadline.first + (missed + 1) * job.interval,
+                  deadline.second});
+        }
+    }
+
+    return getWakeTime();
+}
+
+Scheduler::Clock::time_point Scheduler::getWakeTime() const
+{
+    if (deadlines.empty())
+    {
+        return Clock::time_point::max();
+    }
+
+    // Put off the earliest poll to the last one within the slack
+    // after it, so they can all be run from one wakeup.
+    auto earliest = deadlines.front().first;
+    auto wake = earliest;
+
+    for (const auto& deadline : deadlines)
+    {
+        if ((deadline.first <= earliest + slack) && (deadline.first > wake))
+        {
+            wake = deadline.first;
+        }
+    }
+
+    return wake;
+}
+
+void Scheduler::push(const Deadline& deadline)
+{
+    jobs[deadline.second].scheduled = true;
+    deadlines.push_back(deadline);
+    std::push_heap(deadlines.begin(), deadlines.end(),
+                   std::greater<Deadline>());
+}
+
+void Scheduler::arm()
+{
+    if (deadlines.empty())
+    {
+        timer.setEnabled(false);
+        return;
+    }
+
+    // The timer adds the delay to the event loop's time, so it's
+    // from that.  Rounded up so it never fires before the wake time.
+    auto delay = std::max(getWakeTime() - getEventTime(), Clock::duration{0});
+    timer.restartOnce(std::chrono::ceil<std::chrono::microseconds>(delay));
+}
+
+Scheduler::Clock::time_point Scheduler::getEventTime() const
+{
+    using namespace sdeventplus;
+
+    // Both are CLOCK_MONOTONIC
+    auto now = sdeventplus::Clock<ClockId::Monotonic>(event).now();
+    return Clock::time_point{
+        std::chrono::duration_cast<Clock::duration>(now.time_since_epoch())};
+}
+
+} // namespace power
+} // namespace witherspoon
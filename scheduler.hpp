@@ -0,0 +1,263 @@
+#pragma once
+
+#include "cycle_stats.hpp"
+#include "device.hpp"
+#include "log_limiter.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <sdeventplus/clock.hpp>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/utility/timer.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @class Scheduler
+ *
+ * Runs the polls of many devices, each on its own interval, from a
+ * single timer.
+ *
+ * The deadlines are kept in a min-heap.  When the timer is armed, the
+ * polls whose deadlines are within the slack after the earliest one
+ * are put off to the latest of them and run together, so the BMC wakes
+ * up once for the group instead of once for each.  A poll is never run
+ * before its deadline, and never more than the slack after it unless
+ * the event loop was held up.
+ *
+ * A poll can be disabled and enabled again, which takes it off the
+ * schedule and puts it back on one interval later.
+ *
+ * A poll that starts after its next deadline has also passed has
+ * missed deadlines.  Those polls are skipped instead of run back to
+ * back, counted, and logged to the journal at a limited rate.
+ */
+class Scheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Runs a poll
+     */
+    using Callback = std::function<void()>;
+
+    /**
+     * @brief How long a poll may be put off by default so it can be
+     *        run together with others
+     */
+    static constexpr auto DEFAULT_SLACK = std::chrono::milliseconds{50};
+
+    Scheduler() = delete;
+    ~Scheduler() = default;
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    Scheduler(Scheduler&&) = delete;
+    Scheduler& operator=(Scheduler&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] event - the event loop to run the polls from
+     * @param[in] slack - how long a poll may be put off to run it
+     *                    together with others, which can't be
+     *                    negative
+     */
+    Scheduler(const sdeventplus::Event& event,
+              Clock::duration slack = DEFAULT_SLACK);
+
+    /**
+     * @brief Adds a poll.  Its first deadline is one interval from
+     *        now, or from when start() is called if that's later.
+     *
+     * It can be called from a poll's callback.
+     *
+     * @param[in] name - the name for the journal and statistics
+     * @param[in] interval - the time between polls, which must be
+     *                       longer than the slack, or the grouping
+     *                       alone would miss deadlines
+     * @param[in] callback - runs the poll
+     *
+     * @return size_t - the ID of the poll
+     */
+    size_t add(const std::string& name, Clock::duration interval,
+               Callback&& callback);
+
+    /**
+     * @brief Adds a poll that calls Device::analyze().  The device
+     *        must outlive this object.
+     *
+     * @param[in] device - the device
+     * @param[in] interval - the time between polls
+     *
+     * @return size_t - the ID of the poll
+     */
+    size_t add(Device& device, Clock::duration interval);
+
+    /**
+     * @brief Takes a poll off the schedule, or puts it back on with
+     *        its next deadline one interval from now.  It can be
+     *        called from a poll's callback.
+     *
+     * @param[in] id - the poll ID
+     * @param[in] enabled - if the poll should run
+     */
+    void setEnabled(size_t id, bool enabled);
+
+    /**
+     * @brief Sets the first deadlines and arms the timer
+     */
+    void start();
+
+    /**
+     * @brief Like above, with the current time passed in
+     */
+    void start(Clock::time_point now);
+
+    /**
+     * @brief Starts the polls and runs the event loop
+     *
+     * @return the return value from sd_event_loop()
+     */
+    int run();
+
+    /**
+     * @brief Runs the polls whose deadlines have passed
+     *
+     * @param[in] now - the current time
+     *
+     * @return Clock::time_point - when the timer should fire next
+     */
+    Clock::time_point runDue(Clock::time_point now);
+
+    /**
+     * @brief Returns when the next group of polls should be run
+     */
+    Clock::time_point getWakeTime() const;
+
+    /**
+     * @brief Returns the event loop the polls run from
+     */
+    inline const sdeventplus::Event& getEvent() const
+    {
+        return event;
+    }
+
+    /**
+     * @brief Returns the name of a poll
+     *
+     * @param[in] id - the poll ID
+     */
+    inline const std::string& getName(size_t id) const
+    {
+        return jobs.at(id).name;
+    }
+
+    /**
+     * @brief Returns the statistics of a poll
+     *
+     * @param[in] id - the poll ID
+     */
+    inline const CycleStats& getStats(size_t id) const
+    {
+        return jobs.at(id).stats;
+    }
+
+    /**
+     * @brief Returns the number of deadlines a poll has missed
+     *
+     * @param[in] id - the poll ID
+     */
+    inline uint64_t getMissed(size_t id) const
+    {
+        return jobs.at(id).missed;
+    }
+
+  private:
+    /**
+     * @brief A poll
+     */
+    struct Job
+    {
+        Job(const std::string& name, Clock::duration interval,
+            Callback&& callback) :
+            name(name),
+            interval(interval), callback(std::move(callback)), stats(interval)
+        {
+        }
+
+        std::string name;
+        Clock::duration interval;
+        Callback callback;
+        CycleStats stats;
+        uint64_t missed = 0;
+        LogLimiter missedLog;
+        bool enabled = true;
+        bool scheduled = false;
+    };
+
+    /**
+     * @brief A deadline and the ID of its poll
+     */
+    using Deadline = std::pair<Clock::time_point, size_t>;
+
+    /**
+     * @brief Puts a deadline on the heap
+     *
+     * @param[in] deadline - the deadline
+     */
+    void push(const Deadline& deadline);
+
+    /**
+     * @brief Arms the timer for the next group of polls
+     */
+    void arm();
+
+    /**
+     * @brief Returns the event loop's time, which is when it last
+     *        woke up and what the timer delay is added to.
+     */
+    Clock::time_point getEventTime() const;
+
+    /**
+     * @brief The polls, indexed by ID.  A deque, so adding one from
+     *        a callback doesn't move the poll that is running.
+     */
+    std::deque<Job> jobs;
+
+    /**
+     * @brief The next deadline of each poll, as a min-heap
+     */
+    std::vector<Deadline> deadlines;
+
+    /**
+     * @brief How long a poll may be put off
+     */
+    Clock::duration slack;
+
+    /**
+     * @brief If start() was called
+     */
+    bool started = false;
+
+    /**
+     * @brief The event loop
+     */
+    sdeventplus::Event event;
+
+    /**
+     * @brief Fires at the wake time
+     */
+    sdeventplus::utility::Timer<sdeventplus::ClockId::Monotonic> timer;
+};
+
+} // namespace power
+} // namespace witherspoon
@@ -0,0 +1,67 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cycle_stats.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace witherspoon::power;
+
+TEST(CycleStatsTest, TestCycles)
+{
+    using namespace std::chrono;
+
+    CycleStats stats{milliseconds{1000}};
+
+    EXPECT_EQ(stats.getCycles(), 0);
+    EXPECT_EQ(stats.getDuration().getMean(), CycleStats::Clock::duration{0});
+
+    stats.add(microseconds{50}, milliseconds{2});
+    stats.add(microseconds{100}, milliseconds{4});
+    stats.add(microseconds{101}, milliseconds{0});
+    stats.add(milliseconds{40}, milliseconds{0});
+    stats.add(milliseconds{1500}, milliseconds{0});
+
+    // Only clock jitter, so it counts as on time
+    stats.add(microseconds{200}, microseconds{-5});
+
+    EXPECT_EQ(stats.getCycles(), 6);
+    EXPECT_EQ(stats.getOverruns(), 1);
+
+    // The bounds are inclusive and the last bucket takes the rest
+    const auto& histogram = stats.getHistogram();
+    EXPECT_EQ(histogram.size(), CycleStats::BUCKET_BOUNDS.size() + 1);
+    EXPECT_EQ(histogram[0], 2);
+    EXPECT_EQ(histogram[1], 2);
+    EXPECT_EQ(histogram[8], 1);
+    EXPECT_EQ(histogram.back(), 1);
+
+    EXPECT_EQ(stats.getDuration().getMax(), milliseconds{1500});
+    EXPECT_EQ(stats.getLateness().getMax(), milliseconds{4});
+    EXPECT_EQ(stats.getLateness().getMean(), milliseconds{1});
+}
+
+TEST(CycleStatsTest, TestPhase)
+{
+    using namespace std::chrono;
+
+    PhaseStats phase;
+    phase.add(microseconds{30});
+    phase.add(microseconds{10});
+
+    EXPECT_EQ(phase.getCount(), 2);
+    EXPECT_EQ(phase.getMean(), microseconds{20});
+    EXPECT_EQ(phase.getMax(), microseconds{30});
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flight_recorder.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <gtest/gtest.h>
+
+using namespace witherspoon::power;
+namespace fs = std::filesystem;
+
+TEST(FlightRecorderTest, TestRecordAndDump)
+{
+    using Type = FlightRecorder::Type;
+
+    FlightRecorder recorder{"ps0", 4};
+
+    recorder.record(1000000, Type::state, "present", 1);
+    recorder.record(2000000, Type::reg, "status0", 0x0000);
+    recorder.record(3000000, Type::reg, "status0", 0x0000);
+    recorder.record(4000000, Type::reg, "status0", 0x0848);
+    recorder.record(4000100, Type::gpi, "PGOOD_5V", 0);
+    EXPECT_EQ(4, recorder.getCount());
+
+    // The oldest entry was dropped, but its name stays
+    auto dump = FlightRecorder::decode(recorder.encode());
+    ASSERT_EQ(4, dump.entries.size());
+    ASSERT_EQ(3, dump.names.size());
+
+    EXPECT_EQ(2000000, dump.entries[0].timestamp);
+    EXPECT_EQ("status0", dump.names[dump.entries[0].name]);
+    EXPECT_EQ(0x0848, dump.entries[2].value);
+    EXPECT_EQ(4000100, dump.entries[3].timestamp);
+    EXPECT_EQ(Type::gpi, dump.entries[3].type);
+    EXPECT_EQ("PGOOD_5V", dump.names[dump.entries[3].name]);
+
+    // A name is only stored once, and can be recorded by index
+    auto status0 = recorder.addName("status0");
+    EXPECT_EQ(dump.entries[0].name, status0);
+    recorder.record(5000000, Type::reg, status0, 0x0040);
+    dump = FlightRecorder::decode(recorder.encode());
+    EXPECT_EQ(3, dump.names.size());
+    EXPECT_EQ(0x0040, dump.entries[3].value);
+    EXPECT_EQ("status0", dump.names[dump.entries[3].name]);
+    EXPECT_THROW(recorder.record(Type::reg, 3, 0), std::out_of_range);
+
+    EXPECT_THROW(FlightRecorder::decode({1, 2, 3}), std::runtime_error);
+
+    // Only the newest dumps are kept
+    char dir[] = "/tmp/frtestXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+
+    std::string path;
+    for (size_t i = 0; i < FlightRecorder::MAX_DUMPS + 2; i++)
+    {
+        path = recorder.dump("Fault" + std::to_string(i), dir);
+        ASSERT_FALSE(path.empty());
+    }
+
+    auto files = std::distance(fs::directory_iterator{dir},
+                               fs::directory_iterator{});
+    EXPECT_EQ(FlightRecorder::MAX_DUMPS, files);
+
+    // The oldest ones were removed, even if written in the same instant
+    EXPECT_FALSE(fs::exists(fs::path{dir} / "ps0_2_Fault1.bin"));
+    EXPECT_TRUE(fs::exists(fs::path{dir} / "ps0_3_Fault2.bin"));
+    EXPECT_EQ(fs::path{dir} / "ps0_10_Fault9.bin", path);
+
+    std::ifstream file{path, std::ios::binary};
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>{file},
+                              std::istreambuf_iterator<char>{}};
+    EXPECT_EQ(4, FlightRecorder::decode(data).entries.size());
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,53 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_limiter.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace witherspoon::power;
+
+TEST(LogLimiterTest, TestLimit)
+{
+    using namespace std::chrono;
+
+    LogLimiter limiter{2, seconds{10}};
+    LogLimiter::Clock::time_point now{};
+
+    // The burst goes right through
+    EXPECT_TRUE(limiter.allow(now));
+    EXPECT_TRUE(limiter.allow(now));
+    EXPECT_EQ(limiter.takeSuppressed(), 0);
+
+    for (auto i = 0; i < 5; i++)
+    {
+        now += seconds{1};
+        EXPECT_FALSE(limiter.allow(now));
+    }
+
+    // One token back after 10s
+    now = LogLimiter::Clock::time_point{} + seconds{10};
+    EXPECT_TRUE(limiter.allow(now));
+    EXPECT_EQ(limiter.takeSuppressed(), 5);
+    EXPECT_EQ(limiter.takeSuppressed(), 0);
+    EXPECT_FALSE(limiter.allow(now));
+
+    // Full again after a long time, but no more than the burst
+    now += minutes{10};
+    EXPECT_TRUE(limiter.allow(now));
+    EXPECT_TRUE(limiter.allow(now));
+    EXPECT_FALSE(limiter.allow(now));
+    EXPECT_EQ(limiter.takeSuppressed(), 2);
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace witherspoon::power;
+
+TEST(SchedulerTest, TestDeadlines)
+{
+    using namespace std::chrono;
+
+    auto event = sdeventplus::Event::get_default();
+    Scheduler scheduler{event, milliseconds{50}};
+
+    std::vector<std::string> polls;
+    auto fast = scheduler.add("fast", milliseconds{100},
+                              [&polls]() { polls.push_back("fast"); });
+    auto slow = scheduler.add("slow", milliseconds{130},
+                              [&polls]() { polls.push_back("slow"); });
+    auto other = scheduler.add("other", milliseconds{500},
+                               [&polls]() { polls.push_back("other"); });
+
+    EXPECT_THROW(scheduler.add("bad", milliseconds{0}, []() {}),
+                 std::invalid_argument);
+
+    // Within the slack, the grouping alone would miss deadlines
+    EXPECT_THROW(scheduler.add("bad", milliseconds{50}, []() {}),
+                 std::invalid_argument);
+    EXPECT_THROW(Scheduler(event, milliseconds{-1}), std::invalid_argument);
+
+    Scheduler::Clock::time_point t0{};
+    scheduler.start(t0);
+
+    // The 100ms poll is put off to run with the 130ms one
+    auto wake = scheduler.getWakeTime();
+    EXPECT_EQ(wake, t0 + milliseconds{130});
+
+    // Nothing is run early
+    scheduler.runDue(t0 + milliseconds{99});
+    EXPECT_TRUE(polls.empty());
+
+    wake = scheduler.runDue(wake);
+    EXPECT_EQ(polls, (std::vector<std::string>{"fast", "slow"}));
+    EXPECT_EQ(scheduler.getStats(fast).getLateness().getMax(),
+              milliseconds{30});
+    EXPECT_EQ(scheduler.getStats(slow).getLateness().getMax(),
+              milliseconds{0});
+
+    // The next ones are at 200 and 260, too far apart to put
+    // together, and then the 260ms one goes with the 300ms one
+    EXPECT_EQ(wake, t0 + milliseconds{200});
+    polls.clear();
+    wake = scheduler.runDue(wake);
+    EXPECT_EQ(polls, (std::vector<std::string>{"fast"}));
+    EXPECT_EQ(wake, t0 + milliseconds{300});
+
+    // Held up past several deadlines, each poll runs
+    // once and the deadlines it missed are skipped
+    polls.clear();
+    scheduler.runDue(t0 + milliseconds{720});
+    EXPECT_EQ(polls.size(), 3);
+    EXPECT_EQ(scheduler.getMissed(fast), 4);
+    EXPECT_EQ(scheduler.getMissed(slow), 3);
+    EXPECT_EQ(scheduler.getMissed(other), 0);
+    EXPECT_EQ(scheduler.getWakeTime(), t0 + milliseconds{800});
+
+    EXPECT_EQ(scheduler.getStats(fast).getCycles(), 3);
+    EXPECT_EQ(scheduler.getName(other), "other");
+}
+
+TEST(SchedulerTest, TestAddFromPoll)
+{
+    using namespace std::chrono;
+
+    auto event = sdeventplus::Event::get_default();
+    Scheduler scheduler{event};
+
+    // Enough polls added while it runs to move the running one
+    // if it were stored in a vector.
+    size_t runs = 0;
+    std::string name(64, 'x');
+    auto adder = scheduler.add(
+        "adder", milliseconds{100}, [&scheduler, &runs, name]() {
+            for (size_t i = 0; i < 64; i++)
+            {
+                scheduler.add(name, seconds{10}, []() {});
+            }
+            runs += (name.size() == 64) ? 1 : 0;
+        });
+
+    Scheduler::Clock::time_point t0{};
+    scheduler.start(t0);
+    scheduler.runDue(t0 + milliseconds{100});
+
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(scheduler.getStats(adder).getCycles(), 1);
+    EXPECT_EQ(scheduler.getName(adder), "adder");
+    EXPECT_EQ(scheduler.getName(64), name);
+}
+
+TEST(SchedulerTest, TestDisable)
+{
+    using namespace std::chrono;
+
+    auto event = sdeventplus::Event::get_default();
+    Scheduler scheduler{event};
+
+    size_t runs = 0;
+    auto once = scheduler.add("once", milliseconds{100},
+                              [&scheduler, &runs]() {
+                                  runs++;
+                                  scheduler.setEnabled(0, false);
+                              });
+    auto other = scheduler.add("other", milliseconds{300}, []() {});
+
+    Scheduler::Clock::time_point t0{};
+    scheduler.start(t0);
+
+    // Disabled from its own callback, so only the other one is left
+    EXPECT_EQ(scheduler.runDue(t0 + milliseconds{100}),
+              t0 + milliseconds{300});
+    scheduler.runDue(t0 + milliseconds{1000});
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(scheduler.getStats(once).getCycles(), 1);
+
+    // Disabled and enabled again, it's back on the schedule once
+    scheduler.setEnabled(other, false);
+    EXPECT_EQ(scheduler.getWakeTime(), Scheduler::Clock::time_point::max());
+    scheduler.setEnabled(other, true);
+    scheduler.setEnabled(other, true);
+    scheduler.runDue(Scheduler::Clock::now() + milliseconds{300});
+    EXPECT_EQ(scheduler.getStats(other).getCycles(), 2);
+    EXPECT_NE(scheduler.getWakeTime(), Scheduler::Clock::time_point::max());
+}
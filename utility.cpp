@@ -15,6 +15,9 @@
  */
 #include "utility.hpp"
 
+#include <phosphor-logging/elog-errors.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
 namespace witherspoon
 {
 namespace power
@@ -28,8 +31,30 @@ constexpr auto MAPPER_INTERFACE = "xyz.openbmc_project.ObjectMapper";
 
 using namespace phosphor::logging;
 
+using InternalFailure =
+    sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
 std::string getService(const std::string& path, const std::string& interface,
                        sdbusplus::bus::bus& bus)
+{
+    auto method = newGetServiceCall(path, interface, bus);
+
+    auto reply = bus.call(method);
+
+    auto service = readGetServiceReply(reply);
+    if (service.empty())
+    {
+        log<level::ERR>("Error in mapper response for getting service name",
+                        entry("PATH=%s", path.c_str()),
+                        entry("INTERFACE=%s", interface.c_str()));
+    }
+
+    return service;
+}
+
+sdbusplus::message::message newGetServiceCall(const std::string& path,
+                                              const std::string& interface,
+                                              sdbusplus::bus::bus& bus)
 {
     auto method = bus.new_method_call(MAPPER_BUSNAME, MAPPER_PATH,
                                       MAPPER_INTERFACE, "GetObject");
@@ -37,22 +62,62 @@ std::string getService(const std::string& path, const std::string& interface,
     method.append(path);
     method.append(std::vector<std::string>({interface}));
 
-    auto reply = bus.call(method);
+    return method;
+}
 
+std::string readGetServiceReply(sdbusplus::message::message& reply)
+{
     std::map<std::string, std::vector<std::string>> response;
     reply.read(response);
 
     if (response.empty())
     {
-        log<level::ERR>("Error in mapper response for getting service name",
-                        entry("PATH=%s", path.c_str()),
-                        entry("INTERFACE=%s", interface.c_str()));
         return std::string{};
     }
 
     return response.begin()->first;
 }
 
+AsyncCall::AsyncCall(sdbusplus::bus::bus& bus,
+                     sdbusplus::message::message& method,
+                     Callback&& callback) :
+    callback(std::move(callback))
+{
+    auto rc = sd_bus_call_async(bus.get(), &slot, method.get(),
+                                AsyncCall::handler, this, 0);
+    if (rc < 0)
+    {
+        log<level::ERR>("Failed to make an async D-Bus call",
+                        entry("PATH=%s", method.get_path()),
+                        entry("MEMBER=%s", method.get_member()),
+                        entry("RC=%d", rc));
+        elog<InternalFailure>();
+    }
+}
+
+AsyncCall::~AsyncCall()
+{
+    sd_bus_slot_unref(slot);
+}
+
+int AsyncCall::handler(sd_bus_message* msg, void* data, sd_bus_error*)
+{
+    auto call = static_cast<AsyncCall*>(data);
+    sdbusplus::message::message reply{msg};
+
+    try
+    {
+        call->callback(reply);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed handling an async D-Bus reply",
+                        entry("ERROR=%s", e.what()));
+    }
+
+    return 0;
+}
+
 } // namespace util
 } // namespace power
 } // namespace witherspoon
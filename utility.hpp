@@ -1,8 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <phosphor-logging/elog.hpp>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/bus.hpp>
+#include <sdbusplus/message.hpp>
 #include <string>
 
 namespace witherspoon
@@ -31,6 +33,82 @@ constexpr auto PROPERTY_INTF = "org.freedesktop.DBus.Properties";
 std::string getService(const std::string& path, const std::string& interface,
                        sdbusplus::bus::bus& bus);
 
+/**
+ * @brief Creates the mapper method call that getService() makes,
+ *        so it can be made asynchronously.
+ *
+ * @param[in] path - the D-Bus path name
+ * @param[in] interface - the D-Bus interface name
+ * @param[in] bus - the D-Bus object
+ *
+ * @return The method call
+ */
+sdbusplus::message::message newGetServiceCall(const std::string& path,
+                                              const std::string& interface,
+                                              sdbusplus::bus::bus& bus);
+
+/**
+ * @brief Reads the service name out of the reply to the
+ *        newGetServiceCall() method call.
+ *
+ * @param[in] reply - the reply
+ *
+ * @return The service name, or empty if there wasn't one
+ */
+std::string readGetServiceReply(sdbusplus::message::message& reply);
+
+/**
+ * @class AsyncCall
+ *
+ * Makes a D-Bus method call without waiting for the reply.  The
+ * callback is run from the event loop with the reply, which can be
+ * an error reply, so it should check is_method_error() first.
+ *
+ * Destroying this cancels the call if it hasn't completed, so the
+ * callback is never run after its owner is gone.  It must not be
+ * destroyed from its own callback.
+ */
+class AsyncCall
+{
+  public:
+    using Callback = std::function<void(sdbusplus::message::message&)>;
+
+    AsyncCall() = delete;
+    ~AsyncCall();
+    AsyncCall(const AsyncCall&) = delete;
+    AsyncCall& operator=(const AsyncCall&) = delete;
+    AsyncCall(AsyncCall&&) = delete;
+    AsyncCall& operator=(AsyncCall&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Sends the method call.
+     *
+     * @param[in] bus - the D-Bus object
+     * @param[in] method - the method call
+     * @param[in] callback - called with the reply
+     */
+    AsyncCall(sdbusplus::bus::bus& bus, sdbusplus::message::message& method,
+              Callback&& callback);
+
+  private:
+    /**
+     * @brief The sd-bus reply handler
+     */
+    static int handler(sd_bus_message* msg, void* data, sd_bus_error*);
+
+    /**
+     * @brief The callback
+     */
+    Callback callback;
+
+    /**
+     * @brief The pending call
+     */
+    sd_bus_slot* slot = nullptr;
+};
+
 /**
  * @brief Read a D-Bus property
  *
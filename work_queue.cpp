@@ -0,0 +1,76 @@
+/**
+ * Copyright © 2017 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "work_queue.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+namespace witherspoon
+{
+namespace power
+{
+
+using namespace phosphor::logging;
+using sdeventplus::source::Enabled;
+
+WorkQueue::WorkQueue(const sdeventplus::Event& event, int64_t priority) :
+    source(event, [this](auto&) { this->runNext(); })
+{
+    source.set_priority(priority);
+    source.set_enabled(Enabled::Off);
+}
+
+void WorkQueue::add(Work&& work)
+{
+    pending.push_back(std::move(work));
+    source.set_enabled(Enabled::On);
+}
+
+void WorkQueue::flush()
+{
+    while (!pending.empty())
+    {
+        runNext();
+    }
+}
+
+void WorkQueue::runNext()
+{
+    if (pending.empty())
+    {
+        source.set_enabled(Enabled::Off);
+        return;
+    }
+
+    auto work = std::move(pending.front());
+    pending.pop_front();
+
+    if (pending.empty())
+    {
+        source.set_enabled(Enabled::Off);
+    }
+
+    try
+    {
+        work();
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Queued work failed", entry("ERROR=%s", e.what()));
+    }
+}
+
+} // namespace power
+} // namespace witherspoon
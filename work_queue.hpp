@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <sdeventplus/event.hpp>
+#include <sdeventplus/source/event.hpp>
+#include <systemd/sd-event.h>
+
+namespace witherspoon
+{
+namespace power
+{
+
+/**
+ * @brief The event loop priorities of the monitor work, where a lower
+ *        value runs first when more than one thing is ready.
+ *
+ * The fault polling timers and the D-Bus signals that drive it, like
+ * power state changes and PowerLost, use the sd-event default.
+ * Publishing history and then housekeeping like inventory updates and
+ * error resolution come after it.
+ */
+constexpr int64_t PRIORITY_FAULT = SD_EVENT_PRIORITY_NORMAL;
+constexpr int64_t PRIORITY_HISTORY = SD_EVENT_PRIORITY_NORMAL + 10;
+constexpr int64_t PRIORITY_HOUSEKEEPING = SD_EVENT_PRIORITY_IDLE;
+
+/**
+ * @class WorkQueue
+ *
+ * Runs queued work from the event loop at a priority, one piece per
+ * event loop iteration.  Long work is added as several short pieces
+ * so anything with a higher priority that becomes ready in between,
+ * like a fault poll, runs before the rest of it.
+ *
+ * Work still queued when this is destroyed is dropped.
+ */
+class WorkQueue
+{
+  public:
+    using Work = std::function<void()>;
+
+    WorkQueue() = delete;
+    ~WorkQueue() = default;
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+    WorkQueue(WorkQueue&&) = delete;
+    WorkQueue& operator=(WorkQueue&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] event - the event loop to run the work from
+     * @param[in] priority - the event loop priority of the work
+     */
+    WorkQueue(const sdeventplus::Event& event, int64_t priority);
+
+    /**
+     * @brief Queues a piece of work.  It must not hold pointers
+     *        into the caller's stack.
+     *
+     * @param[in] work - the work
+     */
+    void add(Work&& work);
+
+    /**
+     * @brief Runs everything queued now
+     */
+    void flush();
+
+    /**
+     * @brief Returns the number of pieces of work queued
+     */
+    inline size_t getPending() const
+    {
+        return pending.size();
+    }
+
+  private:
+    /**
+     * @brief Runs the oldest piece of work
+     */
+    void runNext();
+
+    /**
+     * @brief The queued work
+     */
+    std::deque<Work> pending;
+
+    /**
+     * @brief Runs the work on every event loop iteration where
+     *        nothing with a higher priority is ready
+     */
+    sdeventplus::source::Defer source;
+};
+
+} // namespace power
+} // namespace witherspoon